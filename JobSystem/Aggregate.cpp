@@ -0,0 +1,207 @@
+#include "Aggregate.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+
+#include "ConcurrentHashMap.h"
+#include "Counter.h"
+#include "Job.h"
+#include "JobSystem.h"
+
+namespace
+{
+	struct StringHash
+	{
+		size_t operator()(const std::string* string) const { return std::hash<std::string>()(*string); }
+	};
+
+	struct StringEqual
+	{
+		bool operator()(const std::string* a, const std::string* b) const { return a == b || *a == *b; }
+	};
+
+	struct GroupValue
+	{
+		uint64_t Count = 0;
+		size_t FirstIndex = SIZE_MAX;
+	};
+
+	using GroupMap = Js::ConcurrentHashMap<const std::string*, GroupValue, StringHash, StringEqual>;
+
+	void CombineGroups(GroupValue& target, const GroupValue& value)
+	{
+		target.Count += value.Count;
+		target.FirstIndex = std::min(target.FirstIndex, value.FirstIndex);
+	}
+
+	// HyperLogLog estimate of the number of distinct strings, about 1.6% standard error. Sizes the shared table
+	// close to the real distinct count instead of the sum of all local tables
+	class DistinctSketch
+	{
+	public:
+		void Add(size_t hash)
+		{
+			uint64_t mixed = static_cast<uint64_t>(hash) + 0x9E3779B97F4A7C15ull;
+			mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ull;
+			mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBull;
+			mixed ^= mixed >> 31;
+
+			const size_t index = static_cast<size_t>(mixed >> (64 - REGISTER_BITS));
+			uint8_t rank = 1;
+			for (uint64_t rest = mixed << REGISTER_BITS; rank <= 64 - REGISTER_BITS && (rest & (1ull << 63)) == 0; rest <<= 1)
+				++rank;
+
+			Registers[index] = std::max(Registers[index], rank);
+		}
+
+		void Merge(const DistinctSketch& other)
+		{
+			for (size_t i = 0; i < REGISTER_COUNT; ++i)
+				Registers[i] = std::max(Registers[i], other.Registers[i]);
+		}
+
+		double Estimate() const
+		{
+			double sum = 0.0;
+			size_t zeros = 0;
+			for (const uint8_t rank : Registers)
+			{
+				sum += std::ldexp(1.0, -rank);
+				zeros += rank == 0;
+			}
+
+			const double count = static_cast<double>(REGISTER_COUNT);
+			const double estimate = 0.7213 / (1.0 + 1.079 / count) * count * count / sum;
+			if (estimate <= 2.5 * count && zeros != 0)
+				return count * std::log(count / static_cast<double>(zeros));
+			return estimate;
+		}
+
+	private:
+		static constexpr size_t REGISTER_BITS = 12;
+		static constexpr size_t REGISTER_COUNT = 1u << REGISTER_BITS;
+
+		std::array<uint8_t, REGISTER_COUNT> Registers{};
+	};
+
+	struct PartitionData
+	{
+		const std::vector<std::string>* Strings = nullptr;
+		size_t Begin = 0;
+		size_t End = 0;
+
+		std::unique_ptr<GroupMap> Local;
+		DistinctSketch Sketch;
+		GroupMap* Shared = nullptr;
+	};
+
+	void BuildPartition(Js::JobSystem&, void* data)
+	{
+		const auto partition = static_cast<PartitionData*>(data);
+		const std::vector<std::string>& strings = *partition->Strings;
+
+		partition->Local.reset(new GroupMap(partition->End - partition->Begin));
+		for (size_t i = partition->Begin; i < partition->End; ++i)
+		{
+			if (partition->Local->Merge(&strings[i], GroupValue{1, i}, CombineGroups))
+				partition->Sketch.Add(StringHash()(&strings[i]));
+		}
+	}
+
+	void MergePartition(Js::JobSystem&, void* data)
+	{
+		const auto partition = static_cast<PartitionData*>(data);
+		GroupMap* shared = partition->Shared;
+
+		partition->Local->ForEach([shared](const std::string* key, const GroupValue& value)
+		{
+			shared->Merge(key, value, CombineGroups);
+		});
+		partition->Local.reset();
+	}
+
+	// Every job aggregates its chunk into a private table first, so the shared table only sees one merge per
+	// distinct string and chunk instead of one per input string
+	std::unique_ptr<GroupMap> BuildGroups(Js::JobSystem& system, const std::vector<std::string>& strings,
+	                                      const Js::AggregateOptions& options)
+	{
+		const size_t chunkSize = std::max<size_t>(1, options.ChunkSize);
+		const size_t partitionCount = (strings.size() + chunkSize - 1) / chunkSize;
+
+		std::vector<PartitionData> partitions(partitionCount);
+		std::vector<Js::Job> jobs;
+		for (size_t i = 0; i < partitionCount; ++i)
+		{
+			PartitionData& partition = partitions[i];
+			partition.Strings = &strings;
+			partition.Begin = i * chunkSize;
+			partition.End = std::min(strings.size(), partition.Begin + chunkSize);
+			jobs.emplace_back(BuildPartition, &partition);
+		}
+
+		Js::Counter buildCounter;
+		system.AddJobs(jobs, &buildCounter);
+		system.Wait(buildCounter, 0);
+
+		size_t upperBound = 0;
+		DistinctSketch sketch;
+		for (const PartitionData& partition : partitions)
+		{
+			upperBound += partition.Local->GetSize();
+			sketch.Merge(partition.Sketch);
+		}
+
+		// Ten percent over the estimate keeps a six sigma underestimate below the capacity the map doubles to
+		const auto estimate = static_cast<size_t>(sketch.Estimate() * 1.1) + 1024;
+		std::unique_ptr<GroupMap> shared(new GroupMap(std::min(upperBound, estimate)));
+		jobs.clear();
+		for (PartitionData& partition : partitions)
+		{
+			partition.Shared = shared.get();
+			jobs.emplace_back(MergePartition, &partition);
+		}
+
+		Js::Counter mergeCounter;
+		system.AddJobs(jobs, &mergeCounter);
+		system.Wait(mergeCounter, 0);
+
+		return shared;
+	}
+}
+
+size_t Js::CountDistinct(JobSystem& system, const std::vector<std::string>& strings, const AggregateOptions& options)
+{
+	return BuildGroups(system, strings, options)->GetSize();
+}
+
+std::vector<Js::StringGroup> Js::GroupBy(JobSystem& system, const std::vector<std::string>& strings,
+                                         const AggregateOptions& options)
+{
+	const std::unique_ptr<GroupMap> groups = BuildGroups(system, strings, options);
+
+	std::vector<StringGroup> result;
+	result.reserve(groups->GetSize());
+	groups->ForEach([&result](const std::string* key, const GroupValue& value)
+	{
+		result.push_back(StringGroup{key, value.Count, value.FirstIndex});
+	});
+	return result;
+}
+
+std::vector<std::string> Js::Dedup(JobSystem& system, const std::vector<std::string>& strings,
+                                   const AggregateOptions& options)
+{
+	std::vector<StringGroup> groups = GroupBy(system, strings, options);
+	std::sort(groups.begin(), groups.end(), [](const StringGroup& a, const StringGroup& b)
+	{
+		return a.FirstIndex < b.FirstIndex;
+	});
+
+	std::vector<std::string> result;
+	result.reserve(groups.size());
+	for (const StringGroup& group : groups)
+		result.push_back(*group.Key);
+	return result;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Js
+{
+	class JobSystem;
+
+	struct AggregateOptions
+	{
+		// Strings aggregated by one job into its local table before the tables are merged
+		size_t ChunkSize = 16384;
+	};
+
+	struct StringGroup
+	{
+		// Points into the input, which must outlive the result
+		const std::string* Key = nullptr;
+		uint64_t Count = 0;
+		size_t FirstIndex = 0;
+	};
+
+	size_t CountDistinct(JobSystem& system, const std::vector<std::string>& strings,
+	                     const AggregateOptions& options = AggregateOptions());
+
+	// One group per distinct string, in no particular order
+	std::vector<StringGroup> GroupBy(JobSystem& system, const std::vector<std::string>& strings,
+	                                 const AggregateOptions& options = AggregateOptions());
+
+	// First occurrence of every distinct string, in input order
+	std::vector<std::string> Dedup(JobSystem& system, const std::vector<std::string>& strings,
+	                               const AggregateOptions& options = AggregateOptions());
+}
@@ -0,0 +1,151 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Aggregate.h"
+#include "Counter.h"
+#include "Job.h"
+#include "JobSystem.h"
+
+namespace
+{
+	constexpr size_t SHARD_COUNT = 64;
+	constexpr size_t CHUNK_SIZE = 16384;
+
+	struct StringHash
+	{
+		size_t operator()(const std::string* string) const { return std::hash<std::string>()(*string); }
+	};
+
+	struct StringEqual
+	{
+		bool operator()(const std::string* a, const std::string* b) const { return *a == *b; }
+	};
+
+	// The usual alternative: every insert locks one of a fixed number of std::unordered_map shards
+	class ShardedMutexMap
+	{
+	public:
+		void Add(const std::string* key)
+		{
+			Shard& shard = Shards[StringHash()(key) % SHARD_COUNT];
+			std::lock_guard<std::mutex> lock(shard.Mutex);
+			++shard.Counts[key];
+		}
+
+		size_t GetSize() const
+		{
+			size_t size = 0;
+			for (const Shard& shard : Shards)
+				size += shard.Counts.size();
+			return size;
+		}
+
+	private:
+		struct Shard
+		{
+			std::mutex Mutex;
+			std::unordered_map<const std::string*, uint64_t, StringHash, StringEqual> Counts;
+		};
+
+		Shard Shards[SHARD_COUNT];
+	};
+
+	struct ShardedChunk
+	{
+		const std::vector<std::string>* Strings = nullptr;
+		size_t Begin = 0;
+		size_t End = 0;
+		ShardedMutexMap* Map = nullptr;
+	};
+
+	void CountShardedChunk(Js::JobSystem&, void* data)
+	{
+		const auto chunk = static_cast<ShardedChunk*>(data);
+		for (size_t i = chunk->Begin; i < chunk->End; ++i)
+			chunk->Map->Add(&(*chunk->Strings)[i]);
+	}
+
+	size_t CountDistinctSharded(Js::JobSystem& jobSystem, const std::vector<std::string>& strings)
+	{
+		ShardedMutexMap map;
+		std::vector<ShardedChunk> chunks((strings.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+		std::vector<Js::Job> jobs;
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			chunks[i] = ShardedChunk{&strings, i * CHUNK_SIZE, std::min(strings.size(), (i + 1) * CHUNK_SIZE), &map};
+			jobs.emplace_back(CountShardedChunk, &chunks[i]);
+		}
+
+		Js::Counter counter;
+		jobSystem.AddJobs(jobs, &counter);
+		jobSystem.Wait(counter, 0);
+		return map.GetSize();
+	}
+
+	size_t CountDistinctSingleThread(const std::vector<std::string>& strings)
+	{
+		std::unordered_map<std::string, uint64_t> counts;
+		for (const std::string& string : strings)
+			++counts[string];
+		return counts.size();
+	}
+
+	// Words drawn with a skew towards the start of the vocabulary, like word frequencies in text
+	std::vector<std::string> GenerateStrings(const size_t count)
+	{
+		std::mt19937_64 random(42);
+		std::uniform_int_distribution<int> length(4, 16);
+		std::uniform_int_distribution<int> letter('a', 'z');
+		std::uniform_real_distribution<double> position(0.0, 1.0);
+
+		std::vector<std::string> vocabulary(std::max<size_t>(1, count / 8));
+		for (std::string& word : vocabulary)
+		{
+			for (int i = length(random); i > 0; --i)
+				word.push_back(static_cast<char>(letter(random)));
+		}
+
+		std::vector<std::string> strings(count);
+		for (std::string& string : strings)
+		{
+			const double skewed = position(random) * position(random);
+			string = vocabulary[static_cast<size_t>(skewed * static_cast<double>(vocabulary.size() - 1))];
+		}
+		return strings;
+	}
+
+	template <typename Function>
+	void Measure(const char* method, const size_t stringCount, Function function)
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		const size_t distinct = function();
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+		std::cout << stringCount << "," << distinct << "," << method << "," << elapsed.count() << std::endl;
+	}
+}
+
+// Usage: aggregate-bench [max strings]
+int RunAggregateBenchmark(Js::JobSystem& jobSystem, const int argc, char** argv)
+{
+	const size_t maxCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4000000;
+
+	std::cout << "strings,distinct,method,ms" << std::endl;
+	for (size_t count = 100000; count <= maxCount; count *= 4)
+	{
+		const std::vector<std::string> strings = GenerateStrings(count);
+
+		Measure("concurrent-map", count, [&] { return Js::CountDistinct(jobSystem, strings); });
+		Measure("sharded-mutex", count, [&] { return CountDistinctSharded(jobSystem, strings); });
+		Measure("single-thread", count, [&] { return CountDistinctSingleThread(strings); });
+	}
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include "Barrier.h"
+
+#include "WindowsMinimal.h"
+
+#include "JobSystem.h"
+#include "JSException.h"
+
+Js::Barrier::Barrier(JobSystem& system, const uint32_t count) :
+	Count(count),
+	System(&system)
+{
+	if (count == 0)
+		throw JsException("Barrier count must be positive");
+}
+
+void Js::Barrier::ArriveAndWait()
+{
+	Waiters.Lock();
+	const uint32_t phase = Phase.load(std::memory_order_relaxed);
+	if (++Arrived == Count)
+	{
+		Arrived = 0;
+		Phase.store(phase + 1, std::memory_order_release);
+		WaitList::Waiter* waiters = Waiters.PopAll();
+		Waiters.Unlock();
+
+		WaitList::ResumeAll(*System, waiters);
+		return;
+	}
+	Waiters.Unlock();
+
+	for (size_t i = 0; i < WaitList::SPIN_COUNT; ++i)
+	{
+		if (Phase.load(std::memory_order_acquire) != phase)
+			return;
+
+		_mm_pause();
+	}
+
+	// The phase only advances under the list lock, so checking it again here cannot miss the release
+	Waiters.Lock();
+	if (Phase.load(std::memory_order_relaxed) != phase)
+	{
+		Waiters.Unlock();
+		return;
+	}
+
+	Waiters.Park(*System);
+}
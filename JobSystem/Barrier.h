@@ -0,0 +1,27 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "WaitList.h"
+
+namespace Js
+{
+	class JobSystem;
+
+	class Barrier
+	{
+	public:
+		Barrier(JobSystem& system, uint32_t count);
+		Barrier(const Barrier&) = delete;
+		~Barrier() = default;
+
+		void ArriveAndWait();
+
+	private:
+		uint32_t Count;
+		uint32_t Arrived = 0;
+		std::atomic<uint32_t> Phase{0};
+		JobSystem* System;
+		WaitList Waiters;
+	};
+}
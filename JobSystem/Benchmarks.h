@@ -0,0 +1,13 @@
+#pragma once
+
+namespace Js
+{
+	class JobSystem;
+}
+
+int RunAggregateBenchmark(Js::JobSystem& jobSystem, int argc, char** argv);
+int RunExternalSortBenchmark(Js::JobSystem& jobSystem, int argc, char** argv);
+int RunQueueBenchmark(int argc, char** argv);
+int RunRemoteJobBenchmark(Js::JobSystem& jobSystem, int argc, char** argv);
+int RunSchedulerBenchmark(int argc, char** argv);
+int RunSharedJobBenchmark(Js::JobSystem& jobSystem, int argc, char** argv);
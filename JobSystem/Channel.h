@@ -0,0 +1,302 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <immintrin.h>
+
+#include "JSException.h"
+#include "Queue.h"
+#include "WaitList.h"
+
+namespace Js
+{
+	class JobSystem;
+
+	// Bounded multi-producer multi-consumer channel over a Queue ring. A sender finding the channel full and a
+	// receiver finding it empty spin briefly and then park their fiber (or thread) until the other side makes
+	// progress, so pipeline stages stream through a fixed amount of memory
+	template <typename T>
+	class Channel
+	{
+	public:
+		// Capacity is rounded up to a power of two
+		Channel(JobSystem& system, size_t capacity, MemoryResource* resource = nullptr);
+		Channel(const Channel&) = delete;
+		~Channel() = default;
+
+		// Suspends while the channel is full, throws once it is closed
+		void Send(const T& value);
+		// Sends every element, waking receivers once per run of elements that fit
+		template <typename Iterator>
+		void SendBatch(Iterator begin, Iterator end);
+		bool TrySend(const T& value);
+
+		// Suspends while the channel is empty, false once it is closed and drained
+		bool Receive(T& value);
+		// Waits for at least one element and takes up to maxCount, 0 once the channel is closed and drained
+		size_t ReceiveBatch(T* values, size_t maxCount);
+		bool TryReceive(T& value);
+
+		// Senders fail from now on, receivers drain what is left and then stop. Every element is either sent before
+		// Close returns or its send throws
+		void Close();
+		bool IsClosed() const { return (SendState.load(std::memory_order_acquire) & CLOSED_BIT) != 0; }
+
+	private:
+		// Set in SendState once closed, the bits below count senders in the middle of putting elements in the ring
+		static constexpr uint32_t CLOSED_BIT = 1u << 31;
+
+		JobSystem* System;
+		Queue<T> Ring;
+		std::atomic<uint32_t> SendState{0};
+
+		// Counted under the wait list lock before the last check, so the other side can skip the lock while zero
+		WaitList Senders;
+		std::atomic<uint32_t> WaitingSenders{0};
+		WaitList Receivers;
+		std::atomic<uint32_t> WaitingReceivers{0};
+
+		static size_t GetRingSize(size_t capacity);
+
+		// Closed and no sender can put another element in the ring
+		bool IsDrainable() const { return SendState.load(std::memory_order_acquire) == CLOSED_BIT; }
+		void BeginSend();
+		void EndSend();
+
+		template <typename Iterator>
+		size_t TrySendSome(Iterator& begin, Iterator end);
+		size_t TryReceiveSome(T* values, size_t maxCount);
+
+		void ParkSender();
+		void ParkReceiver();
+		static void Wake(JobSystem& system, WaitList& waiters, std::atomic<uint32_t>& waiting, size_t count);
+	};
+
+	template <typename T>
+	Channel<T>::Channel(JobSystem& system, const size_t capacity, MemoryResource* resource) :
+		System(&system),
+		Ring(GetRingSize(capacity), resource) {}
+
+	template <typename T>
+	size_t Channel<T>::GetRingSize(const size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		return size;
+	}
+
+	template <typename T>
+	void Channel<T>::BeginSend()
+	{
+		// Close waits for the senders counted here, so an element is never put in the ring after receivers drained it
+		if ((SendState.fetch_add(1, std::memory_order_acquire) & CLOSED_BIT) != 0)
+		{
+			EndSend();
+			throw JsException("Channel is closed");
+		}
+	}
+
+	template <typename T>
+	void Channel<T>::EndSend()
+	{
+		SendState.fetch_sub(1, std::memory_order_release);
+	}
+
+	template <typename T>
+	bool Channel<T>::TrySend(const T& value)
+	{
+		BeginSend();
+		const bool sent = Ring.Enqueue(value);
+		EndSend();
+		if (!sent)
+			return false;
+
+		Wake(*System, Receivers, WaitingReceivers, 1);
+		return true;
+	}
+
+	template <typename T>
+	template <typename Iterator>
+	size_t Channel<T>::TrySendSome(Iterator& begin, const Iterator end)
+	{
+		BeginSend();
+		size_t sent = 0;
+		while (begin != end && Ring.Enqueue(*begin))
+		{
+			++begin;
+			++sent;
+		}
+		EndSend();
+		return sent;
+	}
+
+	template <typename T>
+	void Channel<T>::Send(const T& value)
+	{
+		const T* begin = &value;
+		SendBatch(begin, begin + 1);
+	}
+
+	template <typename T>
+	template <typename Iterator>
+	void Channel<T>::SendBatch(Iterator begin, const Iterator end)
+	{
+		size_t spins = 0;
+		while (begin != end)
+		{
+			const size_t sent = TrySendSome(begin, end);
+			if (sent != 0)
+			{
+				Wake(*System, Receivers, WaitingReceivers, sent);
+				spins = 0;
+				continue;
+			}
+
+			if (spins++ < WaitList::SPIN_COUNT)
+			{
+				_mm_pause();
+				continue;
+			}
+
+			ParkSender();
+			spins = 0;
+		}
+	}
+
+	template <typename T>
+	size_t Channel<T>::TryReceiveSome(T* values, const size_t maxCount)
+	{
+		size_t received = 0;
+		while (received < maxCount && Ring.Dequeue(values[received]))
+			++received;
+		return received;
+	}
+
+	template <typename T>
+	bool Channel<T>::TryReceive(T& value)
+	{
+		if (!Ring.Dequeue(value))
+			return false;
+
+		Wake(*System, Senders, WaitingSenders, 1);
+		return true;
+	}
+
+	template <typename T>
+	bool Channel<T>::Receive(T& value)
+	{
+		return ReceiveBatch(&value, 1) != 0;
+	}
+
+	template <typename T>
+	size_t Channel<T>::ReceiveBatch(T* values, const size_t maxCount)
+	{
+		if (maxCount == 0)
+			return 0;
+
+		size_t spins = 0;
+		for (;;)
+		{
+			const size_t received = TryReceiveSome(values, maxCount);
+			if (received != 0)
+			{
+				Wake(*System, Senders, WaitingSenders, received);
+				return received;
+			}
+
+			// Elements sent before Close are visible once no sender is left
+			if (IsDrainable())
+			{
+				const size_t drained = TryReceiveSome(values, maxCount);
+				if (drained != 0)
+					Wake(*System, Senders, WaitingSenders, drained);
+				return drained;
+			}
+
+			if (spins++ < WaitList::SPIN_COUNT)
+			{
+				_mm_pause();
+				continue;
+			}
+
+			ParkReceiver();
+			spins = 0;
+		}
+	}
+
+	template <typename T>
+	void Channel<T>::ParkSender()
+	{
+		Senders.Lock();
+		WaitingSenders.fetch_add(1, std::memory_order_relaxed);
+		// Pairs with the fence in Wake, either the receiver sees this sender counted or the sender sees the free slot
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (IsClosed() || !Ring.IsFull())
+		{
+			WaitingSenders.fetch_sub(1, std::memory_order_relaxed);
+			Senders.Unlock();
+			return;
+		}
+
+		Senders.Park(*System);
+	}
+
+	template <typename T>
+	void Channel<T>::ParkReceiver()
+	{
+		Receivers.Lock();
+		WaitingReceivers.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (IsClosed() || !Ring.IsEmpty())
+		{
+			WaitingReceivers.fetch_sub(1, std::memory_order_relaxed);
+			Receivers.Unlock();
+			return;
+		}
+
+		Receivers.Park(*System);
+	}
+
+	template <typename T>
+	void Channel<T>::Wake(JobSystem& system, WaitList& waiters, std::atomic<uint32_t>& waiting, size_t count)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiting.load(std::memory_order_relaxed) == 0)
+			return;
+
+		waiters.Lock();
+		WaitList::Waiter* woken = nullptr;
+		WaitList::Waiter* last = nullptr;
+		for (; count != 0; --count)
+		{
+			WaitList::Waiter* waiter = waiters.PopFront();
+			if (waiter == nullptr)
+				break;
+
+			waiting.fetch_sub(1, std::memory_order_relaxed);
+			if (last != nullptr)
+				last->Next = waiter;
+			else
+				woken = waiter;
+			last = waiter;
+		}
+		waiters.Unlock();
+
+		WaitList::ResumeAll(system, woken);
+	}
+
+	template <typename T>
+	void Channel<T>::Close()
+	{
+		SendState.fetch_or(CLOSED_BIT, std::memory_order_seq_cst);
+		while (!IsDrainable())
+			_mm_pause();
+
+		Wake(*System, Senders, WaitingSenders, SIZE_MAX);
+		Wake(*System, Receivers, WaitingReceivers, SIZE_MAX);
+	}
+}
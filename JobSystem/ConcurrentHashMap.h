@@ -0,0 +1,161 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+
+#include <immintrin.h>
+
+#include "JSException.h"
+
+namespace Js
+{
+	// Fixed capacity open-addressing map with linear probing. Distinct keys are inserted with a single CAS on
+	// the slot state, a value that is combined with an existing one is updated under a per slot spin lock.
+	// Entries are never erased and the table does not grow, it is sized to stay at most half full with
+	// expectedSize distinct keys
+	template <typename K, typename V, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>>
+	class ConcurrentHashMap
+	{
+	public:
+		explicit ConcurrentHashMap(size_t expectedSize, const Hash& hash = Hash(), const Equal& equal = Equal());
+		ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+		ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+		~ConcurrentHashMap();
+
+		// Inserts the pair, or calls combine(existing, value) when the key is already present.
+		// Returns true when the key was inserted
+		template <typename Combine>
+		bool Merge(const K& key, const V& value, Combine combine);
+
+		// Must not run concurrently with Merge
+		template <typename Function>
+		void ForEach(Function function) const { ForEachInRange(0, Capacity, function); }
+		template <typename Function>
+		void ForEachInRange(size_t begin, size_t end, Function function) const;
+
+		size_t GetSize() const { return Size.load(std::memory_order_relaxed); }
+		size_t GetCapacity() const { return Capacity; }
+
+	private:
+		enum SlotState : uint32_t
+		{
+			Empty,
+			Locked,
+			Ready
+		};
+
+		struct Slot
+		{
+			std::atomic<uint32_t> State{Empty};
+			K Key;
+			V Value;
+		};
+
+		Slot* Slots;
+		size_t Capacity;
+		size_t Mask;
+		std::atomic<size_t> Size{0};
+
+		Hash HashFunction;
+		Equal EqualFunction;
+
+		static size_t GetCapacityFor(size_t expectedSize);
+		uint32_t WaitUntilUnlocked(const Slot& slot) const;
+	};
+
+	template <typename K, typename V, typename Hash, typename Equal>
+	ConcurrentHashMap<K, V, Hash, Equal>::ConcurrentHashMap(const size_t expectedSize, const Hash& hash,
+	                                                       const Equal& equal) :
+		Slots(nullptr), Capacity(GetCapacityFor(expectedSize)), Mask(Capacity - 1), HashFunction(hash),
+		EqualFunction(equal)
+	{
+		Slots = static_cast<Slot*>(::operator new(sizeof(Slot) * Capacity));
+		for (size_t i = 0; i < Capacity; ++i)
+			new(&Slots[i]) Slot();
+	}
+
+	template <typename K, typename V, typename Hash, typename Equal>
+	ConcurrentHashMap<K, V, Hash, Equal>::~ConcurrentHashMap()
+	{
+		for (size_t i = 0; i < Capacity; ++i)
+			Slots[i].~Slot();
+		::operator delete(Slots);
+	}
+
+	template <typename K, typename V, typename Hash, typename Equal>
+	size_t ConcurrentHashMap<K, V, Hash, Equal>::GetCapacityFor(const size_t expectedSize)
+	{
+		size_t capacity = 16;
+		while (capacity < expectedSize * 2)
+			capacity <<= 1;
+		return capacity;
+	}
+
+	template <typename K, typename V, typename Hash, typename Equal>
+	uint32_t ConcurrentHashMap<K, V, Hash, Equal>::WaitUntilUnlocked(const Slot& slot) const
+	{
+		uint32_t state = slot.State.load(std::memory_order_acquire);
+		while (state == Locked)
+		{
+			_mm_pause();
+			state = slot.State.load(std::memory_order_acquire);
+		}
+		return state;
+	}
+
+	template <typename K, typename V, typename Hash, typename Equal>
+	template <typename Combine>
+	bool ConcurrentHashMap<K, V, Hash, Equal>::Merge(const K& key, const V& value, Combine combine)
+	{
+		size_t index = HashFunction(key) & Mask;
+		for (size_t probes = 0; probes < Capacity; ++probes, index = (index + 1) & Mask)
+		{
+			Slot& slot = Slots[index];
+			uint32_t state = slot.State.load(std::memory_order_acquire);
+
+			if (state == Empty)
+			{
+				if (slot.State.compare_exchange_strong(state, Locked, std::memory_order_acquire))
+				{
+					slot.Key = key;
+					slot.Value = value;
+					slot.State.store(Ready, std::memory_order_release);
+					Size.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+
+			// Keys never change once a slot is ready, only the value is updated under the lock
+			if (WaitUntilUnlocked(slot) != Ready || !EqualFunction(slot.Key, key))
+				continue;
+
+			for (;;)
+			{
+				uint32_t expected = Ready;
+				if (slot.State.compare_exchange_weak(expected, Locked, std::memory_order_acquire))
+					break;
+				_mm_pause();
+			}
+
+			combine(slot.Value, value);
+			slot.State.store(Ready, std::memory_order_release);
+			return false;
+		}
+
+		throw JsException("Hash map is full");
+	}
+
+	template <typename K, typename V, typename Hash, typename Equal>
+	template <typename Function>
+	void ConcurrentHashMap<K, V, Hash, Equal>::ForEachInRange(const size_t begin, const size_t end,
+	                                                         Function function) const
+	{
+		for (size_t i = begin; i < end && i < Capacity; ++i)
+		{
+			if (Slots[i].State.load(std::memory_order_acquire) == Ready)
+				function(Slots[i].Key, Slots[i].Value);
+		}
+	}
+}
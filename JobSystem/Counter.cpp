@@ -1,4 +1,7 @@
 #include "Counter.h"
+
+#include "WindowsMinimal.h"
+
 #include "JobSystem.h"
 #include "Log.h"
 
@@ -12,7 +15,9 @@ Js::Counter::Unit Js::Counter::Increment(const Unit value)
 Js::Counter::Unit Js::Counter::Decrement(const Unit value)
 {
 	const Unit oldValue = Value.fetch_sub(value);
-	CheckWaiters(oldValue - value);
+	// Sharded counters are only waited on for zero, other values may be skipped over
+	if (Mode == CounterMode::Shared || oldValue == value)
+		CheckWaiters(oldValue - value);
 	return oldValue;
 }
 
@@ -24,6 +29,18 @@ Js::Counter::Unit Js::Counter::GetValue() const
 bool Js::Counter::AddWaiter(const uint16_t fiberId, std::atomic_bool* isFiberStored, const Unit targetValue)
 {
 	assert(isFiberStored != nullptr);
+	return AddWaiterSlot(fiberId, isFiberStored, nullptr, targetValue);
+}
+
+bool Js::Counter::AddThreadWaiter(std::atomic<uint32_t>* threadEvent, const Unit targetValue)
+{
+	assert(threadEvent != nullptr);
+	return AddWaiterSlot(UINT16_MAX, nullptr, threadEvent, targetValue);
+}
+
+bool Js::Counter::AddWaiterSlot(const uint16_t fiberId, std::atomic_bool* isFiberStored,
+                                std::atomic<uint32_t>* threadEvent, const Unit targetValue)
+{
 	for (size_t i = 0; i < MAX_WAITERS; ++i)
 	{
 		bool expected = true;
@@ -35,6 +52,7 @@ bool Js::Counter::AddWaiter(const uint16_t fiberId, std::atomic_bool* isFiberSto
 		assert(slot != nullptr);
 		slot->FiberId = fiberId;
 		slot->IsFiberStored = isFiberStored;
+		slot->ThreadEvent = threadEvent;
 		slot->TargetValue = targetValue;
 
 		slot->IsInUse.store(false);
@@ -57,7 +75,10 @@ bool Js::Counter::AddWaiter(const uint16_t fiberId, std::atomic_bool* isFiberSto
 			FreeWaiters[i].store(true, std::memory_order_release);
 			return true;
 		}
-		Log::Info("Counter::AddWaiter: Fiber %d is waiting in slot %d on thread %d\n", fiberId, i, System->GetCurrentTls().ThreadIndex);
+		if (threadEvent != nullptr)
+			Log::Info("Counter::AddWaiter: External thread is waiting in slot %zu\n", i);
+		else
+			Log::Info("Counter::AddWaiter: Fiber %d is waiting in slot %d on thread %d\n", fiberId, i, System->GetCurrentTls().ThreadIndex);
 
 		return false;
 	}
@@ -76,6 +97,12 @@ void Js::Counter::Initialize(JobSystem* system, const uint32_t initialValue)
 
 void Js::Counter::CheckWaiters(const Unit value)
 {
+	// Waiters may destroy the counter as soon as they are woken, so everyone is woken after the scan
+	std::array<std::atomic<uint32_t>*, MAX_WAITERS> threadEvents;
+	size_t threadEventCount = 0;
+	std::array<ReadyFiber, MAX_WAITERS> fibers;
+	size_t fiberCount = 0;
+
 	for (size_t i = 0; i < MAX_WAITERS; ++i)
 	{
 		if (FreeWaiters[i].load(std::memory_order_acquire))
@@ -92,10 +119,26 @@ void Js::Counter::CheckWaiters(const Unit value)
 			                                                  std::memory_order_seq_cst, std::memory_order_relaxed))
 				continue;
 
-			System->GetCurrentTls().ReadyFibers.emplace_back(waiter->FiberId, waiter->IsFiberStored);
-			Log::Info("Counter::CheckWaiters: Fiber %d is ready with fiber stored %d\n", waiter->FiberId, waiter->IsFiberStored->load(std::memory_order_relaxed));
+			if (waiter->ThreadEvent != nullptr)
+			{
+				threadEvents[threadEventCount++] = waiter->ThreadEvent;
+				Log::Info("Counter::CheckWaiters: External thread waiting in slot %zu is released\n", i);
+			}
+			else
+			{
+				fibers[fiberCount++] = ReadyFiber(waiter->FiberId, waiter->IsFiberStored);
+				Log::Info("Counter::CheckWaiters: Fiber %d waiting in slot %zu is ready\n", waiter->FiberId, i);
+			}
 			FreeWaiters[i].store(true, std::memory_order_release);
-			Log::Info("Counter::CheckWaiters: Fiber %d is ready\n", waiter->FiberId);
 		}
 	}
+
+	for (size_t i = 0; i < fiberCount; ++i)
+		System->ResumeFiber(fibers[i].first, fibers[i].second);
+
+	for (size_t i = 0; i < threadEventCount; ++i)
+	{
+		threadEvents[i]->store(1, std::memory_order_release);
+		WakeByAddressSingle(threadEvents[i]);
+	}
 }
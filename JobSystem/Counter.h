@@ -9,15 +9,34 @@ namespace Js
 {
 	class JobSystem;
 
+	enum class CounterMode : uint8_t
+	{
+		// Every finished job decrements the value and checks the waiters
+		Shared,
+		// Workers add up the finished jobs of the counter they run back to back and apply them in one decrement
+		// once they move on to other work or go idle, so a wide AddJobs batch costs a few decrements per worker
+		// instead of one contended decrement per job. The value lags behind the finished jobs meanwhile and can only
+		// be waited on for zero
+		Sharded
+	};
+
 	class Counter
 	{
 	public:
 		Counter() = default;
+		explicit Counter(const CounterMode mode) : Mode(mode) {}
 		~Counter() = default;
 
+		bool IsSharded() const { return Mode == CounterMode::Sharded; }
+
 	private:
 		friend class JobSystem;
 		friend class Job;
+		friend class IoSystem;
+		friend class JobGraph;
+		friend class RemoteCoordinator;
+		friend class RemoteWorker;
+		friend class TimerWheel;
 
 		using Unit = uint32_t;
 
@@ -25,6 +44,7 @@ namespace Js
 		{
 			uint16_t FiberId = 0;
 			std::atomic_bool* IsFiberStored = nullptr;
+			std::atomic<uint32_t>* ThreadEvent = nullptr;
 			Unit TargetValue = 0;
 			std::atomic_bool IsInUse{true};
 		};
@@ -35,14 +55,19 @@ namespace Js
 		Unit GetValue() const;
 
 		bool AddWaiter(uint16_t fiberId, std::atomic_bool* isFiberStored, Unit targetValue);
+		bool AddThreadWaiter(std::atomic<uint32_t>* threadEvent, Unit targetValue);
 		void Initialize(JobSystem* system, uint32_t initialValue = 0);
 		void CheckWaiters(Unit value);
 
+		bool AddWaiterSlot(uint16_t fiberId, std::atomic_bool* isFiberStored, std::atomic<uint32_t>* threadEvent,
+		                   Unit targetValue);
+
 		constexpr static size_t MAX_WAITERS = 16;
 		std::array<WaiterFiber, MAX_WAITERS> Waiters;
 		std::array<std::atomic_bool, MAX_WAITERS> FreeWaiters;
 
 		std::atomic<Unit> Value{0};
 		JobSystem* System = nullptr;
+		CounterMode Mode = CounterMode::Shared;
 	};
 }
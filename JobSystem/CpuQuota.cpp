@@ -0,0 +1,81 @@
+#include "CpuQuota.h"
+
+#include <cstdint>
+#include <thread>
+
+#include "WindowsMinimal.h"
+
+namespace
+{
+	DWORD_PTR GetProcessMask()
+	{
+		DWORD_PTR processMask = 0;
+		DWORD_PTR systemMask = 0;
+		if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+			return 0;
+
+		return processMask;
+	}
+
+	size_t CountBits(DWORD_PTR mask)
+	{
+		size_t count = 0;
+		for (; mask != 0; mask &= mask - 1)
+			++count;
+		return count;
+	}
+
+	size_t GetJobObjectCpuLimit(const size_t systemCpus)
+	{
+		JOBOBJECT_CPU_RATE_CONTROL_INFORMATION info{};
+		if (!QueryInformationJobObject(nullptr, JobObjectCpuRateControlInformation, &info, sizeof(info), nullptr))
+			return SIZE_MAX;
+
+		if ((info.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE) == 0)
+			return SIZE_MAX;
+
+		// Rates are in hundredths of a percent of all system CPUs
+		DWORD rate;
+		if (info.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP)
+			rate = info.CpuRate;
+		else if (info.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_MIN_MAX_RATE)
+			rate = info.MaxRate;
+		else
+			return SIZE_MAX;
+
+		const uint64_t limit = (static_cast<uint64_t>(rate) * systemCpus + 9999) / 10000;
+		return limit == 0 ? 1 : static_cast<size_t>(limit);
+	}
+}
+
+size_t Js::GetAvailableCpuCount()
+{
+	size_t systemCpus = std::thread::hardware_concurrency();
+	if (systemCpus == 0)
+		systemCpus = 1;
+
+	size_t count = CountBits(GetProcessMask());
+	if (count == 0 || count > systemCpus)
+		count = systemCpus;
+
+	const size_t limit = GetJobObjectCpuLimit(systemCpus);
+	if (limit < count)
+		count = limit;
+
+	return count;
+}
+
+size_t Js::GetWorkerCpu(const size_t worker)
+{
+	const DWORD_PTR mask = GetProcessMask();
+	size_t allowed = 0;
+	for (size_t cpu = 0; cpu < sizeof(DWORD_PTR) * 8; ++cpu)
+	{
+		if ((mask & static_cast<DWORD_PTR>(1) << cpu) == 0)
+			continue;
+
+		if (allowed++ == worker)
+			return cpu;
+	}
+	return SIZE_MAX;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+
+namespace Js
+{
+	// CPUs this process may use: the affinity mask capped by a hard CPU rate limit on the enclosing job object
+	size_t GetAvailableCpuCount();
+
+	// CPU to pin the given worker to, SIZE_MAX when there are more workers than CPUs in the affinity mask
+	size_t GetWorkerCpu(size_t worker);
+}
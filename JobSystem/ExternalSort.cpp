@@ -0,0 +1,940 @@
+#include "ExternalSort.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "Channel.h"
+#include "Counter.h"
+#include "File.h"
+#include "Job.h"
+#include "JobSystem.h"
+#include "JSException.h"
+#include "Log.h"
+
+namespace
+{
+	constexpr size_t MAX_IO_SIZE = 1u << 30;
+	constexpr size_t MIN_MERGE_BUFFER_SIZE = 64u << 10;
+	constexpr size_t CHUNK_READ_SIZE = 4u << 20;
+	constexpr char RUN_INDEX_MAGIC[8] = {'J', 'S', 'R', 'U', 'N', 'I', 'D', 'X'};
+
+	struct Sample
+	{
+		std::string Line;
+		uint64_t Offset;
+	};
+
+	struct Run
+	{
+		std::string Path;
+		uint64_t Size = 0;
+		std::vector<Sample> Samples;
+		// Kept in the run cache instead of removed after merging
+		bool Cached = false;
+	};
+
+	struct Line
+	{
+		const char* Data;
+		uint32_t Size;
+
+		bool operator<(const Line& other) const
+		{
+			const int result = std::memcmp(Data, other.Data, std::min(Size, other.Size));
+			return result != 0 ? result < 0 : Size < other.Size;
+		}
+	};
+
+	class RunWriter
+	{
+	public:
+		RunWriter(Js::File& file, const uint64_t offset, const size_t bufferSize, std::vector<Sample>* samples,
+		          const size_t sampleInterval) :
+			File(file), Offset(offset), BufferSize(bufferSize), Samples(samples), SampleInterval(sampleInterval)
+		{
+			Buffer.reserve(bufferSize);
+		}
+
+		void Append(const char* data, const size_t size)
+		{
+			if (Samples != nullptr && (Samples->empty() || Written - LastSample >= SampleInterval))
+			{
+				Samples->push_back(Sample{std::string(data, size), Offset + Buffer.size()});
+				LastSample = Written;
+			}
+
+			Buffer.append(data, size);
+			Buffer.push_back('\n');
+			Written += size + 1;
+
+			if (Buffer.size() >= BufferSize)
+				Flush();
+		}
+
+		void Flush()
+		{
+			for (size_t position = 0; position < Buffer.size();)
+			{
+				const auto size = static_cast<uint32_t>(std::min(MAX_IO_SIZE, Buffer.size() - position));
+				const uint32_t written = File.Write(Buffer.data() + position, size, Offset);
+				if (written == 0)
+					throw Js::JsException("Failed to write sorted data");
+
+				position += written;
+				Offset += written;
+			}
+			Buffer.clear();
+		}
+
+		uint64_t GetWritten() const { return Written; }
+
+	private:
+		Js::File& File;
+		uint64_t Offset;
+		size_t BufferSize;
+		std::string Buffer;
+
+		std::vector<Sample>* Samples;
+		size_t SampleInterval;
+		uint64_t Written = 0;
+		uint64_t LastSample = 0;
+	};
+
+	class RunReader
+	{
+	public:
+		RunReader(Js::File& file, const uint64_t begin, const uint64_t end, const size_t bufferSize) :
+			File(file), Position(begin), End(end), BufferSize(bufferSize) {}
+
+		bool Next()
+		{
+			for (;;)
+			{
+				const size_t newline = Buffer.find('\n', Cursor);
+				if (newline != std::string::npos)
+				{
+					CurrentOffset = Position - (Buffer.size() - Cursor);
+					Current.assign(Buffer, Cursor, newline - Cursor);
+					Cursor = newline + 1;
+					return true;
+				}
+
+				if (!Fill())
+					break;
+			}
+
+			if (Cursor >= Buffer.size())
+				return false;
+
+			CurrentOffset = Position - (Buffer.size() - Cursor);
+			Current.assign(Buffer, Cursor, std::string::npos);
+			Cursor = Buffer.size();
+			return true;
+		}
+
+		const std::string& GetCurrent() const { return Current; }
+		uint64_t GetCurrentOffset() const { return CurrentOffset; }
+
+	private:
+		bool Fill()
+		{
+			Buffer.erase(0, Cursor);
+			Cursor = 0;
+			if (Position >= End)
+				return false;
+
+			const size_t oldSize = Buffer.size();
+			const auto size = static_cast<uint32_t>(std::min<uint64_t>(std::min(BufferSize, MAX_IO_SIZE), End - Position));
+			Buffer.resize(oldSize + size);
+
+			const uint32_t read = File.Read(&Buffer[oldSize], size, Position);
+			Buffer.resize(oldSize + read);
+			Position += read;
+			return read != 0;
+		}
+
+		Js::File& File;
+		uint64_t Position;
+		uint64_t End;
+		size_t BufferSize;
+
+		std::string Buffer;
+		size_t Cursor = 0;
+
+		std::string Current;
+		uint64_t CurrentOffset = 0;
+	};
+
+	class LoserTree
+	{
+	public:
+		explicit LoserTree(std::vector<RunReader*> sources) :
+			Sources(std::move(sources)),
+			Exhausted(Sources.size(), false),
+			Tree(Sources.size(), 0)
+		{
+			for (size_t i = 0; i < Sources.size(); ++i)
+				Exhausted[i] = !Sources[i]->Next();
+
+			if (!Sources.empty())
+				Tree[0] = Build(1);
+		}
+
+		RunReader* Top() const
+		{
+			if (Sources.empty() || Exhausted[Tree[0]])
+				return nullptr;
+
+			return Sources[Tree[0]];
+		}
+
+		void Pop()
+		{
+			size_t winner = Tree[0];
+			Exhausted[winner] = !Sources[winner]->Next();
+
+			for (size_t node = (winner + Sources.size()) / 2; node > 0; node /= 2)
+			{
+				if (Less(Tree[node], winner))
+					std::swap(Tree[node], winner);
+			}
+			Tree[0] = winner;
+		}
+
+	private:
+		std::vector<RunReader*> Sources;
+		std::vector<bool> Exhausted;
+		// Tree[0] holds the winner, internal nodes 1..K-1 hold losers, leaves are implicit at K..2K-1
+		std::vector<size_t> Tree;
+
+		size_t Build(const size_t node)
+		{
+			if (node >= Sources.size())
+				return node - Sources.size();
+
+			const size_t left = Build(node * 2);
+			const size_t right = Build(node * 2 + 1);
+			if (Less(left, right))
+			{
+				Tree[node] = right;
+				return left;
+			}
+
+			Tree[node] = left;
+			return right;
+		}
+
+		bool Less(const size_t a, const size_t b) const
+		{
+			if (Exhausted[a])
+				return false;
+			if (Exhausted[b])
+				return true;
+
+			const int result = Sources[a]->GetCurrent().compare(Sources[b]->GetCurrent());
+			return result != 0 ? result < 0 : a < b;
+		}
+	};
+
+	struct SortChunkData
+	{
+		std::string Buffer;
+		Run Run;
+		size_t SampleInterval = 0;
+		size_t WriteBufferSize = 0;
+		uint64_t LineCount = 0;
+		// Gets the chunk back once its run is written when set
+		Js::Channel<SortChunkData*>* Sorted = nullptr;
+	};
+
+	struct ChunkSlot
+	{
+		SortChunkData Data;
+		Js::Counter Counter;
+		bool Busy = false;
+	};
+
+	struct MergeData
+	{
+		std::vector<Js::File*> Sources;
+		std::vector<std::pair<uint64_t, uint64_t>> Ranges;
+		Js::File* Output = nullptr;
+		uint64_t OutputOffset = 0;
+		std::vector<Sample>* Samples = nullptr;
+		size_t SampleInterval = 0;
+		size_t BufferSize = 0;
+		uint64_t Written = 0;
+	};
+
+	struct BoundaryData
+	{
+		Js::File* File = nullptr;
+		const Run* Run = nullptr;
+		const std::vector<std::string>* Splitters = nullptr;
+		size_t BufferSize = 0;
+		std::vector<uint64_t> Offsets;
+	};
+
+	void SortChunk(Js::JobSystem& jobSystem, void* data)
+	{
+		auto* chunk = static_cast<SortChunkData*>(data);
+		const std::string& buffer = chunk->Buffer;
+
+		std::vector<Line> lines;
+		size_t begin = 0;
+		while (begin < buffer.size())
+		{
+			size_t end = buffer.find('\n', begin);
+			if (end == std::string::npos)
+				end = buffer.size();
+
+			size_t lineEnd = end;
+			if (lineEnd > begin && buffer[lineEnd - 1] == '\r')
+				--lineEnd;
+
+			lines.push_back(Line{buffer.data() + begin, static_cast<uint32_t>(lineEnd - begin)});
+			begin = end + 1;
+		}
+
+		std::sort(lines.begin(), lines.end());
+
+		Js::File file;
+		file.Open(jobSystem, chunk->Run.Path.c_str(), Js::FileAccess::Write);
+
+		RunWriter writer(file, 0, chunk->WriteBufferSize, &chunk->Run.Samples, chunk->SampleInterval);
+		for (const Line& line : lines)
+			writer.Append(line.Data, line.Size);
+		writer.Flush();
+
+		chunk->Run.Size = writer.GetWritten();
+		chunk->LineCount = lines.size();
+
+		if (chunk->Sorted != nullptr)
+			chunk->Sorted->Send(chunk);
+	}
+
+	void MergeRanges(Js::JobSystem& jobSystem, void* data)
+	{
+		auto* merge = static_cast<MergeData*>(data);
+
+		std::vector<std::unique_ptr<RunReader>> readers;
+		std::vector<RunReader*> sources;
+		for (size_t i = 0; i < merge->Sources.size(); ++i)
+		{
+			if (merge->Ranges[i].first >= merge->Ranges[i].second)
+				continue;
+
+			readers.emplace_back(new RunReader(*merge->Sources[i], merge->Ranges[i].first, merge->Ranges[i].second,
+			                                   merge->BufferSize));
+			sources.push_back(readers.back().get());
+		}
+
+		LoserTree tree(std::move(sources));
+		RunWriter writer(*merge->Output, merge->OutputOffset, merge->BufferSize, merge->Samples,
+		                 merge->SampleInterval);
+		for (RunReader* top = tree.Top(); top != nullptr; top = tree.Top())
+		{
+			writer.Append(top->GetCurrent().data(), top->GetCurrent().size());
+			tree.Pop();
+		}
+		writer.Flush();
+
+		merge->Written = writer.GetWritten();
+	}
+
+	void FindBoundaries(Js::JobSystem& jobSystem, void* data)
+	{
+		auto* boundary = static_cast<BoundaryData*>(data);
+		const Run& run = *boundary->Run;
+
+		boundary->Offsets.push_back(0);
+		for (const std::string& splitter : *boundary->Splitters)
+		{
+			// Start at the last sample below the splitter, the exact boundary is at most one interval further
+			const auto sample = std::lower_bound(run.Samples.begin(), run.Samples.end(), splitter,
+			                                     [](const Sample& s, const std::string& key) { return s.Line < key; });
+			uint64_t start = sample == run.Samples.begin() ? 0 : std::prev(sample)->Offset;
+			start = std::max(start, boundary->Offsets.back());
+
+			uint64_t offset = run.Size;
+			RunReader reader(*boundary->File, start, run.Size, boundary->BufferSize);
+			while (reader.Next())
+			{
+				if (reader.GetCurrent() >= splitter)
+				{
+					offset = reader.GetCurrentOffset();
+					break;
+				}
+			}
+			boundary->Offsets.push_back(offset);
+		}
+		boundary->Offsets.push_back(run.Size);
+	}
+
+	std::string GetRunPath(const Js::ExternalSortOptions& options, const size_t pass, const size_t index)
+	{
+		return options.TempDirectory + "/run_" + std::to_string(pass) + "_" + std::to_string(index) + ".tmp";
+	}
+
+	std::vector<std::unique_ptr<Js::File>> OpenRuns(Js::JobSystem& system, const std::vector<Run>& runs,
+	                                                const size_t first, const size_t count)
+	{
+		std::vector<std::unique_ptr<Js::File>> files;
+		for (size_t i = first; i < first + count; ++i)
+		{
+			files.emplace_back(new Js::File());
+			files.back()->Open(system, runs[i].Path.c_str(), Js::FileAccess::Read);
+		}
+		return files;
+	}
+
+	void RemoveRuns(std::vector<Run>& runs)
+	{
+		for (const Run& run : runs)
+		{
+			if (!run.Cached)
+				std::remove(run.Path.c_str());
+		}
+		runs.clear();
+	}
+
+	std::vector<Run> GenerateRuns(Js::JobSystem& system, Js::File& input, const Js::ExternalSortOptions& options,
+	                              Js::ExternalSortStats& stats)
+	{
+		// A chunk in flight costs its text, its line index and a write buffer, so budget two run sizes per slot
+		const size_t slotCount = std::max<size_t>(1, options.MemoryBudget / (2 * options.RunSize));
+		std::vector<SortChunkData> slots(slotCount);
+		size_t usedSlots = 0;
+		// Sort jobs send their slot back when done, so reading refills whichever slot finished first
+		Js::Channel<SortChunkData*> sorted(system, slotCount);
+		Js::Counter sorting;
+		std::vector<Run> runs;
+
+		const auto collect = [&]
+		{
+			SortChunkData* slot = nullptr;
+			sorted.Receive(slot);
+			stats.LineCount += slot->LineCount;
+			runs.push_back(std::move(slot->Run));
+			return slot;
+		};
+
+		const uint64_t size = input.GetSize();
+		uint64_t offset = 0;
+		std::string carry;
+
+		for (size_t index = 0; offset < size || !carry.empty(); ++index)
+		{
+			SortChunkData& slot = usedSlots < slotCount ? slots[usedSlots++] : *collect();
+
+			std::string& buffer = slot.Buffer;
+			buffer.swap(carry);
+			carry.clear();
+
+			size_t newline = std::string::npos;
+			while (offset < size && (buffer.size() < options.RunSize || newline == std::string::npos))
+			{
+				const size_t oldSize = buffer.size();
+				const size_t want = oldSize < options.RunSize ? options.RunSize - oldSize : options.RunSize;
+				const auto chunkSize = static_cast<uint32_t>(std::min<uint64_t>(std::min(want, MAX_IO_SIZE),
+				                                                                  size - offset));
+				buffer.resize(oldSize + chunkSize);
+
+				const uint32_t read = input.Read(&buffer[oldSize], chunkSize, offset);
+				if (read == 0)
+					throw Js::JsException("Unexpected end of external sort input");
+
+				buffer.resize(oldSize + read);
+				offset += read;
+
+				newline = buffer.rfind('\n');
+			}
+
+			if (offset < size)
+			{
+				carry.assign(buffer, newline + 1, std::string::npos);
+				buffer.resize(newline + 1);
+			}
+
+			slot.Run = Run();
+			slot.Run.Path = GetRunPath(options, 0, index);
+			slot.SampleInterval = options.SampleInterval;
+			slot.WriteBufferSize = std::min(options.RunSize, MAX_IO_SIZE);
+			slot.LineCount = 0;
+			slot.Sorted = &sorted;
+
+			Js::Job job{SortChunk, &slot};
+			system.AddJob(job, &sorting);
+		}
+
+		for (size_t i = 0; i < usedSlots; ++i)
+			collect();
+		// The last jobs may still be inside Send after their slot was received
+		system.Wait(sorting, 0);
+
+		return runs;
+	}
+
+	std::array<uint64_t, 256> MakeGearTable()
+	{
+		// splitmix64 from a fixed seed, chunk boundaries must not change between runs
+		std::array<uint64_t, 256> table{};
+		uint64_t state = 0;
+		for (uint64_t& entry : table)
+		{
+			state += 0x9E3779B97F4A7C15ull;
+			uint64_t value = state;
+			value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+			value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+			entry = value ^ (value >> 31);
+		}
+		return table;
+	}
+
+	const std::array<uint64_t, 256> GEAR_TABLE = MakeGearTable();
+
+	// Cuts a stream at the first line break after the rolling gear hash of the last 64 bytes matches the mask,
+	// so boundaries depend only on nearby content and an edit moves at most the boundaries next to it
+	class Chunker
+	{
+	public:
+		explicit Chunker(const size_t averageSize) :
+			MinSize(averageSize / 4),
+			MaxSize(averageSize * 4)
+		{
+			uint32_t bits = 0;
+			while ((2ull << bits) <= averageSize - MinSize)
+				++bits;
+			Mask = (1ull << bits) - 1;
+		}
+
+		// Returns how many bytes belong to the current chunk, complete is set when the chunk ends with them
+		size_t Consume(const char* data, const size_t size, bool& complete)
+		{
+			complete = false;
+			for (size_t i = 0; i < size; ++i)
+			{
+				const auto byte = static_cast<unsigned char>(data[i]);
+				Hash = (Hash << 1) + GEAR_TABLE[byte];
+				++ChunkSize;
+
+				if (!Cut && ChunkSize >= MinSize && (Hash & Mask) == 0)
+					Cut = true;
+
+				if (byte == '\n' && (Cut || ChunkSize >= MaxSize))
+				{
+					complete = true;
+					Hash = 0;
+					ChunkSize = 0;
+					Cut = false;
+					return i + 1;
+				}
+			}
+			return size;
+		}
+
+	private:
+		size_t MinSize;
+		size_t MaxSize;
+		uint64_t Mask = 0;
+
+		uint64_t Hash = 0;
+		size_t ChunkSize = 0;
+		bool Cut = false;
+	};
+
+	std::string GetChunkName(const std::string& chunk)
+	{
+		// FNV-1a, the size in the name makes a collision need equal sizes as well
+		uint64_t hash = 0xCBF29CE484222325ull;
+		for (const char c : chunk)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 0x100000001B3ull;
+		}
+
+		char name[48];
+		std::snprintf(name, sizeof(name), "%016llx_%llu", static_cast<unsigned long long>(hash),
+		              static_cast<unsigned long long>(chunk.size()));
+		return name;
+	}
+
+	// Run size, line count and samples of a cached run, written once the run is complete so a run without an
+	// index is never reused
+	void SaveRunIndex(const std::string& path, const Run& run, const uint64_t lineCount)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		const uint64_t sampleCount = run.Samples.size();
+		file.write(RUN_INDEX_MAGIC, sizeof(RUN_INDEX_MAGIC));
+		file.write(reinterpret_cast<const char*>(&run.Size), sizeof(run.Size));
+		file.write(reinterpret_cast<const char*>(&lineCount), sizeof(lineCount));
+		file.write(reinterpret_cast<const char*>(&sampleCount), sizeof(sampleCount));
+		for (const Sample& sample : run.Samples)
+		{
+			const auto size = static_cast<uint32_t>(sample.Line.size());
+			file.write(reinterpret_cast<const char*>(&sample.Offset), sizeof(sample.Offset));
+			file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			file.write(sample.Line.data(), size);
+		}
+
+		if (!file)
+			throw Js::JsException("Failed to write run index");
+	}
+
+	bool LoadRunIndex(const std::string& path, Run& run, uint64_t& lineCount)
+	{
+		std::ifstream file(path, std::ios::binary);
+		char magic[sizeof(RUN_INDEX_MAGIC)] = {};
+		uint64_t sampleCount = 0;
+		file.read(magic, sizeof(magic));
+		file.read(reinterpret_cast<char*>(&run.Size), sizeof(run.Size));
+		file.read(reinterpret_cast<char*>(&lineCount), sizeof(lineCount));
+		file.read(reinterpret_cast<char*>(&sampleCount), sizeof(sampleCount));
+		if (!file || std::memcmp(magic, RUN_INDEX_MAGIC, sizeof(magic)) != 0)
+			return false;
+
+		run.Samples.clear();
+		for (uint64_t i = 0; i < sampleCount; ++i)
+		{
+			Sample sample;
+			uint32_t size = 0;
+			file.read(reinterpret_cast<char*>(&sample.Offset), sizeof(sample.Offset));
+			file.read(reinterpret_cast<char*>(&size), sizeof(size));
+			if (!file)
+				return false;
+
+			sample.Line.resize(size);
+			file.read(&sample.Line[0], size);
+			run.Samples.push_back(std::move(sample));
+		}
+		if (!file)
+			return false;
+
+		// The run itself may have been removed or cut short
+		std::ifstream runFile(run.Path, std::ios::binary | std::ios::ate);
+		return runFile && static_cast<uint64_t>(runFile.tellg()) == run.Size;
+	}
+
+	// Removes the cached runs of the previous input that the current one no longer has
+	void PruneRunCache(const std::string& directory, const std::set<std::string>& names)
+	{
+		const std::string manifestPath = directory + "/manifest.txt";
+		{
+			std::ifstream manifest(manifestPath);
+			for (std::string name; std::getline(manifest, name);)
+			{
+				if (name.empty() || names.count(name) != 0)
+					continue;
+
+				std::remove((directory + "/" + name + ".run").c_str());
+				std::remove((directory + "/" + name + ".idx").c_str());
+			}
+		}
+
+		std::ofstream manifest(manifestPath, std::ios::trunc);
+		for (const std::string& name : names)
+			manifest << name << '\n';
+	}
+
+	std::vector<Run> GenerateCachedRuns(Js::JobSystem& system, Js::File& input, const Js::ExternalSortOptions& options,
+	                                    Js::ExternalSortStats& stats)
+	{
+		const std::string& directory = options.RunCacheDirectory;
+		const size_t slotCount = std::max<size_t>(1, options.MemoryBudget / (8 * options.ChunkSize));
+		std::vector<ChunkSlot> slots(slotCount);
+		std::vector<size_t> slotRuns(slotCount);
+		size_t nextSlot = 0;
+
+		std::vector<Run> runs;
+		std::vector<uint64_t> runLines;
+		std::set<std::string> names;
+		// A chunk repeated in the input is sorted once and merged once per occurrence
+		std::unordered_map<std::string, size_t> firstRuns;
+		std::vector<std::pair<size_t, size_t>> duplicates;
+
+		const auto collect = [&](const size_t slotIndex)
+		{
+			ChunkSlot& slot = slots[slotIndex];
+			if (!slot.Busy)
+				return;
+
+			system.Wait(slot.Counter, 0);
+			Run& run = runs[slotRuns[slotIndex]];
+			run = std::move(slot.Data.Run);
+			run.Cached = true;
+
+			const std::string& path = run.Path;
+			SaveRunIndex(path.substr(0, path.size() - 4) + ".idx", run, slot.Data.LineCount);
+			runLines[slotRuns[slotIndex]] = slot.Data.LineCount;
+			slot.Busy = false;
+		};
+
+		const auto addChunk = [&](std::string& chunk)
+		{
+			const std::string name = GetChunkName(chunk);
+			const size_t index = runs.size();
+			runs.emplace_back();
+			runLines.push_back(0);
+
+			const auto first = firstRuns.find(name);
+			if (first != firstRuns.end())
+			{
+				duplicates.emplace_back(index, first->second);
+				return;
+			}
+			firstRuns.emplace(name, index);
+			names.insert(name);
+
+			Run& run = runs.back();
+			run.Path = directory + "/" + name + ".run";
+			run.Cached = true;
+
+			if (LoadRunIndex(directory + "/" + name + ".idx", run, runLines[index]))
+			{
+				++stats.ReusedRunCount;
+				return;
+			}
+
+			const size_t slotIndex = nextSlot++ % slotCount;
+			collect(slotIndex);
+			ChunkSlot& slot = slots[slotIndex];
+			slotRuns[slotIndex] = index;
+			stats.SortedBytes += chunk.size();
+
+			slot.Data.Buffer.swap(chunk);
+			slot.Data.Run = Run();
+			slot.Data.Run.Path = run.Path;
+			slot.Data.SampleInterval = options.SampleInterval;
+			slot.Data.WriteBufferSize = std::min(options.ChunkSize * 4, MAX_IO_SIZE);
+			slot.Data.LineCount = 0;
+
+			Js::Job job{SortChunk, &slot.Data};
+			system.AddJob(job, &slot.Counter);
+			slot.Busy = true;
+		};
+
+		Chunker chunker(options.ChunkSize);
+		std::string block(static_cast<size_t>(std::min<uint64_t>(CHUNK_READ_SIZE, input.GetSize())), '\0');
+		std::string chunk;
+		const uint64_t size = input.GetSize();
+		for (uint64_t offset = 0; offset < size;)
+		{
+			const auto want = static_cast<uint32_t>(std::min<uint64_t>(block.size(), size - offset));
+			const uint32_t read = input.Read(&block[0], want, offset);
+			if (read == 0)
+				throw Js::JsException("Unexpected end of external sort input");
+			offset += read;
+
+			for (size_t position = 0; position < read;)
+			{
+				bool complete = false;
+				const size_t taken = chunker.Consume(block.data() + position, read - position, complete);
+				chunk.append(block, position, taken);
+				position += taken;
+
+				if (complete)
+				{
+					addChunk(chunk);
+					chunk.clear();
+				}
+			}
+		}
+		if (!chunk.empty())
+			addChunk(chunk);
+
+		for (size_t i = 0; i < slotCount; ++i)
+			collect(i);
+
+		for (const auto& duplicate : duplicates)
+		{
+			runs[duplicate.first] = runs[duplicate.second];
+			runLines[duplicate.first] = runLines[duplicate.second];
+		}
+		for (const uint64_t lines : runLines)
+			stats.LineCount += lines;
+
+		PruneRunCache(directory, names);
+		return runs;
+	}
+
+	std::vector<Run> MergePass(Js::JobSystem& system, std::vector<Run>& runs, const size_t pass,
+	                           const Js::ExternalSortOptions& options)
+	{
+		const size_t groupCount = (runs.size() + options.MergeFanIn - 1) / options.MergeFanIn;
+		const size_t bufferSize = std::max(MIN_MERGE_BUFFER_SIZE,
+		                                   options.MemoryBudget / (groupCount * (options.MergeFanIn + 1)));
+
+		std::vector<Run> merged(groupCount);
+		std::vector<MergeData> merges(groupCount);
+		std::vector<std::vector<std::unique_ptr<Js::File>>> sources(groupCount);
+		std::vector<std::unique_ptr<Js::File>> outputs;
+		std::vector<Js::Job> jobs;
+
+		for (size_t group = 0; group < groupCount; ++group)
+		{
+			const size_t first = group * options.MergeFanIn;
+			const size_t count = std::min(options.MergeFanIn, runs.size() - first);
+
+			merged[group].Path = GetRunPath(options, pass, group);
+			sources[group] = OpenRuns(system, runs, first, count);
+			outputs.emplace_back(new Js::File());
+			outputs.back()->Open(system, merged[group].Path.c_str(), Js::FileAccess::Write);
+
+			MergeData& merge = merges[group];
+			for (size_t i = 0; i < count; ++i)
+			{
+				merge.Sources.push_back(sources[group][i].get());
+				merge.Ranges.emplace_back(0, runs[first + i].Size);
+			}
+			merge.Output = outputs.back().get();
+			merge.Samples = &merged[group].Samples;
+			merge.SampleInterval = options.SampleInterval;
+			merge.BufferSize = bufferSize;
+
+			jobs.emplace_back(MergeRanges, &merge);
+		}
+
+		Js::Counter counter;
+		system.AddJobs(jobs, &counter);
+		system.Wait(counter, 0);
+
+		for (size_t group = 0; group < groupCount; ++group)
+			merged[group].Size = merges[group].Written;
+
+		sources.clear();
+		outputs.clear();
+		RemoveRuns(runs);
+		return merged;
+	}
+
+	void MergeToOutput(Js::JobSystem& system, std::vector<Run>& runs, Js::File& output,
+	                   const Js::ExternalSortOptions& options)
+	{
+		if (runs.empty())
+			return;
+
+		const size_t partitionCount = options.MergePartitions != 0
+			                              ? options.MergePartitions
+			                              : std::max<size_t>(1, system.GetThreadCount() * 2);
+
+		std::vector<const std::string*> keys;
+		for (const Run& run : runs)
+			for (const Sample& sample : run.Samples)
+				keys.push_back(&sample.Line);
+		std::sort(keys.begin(), keys.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+
+		std::vector<std::string> splitters;
+		for (size_t i = 1; i < partitionCount && !keys.empty(); ++i)
+		{
+			const std::string& key = *keys[i * keys.size() / partitionCount];
+			if (splitters.empty() || splitters.back() < key)
+				splitters.push_back(key);
+		}
+
+		const std::vector<std::unique_ptr<Js::File>> files = OpenRuns(system, runs, 0, runs.size());
+		const size_t scanBufferSize = std::min(options.SampleInterval * 2, MAX_IO_SIZE);
+
+		std::vector<BoundaryData> boundaries(runs.size());
+		std::vector<Js::Job> jobs;
+		for (size_t i = 0; i < runs.size(); ++i)
+		{
+			boundaries[i].File = files[i].get();
+			boundaries[i].Run = &runs[i];
+			boundaries[i].Splitters = &splitters;
+			boundaries[i].BufferSize = scanBufferSize;
+			jobs.emplace_back(FindBoundaries, &boundaries[i]);
+		}
+
+		Js::Counter counter;
+		system.AddJobs(jobs, &counter);
+		system.Wait(counter, 0);
+
+		const size_t rangeCount = splitters.size() + 1;
+		const size_t bufferSize = std::max(MIN_MERGE_BUFFER_SIZE,
+		                                   options.MemoryBudget / (rangeCount * (runs.size() + 1)));
+
+		std::vector<MergeData> merges(rangeCount);
+		jobs.clear();
+		for (size_t range = 0; range < rangeCount; ++range)
+		{
+			MergeData& merge = merges[range];
+			for (size_t i = 0; i < runs.size(); ++i)
+			{
+				const uint64_t begin = boundaries[i].Offsets[range];
+				const uint64_t end = boundaries[i].Offsets[range + 1];
+				merge.Sources.push_back(files[i].get());
+				merge.Ranges.emplace_back(begin, end);
+			}
+			merge.Output = &output;
+			merge.BufferSize = bufferSize;
+			jobs.emplace_back(MergeRanges, &merge);
+		}
+
+		// Range sizes are exact, so every range writes at a precomputed output offset
+		uint64_t outputOffset = 0;
+		for (size_t range = 0; range < rangeCount; ++range)
+		{
+			merges[range].OutputOffset = outputOffset;
+			for (const auto& bounds : merges[range].Ranges)
+				outputOffset += bounds.second - bounds.first;
+		}
+
+		system.AddJobs(jobs, &counter);
+		system.Wait(counter, 0);
+	}
+}
+
+Js::ExternalSortStats Js::ExternalSort(JobSystem& system, const char* input, const char* output,
+                                       const ExternalSortOptions& options)
+{
+	if (options.RunSize == 0 || options.MemoryBudget < options.RunSize)
+		throw JsException("External sort memory budget must hold at least one run");
+	if (options.MergeFanIn < 2)
+		throw JsException("External sort merge fan-in must be at least 2");
+
+	const bool incremental = !options.RunCacheDirectory.empty();
+	if (incremental && options.ChunkSize < 64)
+		throw JsException("External sort chunk size is too small");
+
+	ExternalSortStats stats;
+
+	std::vector<Run> runs;
+	{
+		File inputFile;
+		inputFile.Open(system, input, FileAccess::Read);
+		stats.InputBytes = inputFile.GetSize();
+		if (incremental)
+		{
+			runs = GenerateCachedRuns(system, inputFile, options, stats);
+		}
+		else
+		{
+			runs = GenerateRuns(system, inputFile, options, stats);
+			stats.SortedBytes = stats.InputBytes;
+		}
+	}
+	stats.RunCount = runs.size();
+	Log::Info("ExternalSort: Generated %zu runs, %zu reused from the cache\n", runs.size(), stats.ReusedRunCount);
+
+	size_t pass = 1;
+	for (; runs.size() > options.MergeFanIn; ++pass)
+		runs = MergePass(system, runs, pass, options);
+
+	{
+		File outputFile;
+		outputFile.Open(system, output, FileAccess::Write);
+		MergeToOutput(system, runs, outputFile, options);
+	}
+	RemoveRuns(runs);
+
+	stats.MergePasses = pass;
+	return stats;
+}
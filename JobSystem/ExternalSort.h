@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace Js
+{
+	class JobSystem;
+
+	struct ExternalSortOptions
+	{
+		// Upper bound for chunk buffers while generating runs and for read buffers while merging
+		size_t MemoryBudget = 1ull << 30;
+		size_t RunSize = 64ull << 20;
+
+		size_t MergeFanIn = 64;
+		// Number of key ranges merged in parallel in the final pass, 0 uses twice the thread count
+		size_t MergePartitions = 0;
+		size_t SampleInterval = 256ull << 10;
+
+		std::string TempDirectory = ".";
+
+		// Incremental mode when set. The input is cut into content defined chunks and the sorted run of every chunk
+		// is kept in this directory under the chunk's hash, so sorting a slightly changed input again only sorts
+		// the chunks that changed and merges them with the cached runs. Runs of chunks no longer in the input are
+		// removed. The directory must exist
+		std::string RunCacheDirectory;
+		// Average chunk size in incremental mode, chunks end at a line break between a quarter and four times it
+		size_t ChunkSize = 1ull << 20;
+	};
+
+	struct ExternalSortStats
+	{
+		uint64_t InputBytes = 0;
+		uint64_t LineCount = 0;
+		size_t RunCount = 0;
+		size_t MergePasses = 0;
+		// Input sorted into new runs, less than InputBytes when cached runs were reused
+		uint64_t SortedBytes = 0;
+		size_t ReusedRunCount = 0;
+	};
+
+	ExternalSortStats ExternalSort(JobSystem& system, const char* input, const char* output,
+	                               const ExternalSortOptions& options = ExternalSortOptions());
+}
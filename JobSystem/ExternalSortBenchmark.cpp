@@ -0,0 +1,157 @@
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "ExternalSort.h"
+#include "File.h"
+#include "JobSystem.h"
+#include "WindowsMinimal.h"
+
+namespace
+{
+	constexpr size_t GENERATE_BUFFER_SIZE = 16u << 20;
+
+	uint64_t ParseMegabytes(const int argc, char** argv, const int index, const uint64_t fallback)
+	{
+		if (argc <= index)
+			return fallback << 20;
+
+		return std::strtoull(argv[index], nullptr, 10) << 20;
+	}
+
+	// Lines starting in [changedBegin, changedEnd) are capitalized, the rest of the input stays the same
+	void GenerateInput(Js::JobSystem& jobSystem, const char* path, const uint64_t bytes, const uint64_t changedBegin = 0,
+	                   const uint64_t changedEnd = 0)
+	{
+		std::mt19937_64 random(42);
+		std::uniform_int_distribution<int> length(4, 32);
+		std::uniform_int_distribution<int> letter('a', 'z');
+
+		Js::File file;
+		file.Open(jobSystem, path, Js::FileAccess::Write);
+
+		std::string buffer;
+		buffer.reserve(GENERATE_BUFFER_SIZE + 64);
+
+		uint64_t offset = 0;
+		while (offset < bytes)
+		{
+			buffer.clear();
+			while (buffer.size() < GENERATE_BUFFER_SIZE && offset + buffer.size() < bytes)
+			{
+				const uint64_t lineOffset = offset + buffer.size();
+				const size_t lineBegin = buffer.size();
+				for (int i = length(random); i > 0; --i)
+					buffer.push_back(static_cast<char>(letter(random)));
+				if (lineOffset >= changedBegin && lineOffset < changedEnd)
+					buffer[lineBegin] = static_cast<char>(buffer[lineBegin] - 'a' + 'A');
+				buffer.push_back('\n');
+			}
+
+			offset += file.Write(buffer.data(), static_cast<uint32_t>(buffer.size()), offset);
+		}
+	}
+
+	double SortSeconds(Js::JobSystem& jobSystem, const std::string& input, const std::string& output,
+	                   const Js::ExternalSortOptions& options, Js::ExternalSortStats& stats)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		stats = Js::ExternalSort(jobSystem, input.c_str(), output.c_str(), options);
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return elapsed.count();
+	}
+
+	void RemoveRunCache(const std::string& directory)
+	{
+		const std::string manifestPath = directory + "/manifest.txt";
+		{
+			std::ifstream manifest(manifestPath);
+			for (std::string name; std::getline(manifest, name);)
+			{
+				std::remove((directory + "/" + name + ".run").c_str());
+				std::remove((directory + "/" + name + ".idx").c_str());
+			}
+		}
+		std::remove(manifestPath.c_str());
+		RemoveDirectoryA(directory.c_str());
+	}
+
+	// Sorts the input into an empty run cache, changes a small range of it and sorts it again, the second sort
+	// should only cost the changed chunks plus the merge
+	int RunIncremental(Js::JobSystem& jobSystem, const int argc, char** argv)
+	{
+		const uint64_t inputSize = ParseMegabytes(argc, argv, 3, 1024);
+		const uint64_t changedSize = (argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 64) << 10;
+
+		Js::ExternalSortOptions options;
+		if (argc > 5)
+			options.TempDirectory = argv[5];
+		options.RunCacheDirectory = options.TempDirectory + "/extsort_cache";
+		CreateDirectoryA(options.RunCacheDirectory.c_str(), nullptr);
+
+		const std::string input = options.TempDirectory + "/extsort_input.txt";
+		const std::string output = options.TempDirectory + "/extsort_output.txt";
+
+		std::cout << "Generating " << (inputSize >> 20) << " MB of input" << std::endl;
+		GenerateInput(jobSystem, input.c_str(), inputSize);
+
+		Js::ExternalSortStats stats;
+		const double fullSeconds = SortSeconds(jobSystem, input, output, options, stats);
+		std::cout << "Full sort: " << fullSeconds << " s, " << stats.RunCount << " runs, sorted "
+			<< (stats.SortedBytes >> 20) << " MB" << std::endl;
+
+		GenerateInput(jobSystem, input.c_str(), inputSize, inputSize / 2, inputSize / 2 + changedSize);
+		const double incrementalSeconds = SortSeconds(jobSystem, input, output, options, stats);
+		std::cout << "Incremental sort after changing " << (changedSize >> 10) << " KB: " << incrementalSeconds
+			<< " s, " << stats.ReusedRunCount << " of " << stats.RunCount << " runs reused, sorted "
+			<< (stats.SortedBytes >> 10) << " KB" << std::endl;
+
+		std::remove(input.c_str());
+		std::remove(output.c_str());
+		RemoveRunCache(options.RunCacheDirectory);
+		return 0;
+	}
+}
+
+// Usage: extsort-bench [input MB] [memory budget MB] [run size MB] [temp directory]
+//        extsort-bench incremental [input MB] [changed KB] [temp directory]
+int RunExternalSortBenchmark(Js::JobSystem& jobSystem, const int argc, char** argv)
+{
+	if (argc > 2 && std::strcmp(argv[2], "incremental") == 0)
+		return RunIncremental(jobSystem, argc, argv);
+
+	const uint64_t inputSize = ParseMegabytes(argc, argv, 2, 4096);
+
+	Js::ExternalSortOptions options;
+	options.MemoryBudget = ParseMegabytes(argc, argv, 3, 1024);
+	options.RunSize = ParseMegabytes(argc, argv, 4, 64);
+	if (argc > 5)
+		options.TempDirectory = argv[5];
+
+	const std::string input = options.TempDirectory + "/extsort_input.txt";
+	const std::string output = options.TempDirectory + "/extsort_output.txt";
+
+	std::cout << "Generating " << (inputSize >> 20) << " MB of input" << std::endl;
+	GenerateInput(jobSystem, input.c_str(), inputSize);
+
+	const auto start = std::chrono::steady_clock::now();
+	const Js::ExternalSortStats stats = Js::ExternalSort(jobSystem, input.c_str(), output.c_str(), options);
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	const double megabytes = static_cast<double>(stats.InputBytes) / (1 << 20);
+	std::cout << "Sorted " << stats.LineCount << " lines (" << megabytes << " MB) in " << elapsed.count() << " s"
+		<< std::endl;
+	std::cout << "Runs: " << stats.RunCount << ", merge passes: " << stats.MergePasses << std::endl;
+	std::cout << "Throughput: " << megabytes / elapsed.count() << " MB/s" << std::endl;
+
+	std::remove(input.c_str());
+	std::remove(output.c_str());
+	return 0;
+}
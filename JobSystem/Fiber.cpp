@@ -16,10 +16,17 @@ namespace
 	}
 }
 
-Js::Fiber::Fiber()
+void Js::Fiber::Create(const size_t stackSize)
 {
-	Handle = CreateFiber(524288, reinterpret_cast<LPFIBER_START_ROUTINE>(LaunchFiber), this);
+	if (Handle && !ThreadFiber)
+		DeleteFiber(Handle);
+
+	Handle = CreateFiber(stackSize, reinterpret_cast<LPFIBER_START_ROUTINE>(LaunchFiber), this);
+	if (Handle == nullptr)
+		throw JsException("Failed to create fiber");
+
 	ThreadFiber = false;
+	StackSize = stackSize;
 }
 
 Js::Fiber::~Fiber()
@@ -33,7 +40,10 @@ void Js::Fiber::FromCurrentThread()
 	if (Handle && !ThreadFiber)
 		DeleteFiber(Handle);
 
-	Handle = ConvertThreadToFiber(nullptr);
+	// A thread converted by an earlier JobSystem is still a fiber and cannot be converted again
+	Handle = IsThreadAFiber() ? GetCurrentFiber() : ConvertThreadToFiber(nullptr);
+	if (Handle == nullptr)
+		throw JsException("Failed to convert thread to fiber");
 	ThreadFiber = true;
 }
 
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 
 namespace Js
 {
@@ -7,10 +8,13 @@ namespace Js
 	public:
 		using FiberFunc = void(*)(Fiber*);
 
-		Fiber();
+		static constexpr size_t DEFAULT_STACK_SIZE = 524288;
+
+		Fiber() = default;
 		Fiber(const Fiber&) = delete;
 		~Fiber();
 
+		void Create(size_t stackSize = DEFAULT_STACK_SIZE);
 		void FromCurrentThread();
 
 		void SetFunc(FiberFunc func);
@@ -22,12 +26,14 @@ namespace Js
 		FiberFunc GetFunc() const { return Func; }
 		void* GetData() const { return Data; }
 		bool IsValid() const { return Handle && Func; }
+		size_t GetStackSize() const { return StackSize; }
 
 	private:
 		friend class JobSystem;
 
 		void* Handle = nullptr;
 		bool ThreadFiber = false;
+		size_t StackSize = 0;
 
 		Fiber* ReturnFiber = nullptr;
 
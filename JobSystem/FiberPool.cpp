@@ -1,11 +1,13 @@
 #include "FiberPool.h"
 
-Js::FiberPool::FiberPool(const uint16_t size, const Fiber::FiberFunc function, void* data):
+Js::FiberPool::FiberPool(const uint16_t size, const size_t stackSize, const Fiber::FiberFunc function, void* data):
 	Fibers(size),
-	FreeFibers(size)
+	FreeFibers(size),
+	StackSize(stackSize)
 {
 	for (uint16_t i = 0; i < size; i++)
 	{
+		Fibers[i].Create(stackSize);
 		Fibers[i].SetFunc(function);
 		Fibers[i].SetData(data);
 		FreeFibers[i].store(true, std::memory_order_relaxed);
@@ -28,10 +30,16 @@ uint16_t Js::FiberPool::GetFreeFiber(Fiber*& fiber)
 			if (std::atomic_compare_exchange_weak_explicit(&FreeFibers[i], &expected, false, std::memory_order_release,
 			                                               std::memory_order_relaxed))
 			{
+				const uint16_t inUse = InUse.fetch_add(1, std::memory_order_relaxed) + 1;
+				uint16_t peak = PeakInUse.load(std::memory_order_relaxed);
+				while (peak < inUse && !PeakInUse.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {}
+
 				fiber = &Fibers[i];
 				return i;
 			}
 		}
+
+		ExhaustedCount.fetch_add(1, std::memory_order_relaxed);
 	}
 }
 
@@ -42,5 +50,6 @@ Js::Fiber& Js::FiberPool::GetFiber(const uint16_t index)
 
 void Js::FiberPool::ReturnFiber(const uint16_t index)
 {
+	InUse.fetch_sub(1, std::memory_order_relaxed);
 	FreeFibers[index].store(true, std::memory_order_release);
 }
@@ -9,15 +9,25 @@ namespace Js
 	class FiberPool
 	{
 	public:
-		explicit FiberPool(uint16_t size, Fiber::FiberFunc function, void* data = nullptr);
+		FiberPool(uint16_t size, size_t stackSize, Fiber::FiberFunc function, void* data = nullptr);
 		~FiberPool() = default;
 
 		uint16_t GetFreeFiber(Fiber*& fiber);
 		Fiber& GetFiber(uint16_t index);
 		void ReturnFiber(uint16_t index);
 
+		size_t GetStackSize() const { return StackSize; }
+		uint16_t GetPeakInUse() const { return PeakInUse.load(std::memory_order_relaxed); }
+		// Full scans of the pool that found no free fiber
+		uint64_t GetExhaustedCount() const { return ExhaustedCount.load(std::memory_order_relaxed); }
+
 	private:
 		std::vector<Fiber> Fibers;
 		std::vector<std::atomic_bool> FreeFibers;
+		size_t StackSize;
+
+		std::atomic<uint16_t> InUse{0};
+		std::atomic<uint16_t> PeakInUse{0};
+		std::atomic<uint64_t> ExhaustedCount{0};
 	};
 }
@@ -0,0 +1,70 @@
+#include "File.h"
+
+#include "WindowsMinimal.h"
+
+#include "IoSystem.h"
+#include "JobSystem.h"
+#include "JSException.h"
+
+Js::File::~File()
+{
+	Close();
+}
+
+void Js::File::Open(JobSystem& system, const char* path, const FileAccess access)
+{
+	Close();
+
+	Io = &system.GetIoSystem();
+
+	DWORD flags = FILE_ATTRIBUTE_NORMAL;
+	if (Io->GetBackend() == IoBackend::CompletionPort)
+		flags |= FILE_FLAG_OVERLAPPED;
+
+	const bool read = access == FileAccess::Read;
+	const HANDLE handle = CreateFileA(path, read ? GENERIC_READ : GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+	                                  read ? OPEN_EXISTING : CREATE_ALWAYS, flags, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		throw JsException(std::string("Failed to open file ") + path);
+
+	Handle = handle;
+	if (!Io->Associate(Handle))
+	{
+		Close();
+		throw JsException(std::string("Failed to associate file with I/O system ") + path);
+	}
+}
+
+void Js::File::Close()
+{
+	if (Handle == nullptr)
+		return;
+
+	CloseHandle(Handle);
+	Handle = nullptr;
+}
+
+uint32_t Js::File::Read(void* buffer, const uint32_t size, const uint64_t offset)
+{
+	if (Handle == nullptr)
+		throw JsException("File is not open");
+
+	return Io->Read(Handle, buffer, size, offset);
+}
+
+uint32_t Js::File::Write(const void* buffer, const uint32_t size, const uint64_t offset)
+{
+	if (Handle == nullptr)
+		throw JsException("File is not open");
+
+	return Io->Write(Handle, buffer, size, offset);
+}
+
+uint64_t Js::File::GetSize() const
+{
+	LARGE_INTEGER size;
+	if (Handle == nullptr || !GetFileSizeEx(Handle, &size))
+		throw JsException("Failed to get file size");
+
+	return static_cast<uint64_t>(size.QuadPart);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+
+namespace Js
+{
+	class IoSystem;
+	class JobSystem;
+
+	enum class FileAccess
+	{
+		Read,
+		Write
+	};
+
+	class File
+	{
+	public:
+		File() = default;
+		File(const File&) = delete;
+		~File();
+
+		void Open(JobSystem& system, const char* path, FileAccess access);
+		void Close();
+
+		uint32_t Read(void* buffer, uint32_t size, uint64_t offset);
+		uint32_t Write(const void* buffer, uint32_t size, uint64_t offset);
+
+		uint64_t GetSize() const;
+		bool IsOpen() const { return Handle != nullptr; }
+
+	private:
+		void* Handle = nullptr;
+		IoSystem* Io = nullptr;
+	};
+}
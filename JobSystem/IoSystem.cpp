@@ -0,0 +1,228 @@
+#include "IoSystem.h"
+
+#include "WindowsMinimal.h"
+
+#include "Counter.h"
+#include "JobSystem.h"
+#include "JSException.h"
+#include "Log.h"
+
+namespace
+{
+	constexpr ULONG_PTR SHUTDOWN_KEY = 1;
+	constexpr ULONG MAX_COMPLETIONS = 64;
+}
+
+struct Js::IoSystem::Request
+{
+	OVERLAPPED Overlapped{};
+	Js::Counter Counter;
+
+	void* File = nullptr;
+	void* Buffer = nullptr;
+	uint32_t Size = 0;
+	bool IsWrite = false;
+
+	uint32_t Transferred = 0;
+	uint32_t Error = ERROR_SUCCESS;
+
+	void SetOffset(const uint64_t offset)
+	{
+		Overlapped.Offset = static_cast<DWORD>(offset);
+		Overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	}
+};
+
+Js::IoSystem::IoSystem(JobSystem* system, const IoBackend backend, const size_t threadCount):
+	System(system),
+	Backend(backend),
+	ThreadCount(backend == IoBackend::ThreadPool ? threadCount : 0),
+	Threads(backend == IoBackend::ThreadPool ? threadCount : 0) {}
+
+Js::IoSystem::~IoSystem()
+{
+	Shutdown();
+}
+
+void Js::IoSystem::Initialize()
+{
+	if (CompletionPort != nullptr)
+		return;
+
+	CompletionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+	if (CompletionPort == nullptr)
+		throw JsException("Failed to create I/O completion port");
+
+	if (Backend != IoBackend::ThreadPool)
+		return;
+
+	WorkPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+	if (WorkPort == nullptr)
+		throw JsException("Failed to create I/O work port");
+
+	for (size_t i = 0; i < ThreadCount; ++i)
+	{
+		if (!Threads[i].Create(PoolWorker, this))
+			throw JsException("Failed to start I/O thread");
+	}
+	Log::Info("IoSystem::Initialize: Started %zu I/O threads\n", ThreadCount);
+}
+
+void Js::IoSystem::Shutdown()
+{
+	if (CompletionPort == nullptr)
+		return;
+
+	if (WorkPort != nullptr)
+	{
+		for (size_t i = 0; i < ThreadCount; ++i)
+			PostQueuedCompletionStatus(WorkPort, 0, SHUTDOWN_KEY, nullptr);
+
+		for (size_t i = 0; i < ThreadCount; ++i)
+			Threads[i].Join();
+
+		CloseHandle(WorkPort);
+		WorkPort = nullptr;
+	}
+
+	CloseHandle(CompletionPort);
+	CompletionPort = nullptr;
+}
+
+bool Js::IoSystem::Associate(void* file)
+{
+	if (Backend != IoBackend::CompletionPort)
+		return true;
+
+	return CreateIoCompletionPort(file, CompletionPort, 0, 0) != nullptr;
+}
+
+uint32_t Js::IoSystem::Read(void* file, void* buffer, const uint32_t size, const uint64_t offset)
+{
+	Request request;
+	request.File = file;
+	request.Buffer = buffer;
+	request.Size = size;
+	request.IsWrite = false;
+	request.SetOffset(offset);
+
+	return Submit(request);
+}
+
+uint32_t Js::IoSystem::Write(void* file, const void* buffer, const uint32_t size, const uint64_t offset)
+{
+	Request request;
+	request.File = file;
+	request.Buffer = const_cast<void*>(buffer);
+	request.Size = size;
+	request.IsWrite = true;
+	request.SetOffset(offset);
+
+	return Submit(request);
+}
+
+uint32_t Js::IoSystem::Submit(Request& request)
+{
+	if (CompletionPort == nullptr)
+		throw JsException("I/O system is not initialized");
+
+	request.Counter.Initialize(System, 1);
+	PendingRequests.fetch_add(1, std::memory_order_acq_rel);
+
+	if (Backend == IoBackend::ThreadPool)
+	{
+		if (!PostQueuedCompletionStatus(WorkPort, 0, 0, &request.Overlapped))
+		{
+			PendingRequests.fetch_sub(1, std::memory_order_acq_rel);
+			throw JsException("Failed to queue I/O request");
+		}
+	}
+	else
+	{
+		const BOOL result = request.IsWrite
+			                    ? WriteFile(request.File, request.Buffer, request.Size, nullptr, &request.Overlapped)
+			                    : ReadFile(request.File, request.Buffer, request.Size, nullptr, &request.Overlapped);
+		if (!result)
+		{
+			const DWORD error = GetLastError();
+			if (error != ERROR_IO_PENDING)
+			{
+				PendingRequests.fetch_sub(1, std::memory_order_acq_rel);
+				if (error == ERROR_HANDLE_EOF)
+					return 0;
+
+				throw JsException("Failed to submit I/O request");
+			}
+		}
+	}
+
+	System->Wait(request.Counter, 0);
+
+	if (request.Error == ERROR_HANDLE_EOF)
+		return 0;
+	if (request.Error != ERROR_SUCCESS)
+		throw JsException("I/O request failed");
+
+	return request.Transferred;
+}
+
+bool Js::IoSystem::PollCompletions()
+{
+	if (!HasPendingRequests())
+		return false;
+
+	OVERLAPPED_ENTRY entries[MAX_COMPLETIONS];
+	ULONG count = 0;
+	if (!GetQueuedCompletionStatusEx(CompletionPort, entries, MAX_COMPLETIONS, &count, 0, FALSE))
+		return false;
+
+	for (ULONG i = 0; i < count; ++i)
+	{
+		Request* request = CONTAINING_RECORD(entries[i].lpOverlapped, Request, Overlapped);
+		request->Transferred = entries[i].dwNumberOfBytesTransferred;
+
+		// Thread pool requests carry their status already, overlapped ones are queried from the kernel
+		if (Backend == IoBackend::CompletionPort)
+		{
+			DWORD transferred = 0;
+			if (!GetOverlappedResult(request->File, &request->Overlapped, &transferred, FALSE))
+				request->Error = GetLastError();
+		}
+
+		PendingRequests.fetch_sub(1, std::memory_order_acq_rel);
+		request->Counter.Decrement();
+	}
+
+	return count != 0;
+}
+
+void Js::IoSystem::PoolWorker(Thread* thread)
+{
+	const auto io = static_cast<IoSystem*>(thread->GetData());
+
+	for (;;)
+	{
+		DWORD transferred = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED* overlapped = nullptr;
+		if (!GetQueuedCompletionStatus(io->WorkPort, &transferred, &key, &overlapped, INFINITE))
+			continue;
+
+		if (key == SHUTDOWN_KEY)
+			break;
+
+		Request* request = CONTAINING_RECORD(overlapped, Request, Overlapped);
+
+		OVERLAPPED position{};
+		position.Offset = request->Overlapped.Offset;
+		position.OffsetHigh = request->Overlapped.OffsetHigh;
+
+		DWORD done = 0;
+		const BOOL result = request->IsWrite
+			                    ? WriteFile(request->File, request->Buffer, request->Size, &done, &position)
+			                    : ReadFile(request->File, request->Buffer, request->Size, &done, &position);
+		request->Error = result ? ERROR_SUCCESS : GetLastError();
+
+		PostQueuedCompletionStatus(io->CompletionPort, done, 0, &request->Overlapped);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Thread.h"
+
+namespace Js
+{
+	class JobSystem;
+
+	enum class IoBackend
+	{
+		CompletionPort,
+		ThreadPool
+	};
+
+	class IoSystem
+	{
+	public:
+		IoSystem(JobSystem* system, IoBackend backend, size_t threadCount);
+		IoSystem(const IoSystem&) = delete;
+		~IoSystem();
+
+		void Initialize();
+		void Shutdown();
+
+		bool Associate(void* file);
+
+		uint32_t Read(void* file, void* buffer, uint32_t size, uint64_t offset);
+		uint32_t Write(void* file, const void* buffer, uint32_t size, uint64_t offset);
+
+		bool PollCompletions();
+
+		IoBackend GetBackend() const { return Backend; }
+		bool HasPendingRequests() const { return PendingRequests.load(std::memory_order_acquire) != 0; }
+
+	private:
+		struct Request;
+
+		JobSystem* System;
+		IoBackend Backend;
+
+		void* CompletionPort = nullptr;
+		void* WorkPort = nullptr;
+
+		size_t ThreadCount;
+		std::vector<Thread> Threads;
+
+		std::atomic<size_t> PendingRequests{0};
+
+		uint32_t Submit(Request& request);
+
+		static void PoolWorker(Thread* thread);
+	};
+}
@@ -2,8 +2,8 @@
 
 #include <utility>
 
-Js::Job::Job(std::function<void(JobSystem&, void*)> function, void* data) :
-Function(std::move(function)), Data(data){}
+Js::Job::Job(std::function<void(JobSystem&, void*)> function, void* data, const JobAffinity affinity) :
+Function(std::move(function)), Data(data), Affinity(affinity){}
 
 void Js::Job::Initialize(JobSystem* system, Js::Counter* counter)
 {
@@ -15,6 +15,11 @@ void Js::Job::Execute() const
 {
 	Function(*System, Data);
 
-	if (Counter)
+	if (Counter == nullptr)
+		return;
+
+	if (Counter->IsSharded())
+		System->DeferDecrement(*Counter);
+	else
 		Counter->Decrement();
 }
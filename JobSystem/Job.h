@@ -9,14 +9,39 @@ namespace Js
 	enum class JobPriority;
 	class JobSystem;
 
+	enum class AffinityType : uint8_t
+	{
+		Any,
+		Worker,
+		LocalityKey
+	};
+
+	struct JobAffinity
+	{
+		AffinityType Type = AffinityType::Any;
+		size_t Worker = 0;
+		uint64_t Key = 0;
+
+		static JobAffinity Any() { return JobAffinity(); }
+		// Runs only on the given worker, suspended waits resume there as well
+		static JobAffinity OnWorker(size_t worker) { return JobAffinity{AffinityType::Worker, worker, 0}; }
+		// The main thread is worker 0 and only runs jobs while it is inside Wait
+		static JobAffinity OnMainThread() { return OnWorker(0); }
+		// Prefers the worker that last ran a job with the same key, idle workers may still take it
+		static JobAffinity PreferKey(uint64_t key) { return JobAffinity{AffinityType::LocalityKey, 0, key}; }
+	};
+
 	class Job final
 	{
 	public:
 		Job() = default;
-		Job(std::function<void(JobSystem&, void*)> function, void* data = nullptr);
+		Job(std::function<void(JobSystem&, void*)> function, void* data = nullptr, JobAffinity affinity = JobAffinity());
 
 		std::function<void(JobSystem&, void*)> Function;
 		void* Data = nullptr;
+		JobAffinity Affinity;
+		// Static name grouping jobs of one kind in diagnostics, must outlive the JobSystem
+		const char* Tag = nullptr;
 
 	private:
 		friend class JobSystem;
@@ -24,6 +49,10 @@ namespace Js
 		JobSystem* System = nullptr;
 		Counter* Counter = nullptr;
 
+		// Filled in by the JobSystem when diagnostics are enabled
+		size_t TagIndex = 0;
+		uint64_t EnqueueTime = 0;
+
 		void Initialize(JobSystem* system, Js::Counter* counter);
 
 		void Execute() const;
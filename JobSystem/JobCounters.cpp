@@ -0,0 +1,115 @@
+#include "JobCounters.h"
+
+#include <algorithm>
+
+#include <intrin.h>
+
+#include "JobSystem.h"
+#include "Log.h"
+#include "WindowsMinimal.h"
+
+Js::JobCounters::JobCounters(const Options& options, const TagRegistry& tags, const size_t threadCount) :
+	Tags(tags),
+	Enabled(options.JobCounters),
+	ThreadCycles(false),
+	Fibers(options.JobCounters ? options.FiberCount : 0)
+{
+	if (!Enabled)
+		return;
+
+	ULONG64 cycles = 0;
+	ThreadCycles = QueryThreadCycleTime(GetCurrentThread(), &cycles) != FALSE;
+	if (!ThreadCycles)
+		Log::Warning("JobCounters::JobCounters: Thread cycle time is unavailable, counting timestamp counter cycles\n");
+
+	for (size_t i = 0; i < threadCount; ++i)
+		Shards.emplace_back(new Shard());
+}
+
+uint64_t Js::JobCounters::GetCycles() const
+{
+	if (!ThreadCycles)
+		return __rdtsc();
+
+	ULONG64 cycles = 0;
+	QueryThreadCycleTime(GetCurrentThread(), &cycles);
+	return cycles;
+}
+
+Js::JobCounters::Sample Js::JobCounters::Read(const uint16_t fiberIndex) const
+{
+	// The segment start may come from another thread when the fiber was last switched away between jobs, the
+	// difference of two samples taken without a suspend in between does not depend on it
+	const FiberCounters& fiber = Fibers[fiberIndex];
+	Sample sample;
+	sample.Cycles = fiber.Cycles + (GetCycles() - fiber.SegmentStart);
+	sample.Suspensions = fiber.Suspensions;
+	sample.Migrations = fiber.Migrations;
+	return sample;
+}
+
+void Js::JobCounters::BeginSuspend(const uint16_t fiberIndex, const size_t worker)
+{
+	FiberCounters& fiber = Fibers[fiberIndex];
+	fiber.Cycles += GetCycles() - fiber.SegmentStart;
+	fiber.SuspendedOn = worker;
+}
+
+void Js::JobCounters::EndSuspend(const uint16_t fiberIndex, const size_t worker)
+{
+	FiberCounters& fiber = Fibers[fiberIndex];
+	fiber.SegmentStart = GetCycles();
+	++fiber.Suspensions;
+	if (fiber.SuspendedOn != worker)
+		++fiber.Migrations;
+}
+
+void Js::JobCounters::Record(const size_t worker, const size_t tagIndex, const Sample& begin, const Sample& end)
+{
+	TagCounters& counters = Shards[worker]->Tags[tagIndex];
+	const uint64_t cycles = end.Cycles - begin.Cycles;
+
+	// Only the owning worker writes its shard
+	counters.JobCount.store(counters.JobCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	counters.Cycles.store(counters.Cycles.load(std::memory_order_relaxed) + cycles, std::memory_order_relaxed);
+	if (cycles > counters.MaxCycles.load(std::memory_order_relaxed))
+		counters.MaxCycles.store(cycles, std::memory_order_relaxed);
+	counters.Suspensions.store(counters.Suspensions.load(std::memory_order_relaxed) + end.Suspensions - begin.Suspensions,
+	                           std::memory_order_relaxed);
+	counters.Migrations.store(counters.Migrations.load(std::memory_order_relaxed) + end.Migrations - begin.Migrations,
+	                          std::memory_order_relaxed);
+}
+
+std::vector<Js::JobCounterStats> Js::JobCounters::GetTagStats() const
+{
+	std::vector<JobCounterStats> stats;
+	for (size_t tag = 0; tag < TagRegistry::MAX_TAGS; ++tag)
+	{
+		JobCounterStats tagStats;
+		tagStats.Tag = Tags.GetTag(tag);
+
+		for (const auto& shard : Shards)
+		{
+			const TagCounters& counters = shard->Tags[tag];
+			tagStats.JobCount += counters.JobCount.load(std::memory_order_relaxed);
+			tagStats.Cycles += counters.Cycles.load(std::memory_order_relaxed);
+			tagStats.MaxCycles = std::max(tagStats.MaxCycles, counters.MaxCycles.load(std::memory_order_relaxed));
+			tagStats.Suspensions += counters.Suspensions.load(std::memory_order_relaxed);
+			tagStats.Migrations += counters.Migrations.load(std::memory_order_relaxed);
+		}
+
+		if (tagStats.JobCount != 0)
+			stats.push_back(tagStats);
+	}
+	return stats;
+}
+
+void Js::JobCounters::LogSummary() const
+{
+	for (const JobCounterStats& stats : GetTagStats())
+	{
+		Log::Info("JobCounters::LogSummary: %s jobs %llu, cycles %llu per job max %llu, suspensions %llu, "
+		          "migrations %llu\n", stats.Tag, stats.JobCount, stats.Cycles / stats.JobCount, stats.MaxCycles,
+		          stats.Suspensions, stats.Migrations);
+	}
+}
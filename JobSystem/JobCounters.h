@@ -0,0 +1,90 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "TagRegistry.h"
+
+namespace Js
+{
+	struct Options;
+
+	struct JobCounterStats
+	{
+		const char* Tag = nullptr;
+		uint64_t JobCount = 0;
+		// CPU cycles the job's fiber ran for, including jobs it ran inline while waiting
+		uint64_t Cycles = 0;
+		uint64_t MaxCycles = 0;
+		// Times the job suspended its fiber, and how many of those resumed it on another worker
+		uint64_t Suspensions = 0;
+		uint64_t Migrations = 0;
+	};
+
+	// Per tag CPU counters read around every job. Cycles come from the cycle count the kernel keeps per thread,
+	// so time the worker was preempted is left out, and from the timestamp counter where that is unavailable.
+	// Counted per fiber since a job stays on its fiber across waits, summed in per worker shards
+	class JobCounters
+	{
+	public:
+		struct Sample
+		{
+			uint64_t Cycles = 0;
+			uint64_t Suspensions = 0;
+			uint64_t Migrations = 0;
+		};
+
+		JobCounters(const Options& options, const TagRegistry& tags, size_t threadCount);
+		JobCounters(const JobCounters&) = delete;
+		~JobCounters() = default;
+
+		bool IsEnabled() const { return Enabled; }
+		bool HasThreadCycles() const { return ThreadCycles; }
+
+		// Running totals of the fiber, a job's counters are the difference of the samples taken around it
+		Sample Read(uint16_t fiberIndex) const;
+		void BeginSuspend(uint16_t fiberIndex, size_t worker);
+		void EndSuspend(uint16_t fiberIndex, size_t worker);
+
+		void Record(size_t worker, size_t tagIndex, const Sample& begin, const Sample& end);
+
+		std::vector<JobCounterStats> GetTagStats() const;
+		void LogSummary() const;
+
+	private:
+		struct TagCounters
+		{
+			std::atomic<uint64_t> JobCount{0};
+			std::atomic<uint64_t> Cycles{0};
+			std::atomic<uint64_t> MaxCycles{0};
+			std::atomic<uint64_t> Suspensions{0};
+			std::atomic<uint64_t> Migrations{0};
+		};
+
+		struct Shard
+		{
+			std::array<TagCounters, TagRegistry::MAX_TAGS> Tags;
+		};
+
+		struct FiberCounters
+		{
+			// Cycles up to the last suspend and the cycle count of the thread when the fiber last started running
+			uint64_t Cycles = 0;
+			uint64_t SegmentStart = 0;
+			uint64_t Suspensions = 0;
+			uint64_t Migrations = 0;
+			size_t SuspendedOn = 0;
+		};
+
+		const TagRegistry& Tags;
+		bool Enabled;
+		bool ThreadCycles;
+
+		std::vector<std::unique_ptr<Shard>> Shards;
+		std::vector<FiberCounters> Fibers;
+
+		uint64_t GetCycles() const;
+	};
+}
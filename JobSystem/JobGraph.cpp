@@ -0,0 +1,151 @@
+#include "JobGraph.h"
+
+#include "JobSystem.h"
+#include "JSException.h"
+
+Js::JobGraph::JobGraph(JobSystem& system, const JobPriority priority) :
+	System(&system),
+	Priority(priority)
+{
+	if (System->GetQueue(priority) == nullptr)
+		throw JsException("Invalid job priority");
+}
+
+Js::JobGraph::NodeId Js::JobGraph::AddNode(const Job& job)
+{
+	if (Sealed)
+		throw JsException("Job graph is sealed");
+
+	const auto node = static_cast<NodeId>(Jobs.size());
+	Functions.push_back(job.Function);
+	Jobs.push_back(job);
+
+	// Small enough for the function's inline storage, so copying the job into a queue does not allocate
+	Jobs.back().Function = [this, node](JobSystem& jobSystem, void* data) { RunNode(node, jobSystem, data); };
+	return node;
+}
+
+void Js::JobGraph::AddDependency(const NodeId before, const NodeId after)
+{
+	if (Sealed)
+		throw JsException("Job graph is sealed");
+	if (before >= Jobs.size() || after >= Jobs.size())
+		throw JsException("Invalid job graph node");
+
+	Edges.emplace_back(before, after);
+}
+
+void Js::JobGraph::Seal()
+{
+	if (Sealed)
+		return;
+
+	const size_t nodeCount = Jobs.size();
+	SuccessorOffsets.assign(nodeCount + 1, 0);
+	DependencyCounts.assign(nodeCount, 0);
+	for (const auto& edge : Edges)
+	{
+		++SuccessorOffsets[edge.first + 1];
+		++DependencyCounts[edge.second];
+	}
+	for (size_t i = 0; i < nodeCount; ++i)
+		SuccessorOffsets[i + 1] += SuccessorOffsets[i];
+
+	Successors.resize(Edges.size());
+	std::vector<uint32_t> fill(SuccessorOffsets.begin(), SuccessorOffsets.end() - 1);
+	for (const auto& edge : Edges)
+		Successors[fill[edge.first]++] = edge.second;
+
+	// Kahn's algorithm, every node has to become ready once
+	std::vector<uint32_t> remaining(DependencyCounts);
+	std::vector<NodeId> ready;
+	for (NodeId node = 0; node < nodeCount; ++node)
+	{
+		if (remaining[node] == 0)
+			ready.push_back(node);
+	}
+	Roots = ready;
+
+	size_t visited = 0;
+	while (!ready.empty())
+	{
+		const NodeId node = ready.back();
+		ready.pop_back();
+		++visited;
+
+		for (uint32_t i = SuccessorOffsets[node]; i < SuccessorOffsets[node + 1]; ++i)
+		{
+			if (--remaining[Successors[i]] == 0)
+				ready.push_back(Successors[i]);
+		}
+	}
+
+	if (visited != nodeCount)
+		throw JsException("Job graph has a cycle");
+
+	Remaining.reset(new std::atomic<uint32_t>[nodeCount]);
+	for (size_t i = 0; i < nodeCount; ++i)
+		Remaining[i].store(DependencyCounts[i], std::memory_order_relaxed);
+
+	for (Job& job : Jobs)
+		System->PrepareJob(job, &Done);
+
+	Edges.clear();
+	Edges.shrink_to_fit();
+	Sealed = true;
+}
+
+void Js::JobGraph::SetData(const NodeId node, void* data)
+{
+	if (node >= Jobs.size())
+		throw JsException("Invalid job graph node");
+
+	Jobs[node].Data = data;
+}
+
+void Js::JobGraph::Launch()
+{
+	if (!Sealed)
+		throw JsException("Job graph is not sealed");
+	if (Launched)
+		throw JsException("Job graph is already running");
+	if (Jobs.empty())
+		return;
+
+	Launched = true;
+	Done.Initialize(System, static_cast<uint32_t>(Jobs.size()));
+	for (const NodeId root : Roots)
+		System->QueuePreparedJob(Jobs[root], Priority);
+}
+
+void Js::JobGraph::Wait()
+{
+	if (!Launched)
+		return;
+
+	System->Wait(Done, 0);
+	Launched = false;
+}
+
+void Js::JobGraph::Run()
+{
+	Launch();
+	Wait();
+}
+
+void Js::JobGraph::RunNode(const NodeId node, JobSystem& system, void* data)
+{
+	Functions[node](system, data);
+
+	// Released before this node counts as done, so Done cannot reach zero while a dependent is still unqueued
+	for (uint32_t i = SuccessorOffsets[node]; i < SuccessorOffsets[node + 1]; ++i)
+	{
+		const NodeId successor = Successors[i];
+		if (Remaining[successor].fetch_sub(1, std::memory_order_acq_rel) != 1)
+			continue;
+
+		// Nothing else touches the count until the next replay, which starts after Done reached zero
+		Remaining[successor].store(DependencyCounts[successor], std::memory_order_relaxed);
+		system.QueuePreparedJob(Jobs[successor], Priority);
+	}
+}
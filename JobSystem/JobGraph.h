@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Counter.h"
+#include "Job.h"
+
+namespace Js
+{
+	class JobSystem;
+	enum class JobPriority;
+
+	// A graph of jobs and their dependencies recorded once and replayed any number of times. Seal prepares every
+	// job and lays the dependencies out in flat arrays, so a replay only queues the roots, each finished job queues
+	// the dependents it released, and nothing is allocated or rebuilt per replay
+	class JobGraph
+	{
+	public:
+		using NodeId = uint32_t;
+
+		explicit JobGraph(JobSystem& system, JobPriority priority = JobPriority::Normal);
+		JobGraph(const JobGraph&) = delete;
+		~JobGraph() = default;
+
+		// Recording, before Seal. The job keeps its tag and affinity, its data can be replaced before each replay
+		NodeId AddNode(const Job& job);
+		// After runs only once before has finished
+		void AddDependency(NodeId before, NodeId after);
+		// Throws on a cycle
+		void Seal();
+
+		size_t GetNodeCount() const { return Jobs.size(); }
+		bool IsSealed() const { return Sealed; }
+
+		// Input of a node for the following replays
+		void SetData(NodeId node, void* data);
+
+		// Starts a replay, one at a time per graph
+		void Launch();
+		void Wait();
+		void Run();
+
+	private:
+		JobSystem* System;
+		JobPriority Priority;
+		bool Sealed = false;
+		bool Launched = false;
+
+		std::vector<Job> Jobs;
+		std::vector<std::function<void(JobSystem&, void*)>> Functions;
+		std::vector<std::pair<NodeId, NodeId>> Edges;
+
+		// Dependents of node i are Successors[SuccessorOffsets[i]] up to SuccessorOffsets[i + 1]
+		std::vector<uint32_t> SuccessorOffsets;
+		std::vector<NodeId> Successors;
+		std::vector<uint32_t> DependencyCounts;
+		// Dependencies not finished yet in the current replay, rearmed as soon as the node is released
+		std::unique_ptr<std::atomic<uint32_t>[]> Remaining;
+		std::vector<NodeId> Roots;
+
+		// Every node decrements it once per replay and it is only waited on for zero
+		Counter Done{CounterMode::Sharded};
+
+		void RunNode(NodeId node, JobSystem& system, void* data);
+	};
+}
@@ -0,0 +1,168 @@
+#include "JobPool.h"
+
+#include <cassert>
+#include <new>
+#include <utility>
+
+#include "Job.h"
+#include "JSException.h"
+
+struct Js::JobPool::Slot
+{
+	Job Payload;
+	std::atomic<uint32_t> Generation{0};
+	// Next free slot while this one is on a free list
+	std::atomic<uint32_t> Next{EMPTY};
+};
+
+Js::JobPool::JobPool(const size_t workerCount, const size_t workerSlots, const size_t sharedSlots,
+                     MemoryResource* resource) :
+	Resource(resource),
+	Slots(nullptr),
+	SlotCount(workerCount * workerSlots + sharedSlots),
+	WorkerCount(workerCount),
+	WorkerSlots(workerSlots),
+	Segments(workerCount, ResourceAllocator<Segment>(resource))
+{
+	if (SlotCount >= EMPTY)
+		throw JsException("Job pool is too large");
+
+	Slots = static_cast<Slot*>(Resource->Allocate(sizeof(Slot) * SlotCount, alignof(Slot)));
+	for (size_t i = 0; i != SlotCount; ++i)
+		new(&Slots[i]) Slot();
+
+	// Every segment starts as one list of its slots in order
+	for (size_t worker = 0; worker < WorkerCount; ++worker)
+	{
+		const size_t first = worker * WorkerSlots;
+		for (size_t i = first; i + 1 < first + WorkerSlots; ++i)
+			Slots[i].Next.store(static_cast<uint32_t>(i + 1), std::memory_order_relaxed);
+		if (WorkerSlots != 0)
+			Segments[worker].LocalFree = static_cast<uint32_t>(first);
+	}
+
+	const size_t firstShared = WorkerCount * WorkerSlots;
+	for (size_t i = firstShared; i + 1 < SlotCount; ++i)
+		Slots[i].Next.store(static_cast<uint32_t>(i + 1), std::memory_order_relaxed);
+	if (sharedSlots != 0)
+		SharedFree.store(firstShared, std::memory_order_relaxed);
+}
+
+Js::JobPool::~JobPool()
+{
+	for (size_t i = 0; i != SlotCount; ++i)
+		Slots[i].~Slot();
+	Resource->Deallocate(Slots, sizeof(Slot) * SlotCount, alignof(Slot));
+}
+
+bool Js::JobPool::TryAllocate(const Job& job, const size_t worker, JobHandle& handle)
+{
+	uint32_t index = EMPTY;
+	if (worker < WorkerCount)
+	{
+		index = PopWorker(worker);
+		if (index == EMPTY)
+			SharedFallbacks.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (index == EMPTY)
+		index = PopShared();
+	if (index == EMPTY)
+		return false;
+
+	Slot& slot = Slots[index];
+	slot.Payload = job;
+	handle = static_cast<JobHandle>(slot.Generation.load(std::memory_order_relaxed)) << 32 | index;
+	return true;
+}
+
+Js::JobPool::Slot& Js::JobPool::GetSlot(const JobHandle handle) const
+{
+	const auto index = static_cast<uint32_t>(handle);
+	assert(index < SlotCount);
+	Slot& slot = Slots[index];
+	assert(slot.Generation.load(std::memory_order_relaxed) == static_cast<uint32_t>(handle >> 32));
+	return slot;
+}
+
+const Js::Job& Js::JobPool::Get(const JobHandle handle) const
+{
+	return GetSlot(handle).Payload;
+}
+
+void Js::JobPool::Take(const JobHandle handle, Job& job, const size_t worker)
+{
+	job = std::move(GetSlot(handle).Payload);
+	Release(handle, worker);
+}
+
+void Js::JobPool::Release(const JobHandle handle, const size_t worker)
+{
+	Slot& slot = GetSlot(handle);
+	const auto index = static_cast<uint32_t>(handle);
+	slot.Generation.store(static_cast<uint32_t>(handle >> 32) + 1, std::memory_order_relaxed);
+
+	const size_t owner = WorkerSlots != 0 ? index / WorkerSlots : WorkerCount;
+	if (owner >= WorkerCount)
+	{
+		PushShared(index);
+		return;
+	}
+
+	Segment& segment = Segments[owner];
+	if (owner == worker)
+	{
+		slot.Next.store(segment.LocalFree, std::memory_order_relaxed);
+		segment.LocalFree = index;
+		return;
+	}
+
+	uint32_t head = segment.RemoteFree.load(std::memory_order_relaxed);
+	do
+		slot.Next.store(head, std::memory_order_relaxed);
+	while (!segment.RemoteFree.compare_exchange_weak(head, index, std::memory_order_release, std::memory_order_relaxed));
+}
+
+uint32_t Js::JobPool::PopWorker(const size_t worker)
+{
+	// Slots only ever leave the remote list all at once, so the owner never sees a reused head
+	Segment& segment = Segments[worker];
+	if (segment.LocalFree == EMPTY && segment.RemoteFree.load(std::memory_order_relaxed) != EMPTY)
+		segment.LocalFree = segment.RemoteFree.exchange(EMPTY, std::memory_order_acquire);
+
+	const uint32_t index = segment.LocalFree;
+	if (index != EMPTY)
+		segment.LocalFree = Slots[index].Next.load(std::memory_order_relaxed);
+	return index;
+}
+
+uint32_t Js::JobPool::PopShared()
+{
+	uint64_t head = SharedFree.load(std::memory_order_acquire);
+	for (;;)
+	{
+		const auto index = static_cast<uint32_t>(head);
+		if (index == EMPTY)
+			return EMPTY;
+
+		const uint64_t next = ((head >> 32) + 1) << 32 | Slots[index].Next.load(std::memory_order_relaxed);
+		if (SharedFree.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+			return index;
+	}
+}
+
+void Js::JobPool::PushShared(const uint32_t index)
+{
+	uint64_t head = SharedFree.load(std::memory_order_relaxed);
+	uint64_t next;
+	do
+	{
+		Slots[index].Next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+		next = ((head >> 32) + 1) << 32 | index;
+	}
+	while (!SharedFree.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+size_t Js::JobPool::GetMemorySize() const
+{
+	return sizeof(Slot) * SlotCount + sizeof(Segment) * Segments.size();
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MemoryResource.h"
+
+namespace Js
+{
+	class Job;
+
+	// Slot index in the low half and the slot's generation in the high half, so a handle used after its job was
+	// taken is caught
+	using JobHandle = uint64_t;
+
+	// Payloads of queued jobs, the queues only carry handles. Each worker allocates from its own segment and
+	// other threads hand its slots back through a list the owner takes over whole. Threads that are not workers,
+	// and workers whose segment ran dry, share one more segment as large as all job queues together
+	class JobPool
+	{
+	public:
+		JobPool(size_t workerCount, size_t workerSlots, size_t sharedSlots, MemoryResource* resource);
+		JobPool(const JobPool&) = delete;
+		~JobPool();
+
+		// Copies the job into a free slot, worker is SIZE_MAX on threads that are not workers
+		bool TryAllocate(const Job& job, size_t worker, JobHandle& handle);
+		const Job& Get(JobHandle handle) const;
+		// Moves the payload out and frees the slot
+		void Take(JobHandle handle, Job& job, size_t worker);
+		void Release(JobHandle handle, size_t worker);
+
+		size_t GetMemorySize() const;
+		// Allocations of workers that found their own segment empty
+		uint64_t GetSharedFallbackCount() const { return SharedFallbacks.load(std::memory_order_relaxed); }
+
+	private:
+		static constexpr uint32_t EMPTY = UINT32_MAX;
+		static constexpr size_t CACHELINE_SIZE = 64;
+
+		struct Slot;
+
+		struct Segment
+		{
+			// Touched only by the owning worker
+			alignas(CACHELINE_SIZE) uint32_t LocalFree = EMPTY;
+			// Slots freed on other threads, pushed one at a time and taken over whole by the owner
+			alignas(CACHELINE_SIZE) std::atomic<uint32_t> RemoteFree{EMPTY};
+		};
+
+		MemoryResource* Resource;
+		Slot* Slots;
+		size_t SlotCount;
+		size_t WorkerCount;
+		size_t WorkerSlots;
+
+		std::vector<Segment, ResourceAllocator<Segment>> Segments;
+		// Head index in the low half and a tag bumped on every change in the high half, so a pop that read a
+		// stale next index fails its exchange
+		alignas(CACHELINE_SIZE) std::atomic<uint64_t> SharedFree{EMPTY};
+		std::atomic<uint64_t> SharedFallbacks{0};
+
+		uint32_t PopWorker(size_t worker);
+		uint32_t PopShared();
+		void PushShared(uint32_t index);
+		Slot& GetSlot(JobHandle handle) const;
+	};
+}
@@ -0,0 +1,96 @@
+#include "JobProfiler.h"
+
+#include <chrono>
+
+#include "JobSystem.h"
+#include "Log.h"
+
+Js::JobProfiler::JobProfiler(const Options& options, const TagRegistry& tags, const size_t threadCount) :
+	Tags(tags),
+	Enabled(options.JobProfiling),
+	FiberSuspendStart(options.JobProfiling ? options.FiberCount : 0),
+	FiberSuspended(options.JobProfiling ? options.FiberCount : 0)
+{
+	if (!Enabled)
+		return;
+
+	for (size_t i = 0; i < threadCount; ++i)
+		Shards.emplace_back(new Shard());
+}
+
+Js::JobProfiler::~JobProfiler()
+{
+	for (auto& shard : Shards)
+	{
+		for (auto& histograms : shard->Tags)
+			delete histograms.load(std::memory_order_relaxed);
+	}
+}
+
+uint64_t Js::JobProfiler::Now()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Js::JobProfiler::BeginSuspend(const uint16_t fiberIndex)
+{
+	FiberSuspendStart[fiberIndex] = Now();
+}
+
+void Js::JobProfiler::EndSuspend(const uint16_t fiberIndex)
+{
+	FiberSuspended[fiberIndex] += Now() - FiberSuspendStart[fiberIndex];
+}
+
+void Js::JobProfiler::Record(const size_t worker, const size_t tagIndex, const uint64_t wait,
+                             const uint64_t execution, const uint64_t suspended)
+{
+	std::atomic<TagHistograms*>& slot = Shards[worker]->Tags[tagIndex];
+	TagHistograms* histograms = slot.load(std::memory_order_acquire);
+	if (histograms == nullptr)
+	{
+		histograms = new TagHistograms();
+		slot.store(histograms, std::memory_order_release);
+	}
+
+	histograms->Wait.Record(wait);
+	histograms->Execution.Record(execution);
+	histograms->Suspended.Record(suspended);
+}
+
+std::vector<Js::JobTagStats> Js::JobProfiler::GetTagStats() const
+{
+	std::vector<JobTagStats> stats;
+	for (size_t tag = 0; tag < TagRegistry::MAX_TAGS; ++tag)
+	{
+		JobTagStats tagStats;
+		tagStats.Tag = Tags.GetTag(tag);
+
+		for (const auto& shard : Shards)
+		{
+			const TagHistograms* histograms = shard->Tags[tag].load(std::memory_order_acquire);
+			if (histograms == nullptr)
+				continue;
+
+			tagStats.Wait.Merge(histograms->Wait);
+			tagStats.Execution.Merge(histograms->Execution);
+			tagStats.Suspended.Merge(histograms->Suspended);
+		}
+
+		if (tagStats.Execution.GetCount() != 0)
+			stats.push_back(tagStats);
+	}
+	return stats;
+}
+
+void Js::JobProfiler::LogSummary() const
+{
+	for (const JobTagStats& stats : GetTagStats())
+	{
+		Log::Info("JobProfiler::LogSummary: %s jobs %llu, wait p50 %llu ns p99 %llu ns, execution p50 %llu ns p99 %llu ns, "
+		          "suspended p99 %llu ns\n", stats.Tag, stats.Execution.GetCount(), stats.Wait.GetPercentile(0.5),
+		          stats.Wait.GetPercentile(0.99), stats.Execution.GetPercentile(0.5), stats.Execution.GetPercentile(0.99),
+		          stats.Suspended.GetPercentile(0.99));
+	}
+}
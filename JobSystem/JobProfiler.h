@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "LatencyHistogram.h"
+#include "TagRegistry.h"
+
+namespace Js
+{
+	struct Options;
+
+	struct JobTagStats
+	{
+		const char* Tag = nullptr;
+		// Enqueue to dequeue
+		LatencyHistogram Wait;
+		// Running on a fiber, excluding the time the fiber was suspended
+		LatencyHistogram Execution;
+		LatencyHistogram Suspended;
+	};
+
+	// Per tag job latency histograms in nanoseconds, kept in per worker shards that only the owning worker writes
+	// and merged when stats are requested
+	class JobProfiler
+	{
+	public:
+		JobProfiler(const Options& options, const TagRegistry& tags, size_t threadCount);
+		JobProfiler(const JobProfiler&) = delete;
+		~JobProfiler();
+
+		static uint64_t Now();
+
+		bool IsEnabled() const { return Enabled; }
+
+		// Suspended time is tracked per fiber since a job stays on its fiber across waits
+		void BeginSuspend(uint16_t fiberIndex);
+		void EndSuspend(uint16_t fiberIndex);
+		uint64_t GetSuspendedTime(const uint16_t fiberIndex) const { return FiberSuspended[fiberIndex]; }
+
+		void Record(size_t worker, size_t tagIndex, uint64_t wait, uint64_t execution, uint64_t suspended);
+
+		std::vector<JobTagStats> GetTagStats() const;
+		void LogSummary() const;
+
+	private:
+		struct TagHistograms
+		{
+			LatencyHistogram Wait;
+			LatencyHistogram Execution;
+			LatencyHistogram Suspended;
+		};
+
+		// Histograms are allocated on first use since most workers only ever see a few tags
+		struct Shard
+		{
+			std::array<std::atomic<TagHistograms*>, TagRegistry::MAX_TAGS> Tags{};
+		};
+
+		const TagRegistry& Tags;
+		bool Enabled;
+
+		std::vector<std::unique_ptr<Shard>> Shards;
+		std::vector<uint64_t> FiberSuspendStart;
+		std::vector<uint64_t> FiberSuspended;
+	};
+}
@@ -1,18 +1,105 @@
 #include "JobSystem.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "WindowsMinimal.h"
 
 #include "Job.h"
 #include "Counter.h"
 #include "Log.h"
 
+namespace
+{
+	// Per job tracing, compiled out without instrumentation
+	template <typename... Args>
+	void Trace(const char* format, Args&&... args)
+	{
+		if (Js::JobSystem::INSTRUMENTED)
+			Log::Info(format, std::forward<Args>(args)...);
+	}
+}
+
 Js::JobSystem::JobSystem(const Options& options):
-	ThreadCount(options.ThreadCount),
-	Threads(options.ThreadCount),
-	FiberPool(options.FiberCount, FiberWorker, this),
-	HighPriorityQueue(options.HighPriorityQueueSize),
-	NormalPriorityQueue(options.NormalPriorityQueueSize),
-	LowPriorityQueue(options.LowPriorityQueueSize) {}
+	Memory(options.MemoryResource != nullptr ? options.MemoryResource : GetDefaultMemoryResource()),
+	FiberCount(options.FiberCount),
+	LocalQueueSize(options.WorkerQueueSize),
+	ThreadCount(WorkerScaler::GetMaxThreadCount(options)),
+	Threads(WorkerScaler::GetMaxThreadCount(options)),
+	Scaler(this, options),
+	FiberPool(options.FiberCount, StackMonitor::GetStackSize(options), FiberWorker, this),
+	Stacks(options, Tags),
+	Profiler(options, Tags, ThreadCount),
+	CpuCounters(options, Tags, ThreadCount),
+	Io(this, options.IoBackend, options.IoThreadCount),
+	Timers(this),
+	JobPool(ThreadCount, options.WorkerJobPoolSize, GetSharedJobPoolSize(options, ThreadCount), Memory),
+	SharedReadyFibers(GetSharedReadyFibersSize(options.FiberCount), Memory),
+	FiberPins(options.FiberCount, ResourceAllocator<std::atomic<size_t>>(Memory)),
+	LocalityOwners(options.LocalityTableSize, ResourceAllocator<std::atomic<size_t>>(Memory)),
+	FiberStored(options.FiberCount, ResourceAllocator<std::atomic_bool>(Memory)),
+	FiberReserved(options.FiberCount, ResourceAllocator<std::atomic_bool>(Memory)),
+	InlineDepth(options.FiberCount, ResourceAllocator<uint32_t>(Memory))
+{
+	const size_t queueSizes[] = {options.HighPriorityQueueSize, options.NormalPriorityQueueSize, options.LowPriorityQueueSize};
+	std::array<size_t, PRIORITY_COUNT> prioritySizes{};
+	for (size_t priority = 0; priority < 3; ++priority)
+	{
+		size_t& size = prioritySizes[std::min(priority, PRIORITY_COUNT - 1)];
+		size = std::max(size, queueSizes[priority]);
+	}
+	for (size_t i = 0; i < PRIORITY_COUNT; ++i)
+		PriorityQueues[i].reset(new JobQueue(prioritySizes[i], Memory));
+
+	if (options.ReservedWorkers != 0)
+	{
+		// The main thread is worker 0 and at least one more worker has to take everything else
+		if (PRIORITY_COUNT == 1 || options.ElasticWorkers)
+			Log::Warning("JobSystem::JobSystem: Reserved workers need separate priority queues and fixed workers\n");
+		else if (options.ReservedWorkers + 2 > ThreadCount)
+			Log::Warning("JobSystem::JobSystem: %zu workers are too few to reserve %zu\n", ThreadCount,
+			             options.ReservedWorkers);
+		else
+			ReservedWorkers = options.ReservedWorkers;
+	}
+
+	if (!INSTRUMENTED && (options.StackPainting || options.JobProfiling || options.JobCounters))
+		Log::Warning("JobSystem::JobSystem: Instrumentation is compiled out, stack painting, job profiling and job "
+		             "counters are off\n");
+
+	for (size_t i = 0; i < ThreadCount; ++i)
+	{
+		PinnedQueues.emplace_back(new PinnedJobQueue(options.WorkerQueueSize, Memory));
+		PreferredQueues.emplace_back(new JobQueue(options.WorkerQueueSize, Memory));
+		LocalQueues.emplace_back(new LocalJobQueue(options.WorkerQueueSize, Memory));
+		PinnedReadyFibers.emplace_back(new PinnedReadyFiberQueue(GetSharedReadyFibersSize(options.FiberCount), Memory));
+
+		// A worker never holds more ready fibers than exist, so the list never grows after this
+		Tls& tls = Threads[i].GetTls();
+		tls.ReadyFibers = ReadyFiberList(ResourceAllocator<ReadyFiber>(Memory));
+		tls.ReadyFibers.reserve(options.FiberCount);
+	}
+
+	for (auto& pin : FiberPins)
+		pin.store(SIZE_MAX, std::memory_order_relaxed);
+	for (auto& owner : LocalityOwners)
+		owner.store(SIZE_MAX, std::memory_order_relaxed);
+}
+
+size_t Js::JobSystem::GetSharedReadyFibersSize(const uint16_t fiberCount)
+{
+	size_t size = 2;
+	while (size < fiberCount)
+		size <<= 1;
+	return size;
+}
+
+size_t Js::JobSystem::GetSharedJobPoolSize(const Options& options, const size_t threadCount)
+{
+	// Every queued job has a slot even when all of them came from threads without a segment of their own
+	return options.HighPriorityQueueSize + options.NormalPriorityQueueSize + options.LowPriorityQueueSize +
+		threadCount * options.WorkerQueueSize * 3;
+}
 
 Js::JobSystem::~JobSystem()
 {
@@ -31,12 +118,15 @@ void Js::JobSystem::Initialize()
 	Threads[0].FromCurrentThread();
 	Threads[0].GetTls().ThreadFiber.FromCurrentThread();
 	Threads[0].GetTls().ThreadIndex = 0;
-	Threads[0].SetAffinity(0);
+	SetWorkerAffinity(Threads[0], 0);
+
+	Io.Initialize();
 
 	Fiber* fiber = nullptr;
 	Threads[0].GetTls().CurrentFiberIndex = FiberPool.GetFreeFiber(fiber);
 	fiber->SetFunc(FiberMain);
-
+	// The main thread's stack can only be switched back to on the main thread
+	FiberPins[Threads[0].GetTls().CurrentFiberIndex].store(0, std::memory_order_relaxed);
 
 	for (size_t i = 1; i < ThreadCount; ++i)
 	{
@@ -53,6 +143,8 @@ void Js::JobSystem::Initialize()
 		_mm_pause();
 
 	Initialized.store(true, std::memory_order_release);
+	Scaler.Initialize();
+	ReportMemoryUsage();
 	Log::Info("JobSystem::Initialize: Initialized\n");
 }
 
@@ -63,31 +155,118 @@ void Js::JobSystem::Shutdown(const bool blocking)
 		return;
 
 	Quit.store(true, std::memory_order_release);
+	NotifyReservedWorkers();
 	Log::Info("JobSystem::Shutdown: Waiting for threads to finish\n");
 
 	if (blocking)
 	{
+		Scaler.Shutdown();
+
 		for (size_t i = 1; i < ThreadCount; ++i)
 			Threads[i].Join();
+
+		Io.Shutdown();
+
+		if (Stacks.IsEnabled())
+			Stacks.SaveRecommendation();
+		if (Profiler.IsEnabled())
+			Profiler.LogSummary();
+		if (CpuCounters.IsEnabled())
+			CpuCounters.LogSummary();
 	}
 }
 
+Js::MemoryUsage Js::JobSystem::GetMemoryUsage()
+{
+	MemoryUsage usage;
+	usage.QueueBytes = SharedReadyFibers.GetMemorySize();
+	for (const auto& queue : PriorityQueues)
+		usage.QueueBytes += queue->GetMemorySize();
+	for (size_t i = 0; i < ThreadCount; ++i)
+	{
+		usage.QueueBytes += PinnedQueues[i]->GetMemorySize() + PreferredQueues[i]->GetMemorySize() +
+			LocalQueues[i]->GetMemorySize() + PinnedReadyFibers[i]->GetMemorySize();
+		usage.ReadyFiberListBytes += Threads[i].GetTls().ReadyFibers.capacity() * sizeof(ReadyFiber);
+	}
+
+	usage.JobPoolBytes = JobPool.GetMemorySize();
+	usage.FiberStateBytes = FiberPins.size() * sizeof(FiberPins[0]) + FiberStored.size() * sizeof(FiberStored[0]) +
+		FiberReserved.size() * sizeof(FiberReserved[0]) + InlineDepth.size() * sizeof(InlineDepth[0]) + LocalityOwners.size() * sizeof(LocalityOwners[0]);
+	usage.FiberStackBytes = static_cast<size_t>(FiberCount) * FiberPool.GetStackSize();
+	usage.ResourceAllocatedBytes = Memory->GetAllocatedBytes();
+	usage.ResourceReservedBytes = Memory->GetReservedBytes();
+	return usage;
+}
+
+void Js::JobSystem::ReportMemoryUsage()
+{
+	const MemoryUsage usage = GetMemoryUsage();
+	Log::Info("JobSystem::ReportMemoryUsage: Queues %zu KiB, job pool %zu KiB, ready fiber lists %zu KiB, fiber state "
+	          "%zu KiB\n", usage.QueueBytes >> 10, usage.JobPoolBytes >> 10, usage.ReadyFiberListBytes >> 10,
+	          usage.FiberStateBytes >> 10);
+	Log::Info("JobSystem::ReportMemoryUsage: Fiber stacks %zu KiB reserved by the OS\n", usage.FiberStackBytes >> 10);
+	Log::Info("JobSystem::ReportMemoryUsage: Resource %s allocated %zu KiB, reserved %zu KiB\n", Memory->GetName(),
+	          usage.ResourceAllocatedBytes >> 10, usage.ResourceReservedBytes >> 10);
+}
+
+Js::SchedulerPressure Js::JobSystem::GetSchedulerPressure() const
+{
+	SchedulerPressure pressure;
+	pressure.FiberCount = FiberCount;
+	pressure.PeakFibersInUse = FiberPool.GetPeakInUse();
+	pressure.FiberPoolExhausted = FiberPool.GetExhaustedCount();
+	pressure.QueueFullRetries = QueueFullRetries.load(std::memory_order_relaxed);
+	pressure.LocalQueueOverflows = LocalQueueOverflows.load(std::memory_order_relaxed);
+	pressure.JobPoolFallbacks = JobPool.GetSharedFallbackCount();
+	return pressure;
+}
+
+template <typename TQueue>
+bool Js::JobSystem::EnqueueJob(TQueue* queue, const JobHandle handle, const bool waitIfFull)
+{
+	while (!queue->Enqueue(handle))
+	{
+		if (!waitIfFull)
+			return false;
+
+		if (INSTRUMENTED)
+			QueueFullRetries.fetch_add(1, std::memory_order_relaxed);
+
+		// Workers must not block on a full queue, external threads can wait for space
+		if (IsWorkerThread())
+			throw JsException("Queue is full");
+
+		SwitchToThread();
+	}
+	return true;
+}
+
+template <typename TQueue>
+bool Js::JobSystem::DequeueJob(TQueue* queue, Job& job, const Tls& tls)
+{
+	JobHandle handle;
+	if (!queue->Dequeue(handle))
+		return false;
+
+	JobPool.Take(handle, job, tls.ThreadIndex);
+	return true;
+}
+
 void Js::JobSystem::AddJob(Job& job, Counter* counter, const JobPriority priority)
 {
-	Log::Info("JobSystem::AddJob: Adding job\n");
+	Trace("JobSystem::AddJob: Adding job\n");
 	JobQueue* queue = GetQueue(priority);
 	if (queue == nullptr)
 		return;
-	Log::Info("JobSystem::AddJob: Queue is not null\n");
+	Trace("JobSystem::AddJob: Queue is not null\n");
 
-	job.Initialize(this, counter);
+	PrepareJob(job, counter);
 	if (counter != nullptr)
 		counter->Initialize(this, 1);
 
-	if (!queue->Enqueue(job))
-		throw JsException("Queue is full");
+	RouteJob(job, queue);
 
-	Log::Info("JobSystem::AddJob: Job added\n");
+	Trace("JobSystem::AddJob: Job added\n");
 }
 
 void Js::JobSystem::AddJobs(std::vector<Job>& jobs, Counter* counter, const JobPriority priority)
@@ -101,41 +280,264 @@ void Js::JobSystem::AddJobs(std::vector<Job>& jobs, Counter* counter, const JobP
 
 	for (Job& job : jobs)
 	{
-		job.Initialize(this, counter);
+		PrepareJob(job, counter);
+		RouteJob(job, queue);
+	}
+}
 
-		if (!queue->Enqueue(job))
-			throw JsException("Queue is full");
+Js::TimerId Js::JobSystem::AddJobAfter(Job& job, const uint32_t delayMs, Counter* counter, const JobPriority priority)
+{
+	if (GetQueue(priority) == nullptr)
+		return 0;
+
+	if (counter != nullptr)
+		counter->Initialize(this, 1);
+
+	return Timers.AddJob(job, delayMs, 0, counter, priority);
+}
+
+Js::TimerId Js::JobSystem::AddPeriodicJob(Job& job, const uint32_t periodMs, const JobPriority priority)
+{
+	if (periodMs == 0)
+		throw JsException("Periodic job needs a period");
+	if (GetQueue(priority) == nullptr)
+		return 0;
+
+	return Timers.AddJob(job, periodMs, periodMs, nullptr, priority);
+}
+
+bool Js::JobSystem::CancelTimer(const TimerId timer)
+{
+	return Timers.Cancel(timer);
+}
+
+bool Js::JobSystem::QueueTimerJob(Job& job, Counter* counter, const JobPriority priority)
+{
+	PrepareJob(job, counter);
+	return RouteJob(job, GetQueue(priority), false);
+}
+
+void Js::JobSystem::QueuePreparedJob(Job& job, const JobPriority priority)
+{
+	if (INSTRUMENTED && Profiler.IsEnabled())
+		job.EnqueueTime = JobProfiler::Now();
+
+	RouteJob(job, GetQueue(priority));
+}
+
+void Js::SleepFor(JobSystem& system, const uint32_t milliseconds)
+{
+	if (!system.IsWorkerThread())
+	{
+		Sleep(milliseconds);
+		return;
 	}
+
+	Tls& tls = system.GetCurrentTls();
+	std::atomic_bool* fiberStored = system.ResetFiberStored(tls.CurrentFiberIndex);
+	system.Timers.AddFiber(milliseconds, tls.CurrentFiberIndex, fiberStored);
+	system.SuspendCurrentFiber(fiberStored);
+}
+
+void Js::JobSystem::PrepareJob(Job& job, Counter* counter)
+{
+	job.Initialize(this, counter);
+
+	if (!INSTRUMENTED)
+		return;
+
+	if (Stacks.IsEnabled() || Profiler.IsEnabled() || CpuCounters.IsEnabled())
+		job.TagIndex = Tags.GetIndex(job.Tag);
+	if (Profiler.IsEnabled())
+		job.EnqueueTime = JobProfiler::Now();
 }
 
 void Js::JobSystem::Wait(Counter& counter, const uint32_t targetValue)
 {
-	Log::Info("JobSystem::Wait: Waiting for counter\n");
+	Trace("JobSystem::Wait: Waiting for counter\n");
+	if (counter.IsSharded() && targetValue != 0)
+		throw JsException("Sharded counters can only be waited on for zero");
 	if (counter.GetValue() == targetValue)
 		return;
 
+	if (!IsWorkerThread())
+	{
+		WaitExternal(counter, targetValue);
+		return;
+	}
+
+	if (HelpWait(counter, targetValue))
+		return;
+
+	if (!Policies::Backend::SUSPENDS_ON_WAIT)
+	{
+		WaitStackless(counter, targetValue);
+		return;
+	}
+
 	Tls& tls = GetCurrentTls();
-	const auto fiberStored = new std::atomic_bool(false);
+	std::atomic_bool* fiberStored = ResetFiberStored(tls.CurrentFiberIndex);
 
-	Log::Info("JobSystem::Wait: Adding waiter fiber %d on thread %d\n", tls.CurrentFiberIndex, tls.ThreadIndex);
+	Trace("JobSystem::Wait: Adding waiter fiber %d on thread %d\n", tls.CurrentFiberIndex, tls.ThreadIndex);
 	if (counter.AddWaiter(tls.CurrentFiberIndex, fiberStored, targetValue))
-	{
-		delete fiberStored;
 		return;
+
+	SuspendCurrentFiber(fiberStored);
+}
+
+void Js::JobSystem::WaitStackless(Counter& counter, const uint32_t targetValue)
+{
+	// Jobs run here nest on the waiting job's stack, ready fibers are left for the worker loop since resuming
+	// one would hand this fiber back to the pool mid job. Past the nesting limit the wait only idles until other
+	// workers finish the jobs
+	uint32_t idleRounds = 0;
+	while (counter.GetValue() != targetValue)
+	{
+		Io.PollCompletions();
+		Timers.Poll();
+
+		Tls& tls = GetCurrentTls();
+		const uint16_t fiberIndex = tls.CurrentFiberIndex;
+		Job job;
+		if (InlineDepth[fiberIndex] < MAX_INLINE_DEPTH && TryGetJob(job, &tls, false))
+		{
+			++InlineDepth[fiberIndex];
+			ExecuteJob(job);
+			--InlineDepth[fiberIndex];
+			// The waiting job is still running
+			Scaler.OnJobBegin(GetCurrentTls().ThreadIndex);
+			idleRounds = 0;
+			continue;
+		}
+
+		FlushDecrements(tls);
+		Policies::Idle::Idle(idleRounds++);
+	}
+}
+
+bool Js::JobSystem::HelpWait(Counter& counter, const uint32_t targetValue)
+{
+	FlushDecrements(GetCurrentTls());
+	const uint16_t fiberIndex = GetCurrentTls().CurrentFiberIndex;
+	if (InlineDepth[fiberIndex] >= MAX_INLINE_DEPTH)
+		return counter.GetValue() == targetValue;
+
+	Job job;
+	size_t skipped = 0;
+	while (counter.GetValue() != targetValue && skipped < LocalQueueSize)
+	{
+		// An inline job may suspend and finish on another worker, so the local queue is looked up every time
+		const Tls& tls = GetCurrentTls();
+		LocalJobQueue* local = LocalQueues[tls.ThreadIndex].get();
+		JobHandle handle;
+		if (!local->Dequeue(handle))
+			break;
+
+		// Only the awaited counter's jobs are safe to run on top of this fiber, any other job could wait for
+		// something that needs the caller to continue first
+		if (JobPool.Get(handle).Counter != &counter)
+		{
+			// A stealer still reading its slot keeps the queue full, the job then goes to the shared queue
+			if (!local->Enqueue(handle) && !EnqueueJob(GetQueue(JobPriority::Normal), handle, false))
+				ReleaseUnqueued(handle, tls.ThreadIndex, true);
+			++skipped;
+			continue;
+		}
+
+		JobPool.Take(handle, job, tls.ThreadIndex);
+
+		Trace("JobSystem::HelpWait: Running job inline on fiber %d\n", fiberIndex);
+		++InlineDepth[fiberIndex];
+		ExecuteJob(job);
+		--InlineDepth[fiberIndex];
+
+		// The waiting job is still running
+		Scaler.OnJobBegin(GetCurrentTls().ThreadIndex);
 	}
 
+	// Inline jobs of a sharded counter are applied together, until then the loop may run more of them than needed
+	FlushDecrements(GetCurrentTls());
+	return counter.GetValue() == targetValue;
+}
+
+std::atomic_bool* Js::JobSystem::ResetFiberStored(const uint16_t fiberIndex)
+{
+	// The previous wait of this fiber finished once it was resumed, so nothing else reads the flag
+	std::atomic_bool* fiberStored = &FiberStored[fiberIndex];
+	fiberStored->store(false, std::memory_order_relaxed);
+	return fiberStored;
+}
+
+void Js::JobSystem::SuspendCurrentFiber(std::atomic_bool* fiberStored)
+{
+	Tls& tls = GetCurrentTls();
+	const uint16_t fiberIndex = tls.CurrentFiberIndex;
+	if (INSTRUMENTED && Profiler.IsEnabled())
+		Profiler.BeginSuspend(fiberIndex);
+	if (INSTRUMENTED && CpuCounters.IsEnabled())
+		CpuCounters.BeginSuspend(fiberIndex, tls.ThreadIndex);
+
 	tls.PreviousFiberIndex = tls.CurrentFiberIndex;
 	tls.PreviousFiberDestination = FiberDestination::Waiting;
 	tls.PreviousFiberStored = fiberStored;
 
 	Fiber* fiber = nullptr;
 	tls.CurrentFiberIndex = FiberPool.GetFreeFiber(fiber);
-	Log::Info("JobSystem::Wait: Switching from fiber %d to fiber %d\n", tls.PreviousFiberIndex, tls.CurrentFiberIndex);
+	Trace("JobSystem::SuspendCurrentFiber: Switching from fiber %d to fiber %d\n", tls.PreviousFiberIndex,
+	          tls.CurrentFiberIndex);
 	tls.ThreadFiber.SwitchTo(fiber, this);
 
-	Log::Info("JobSystem::Wait: Switched back from fiber %d to fiber %d\n", tls.CurrentFiberIndex,
+	Trace("JobSystem::SuspendCurrentFiber: Switched back from fiber %d to fiber %d\n", tls.CurrentFiberIndex,
 	          tls.PreviousFiberIndex);
 	CleanupPreviousFiber();
+
+	if (INSTRUMENTED && Profiler.IsEnabled())
+		Profiler.EndSuspend(fiberIndex);
+	// Resumed by whichever worker picked the fiber up
+	if (INSTRUMENTED && CpuCounters.IsEnabled())
+		CpuCounters.EndSuspend(fiberIndex, GetCurrentTls().ThreadIndex);
+}
+
+void Js::JobSystem::ResumeFiber(const uint16_t fiberIndex, std::atomic_bool* fiberStored)
+{
+	Thread* thread = FindCurrentThread();
+
+	const size_t pinnedWorker = FiberPins[fiberIndex].load(std::memory_order_relaxed);
+	if (pinnedWorker != SIZE_MAX && (thread == nullptr || thread->GetTls().ThreadIndex != pinnedWorker))
+	{
+		while (!PinnedReadyFibers[pinnedWorker]->Enqueue(ReadyFiber(fiberIndex, fiberStored)))
+			SwitchToThread();
+		if (IsReservedWorker(pinnedWorker))
+			NotifyReservedWorkers();
+		return;
+	}
+
+	// A reserved worker keeps to the fibers of its own kind of jobs
+	if (thread != nullptr &&
+		(!IsReservedWorker(thread->GetTls().ThreadIndex) || FiberReserved[fiberIndex].load(std::memory_order_relaxed)))
+	{
+		thread->GetTls().ReadyFibers.emplace_back(fiberIndex, fiberStored);
+		return;
+	}
+
+	// Otherwise the fiber goes to whichever unreserved worker drains the shared queue first
+	while (!SharedReadyFibers.Enqueue(ReadyFiber(fiberIndex, fiberStored)))
+		SwitchToThread();
+}
+
+void Js::JobSystem::WaitExternal(Counter& counter, const uint32_t targetValue)
+{
+	std::atomic<uint32_t> event{0};
+
+	Trace("JobSystem::WaitExternal: Adding external waiter\n");
+	if (counter.AddThreadWaiter(&event, targetValue))
+		return;
+
+	uint32_t notSet = 0;
+	while (event.load(std::memory_order_acquire) == notSet)
+		WaitOnAddress(&event, &notSet, sizeof(notSet), INFINITE);
+
+	Trace("JobSystem::WaitExternal: External waiter released\n");
 }
 
 void Js::JobSystem::CleanupPreviousFiber(Tls* tls)
@@ -160,20 +562,58 @@ void Js::JobSystem::CleanupPreviousFiber(Tls* tls)
 	tls->PreviousFiberDestination = FiberDestination::None;
 }
 
+void Js::JobSystem::DeferDecrement(Counter& counter)
+{
+	Tls& tls = GetCurrentTls();
+	if (tls.PendingCounter != &counter)
+	{
+		FlushDecrements(tls);
+		tls.PendingCounter = &counter;
+	}
+	++tls.PendingDecrements;
+}
+
+void Js::JobSystem::FlushDecrements(Tls& tls)
+{
+	if (tls.PendingCounter == nullptr)
+		return;
+
+	// The counter cannot complete before this decrement, so it is still alive
+	Counter* counter = tls.PendingCounter;
+	const uint32_t decrements = tls.PendingDecrements;
+	tls.PendingCounter = nullptr;
+	tls.PendingDecrements = 0;
+	counter->Decrement(decrements);
+}
+
 size_t Js::JobSystem::GetCurrentThreadIndex()
 {
 	return GetCurrentThread().GetId();
 }
 
-Js::Thread& Js::JobSystem::GetCurrentThread()
+Js::Thread* Js::JobSystem::FindCurrentThread()
 {
 	const size_t id = GetCurrentThreadId();
 	for (size_t i = 0; i < ThreadCount; ++i)
 	{
 		if (Threads[i].GetId() == id)
-			return Threads[i];
+			return &Threads[i];
 	}
-	return Threads[0];
+	return nullptr;
+}
+
+Js::Thread& Js::JobSystem::GetCurrentThread()
+{
+	Thread* thread = FindCurrentThread();
+	if (thread == nullptr)
+		throw JsException("Current thread is not a worker thread");
+
+	return *thread;
+}
+
+bool Js::JobSystem::IsWorkerThread()
+{
+	return FindCurrentThread() != nullptr;
 }
 
 Js::Tls& Js::JobSystem::GetCurrentTls()
@@ -183,26 +623,256 @@ Js::Tls& Js::JobSystem::GetCurrentTls()
 
 Js::JobQueue* Js::JobSystem::GetQueue(const JobPriority priority)
 {
-	switch (priority)
+	const auto index = static_cast<size_t>(priority);
+	if (index > static_cast<size_t>(JobPriority::Low))
+		return nullptr;
+
+	return PriorityQueues[std::min(index, PRIORITY_COUNT - 1)].get();
+}
+
+
+bool Js::JobSystem::RouteJob(const Job& job, JobQueue* queue, const bool waitIfFull)
+{
+	if (job.Affinity.Type == AffinityType::Worker && job.Affinity.Worker >= ThreadCount)
+		throw JsException("Job is pinned to a worker that does not exist");
+
+	Thread* thread = FindCurrentThread();
+	const size_t worker = thread != nullptr ? thread->GetTls().ThreadIndex : SIZE_MAX;
+
+	JobHandle handle;
+	while (!JobPool.TryAllocate(job, worker, handle))
 	{
-	case JobPriority::High:
-		return &HighPriorityQueue;
-	case JobPriority::Normal:
-		return &NormalPriorityQueue;
-	case JobPriority::Low:
-		return &LowPriorityQueue;
+		// Only reached while the queues are close to full, so it is handled like a full queue
+		if (!waitIfFull)
+			return false;
+		if (thread != nullptr)
+			throw JsException("Job pool is full");
+
+		SwitchToThread();
 	}
-	return nullptr;
+
+	// Workers must not block on a full queue, EnqueueJob would throw for them with the handle still taken
+	const bool wait = waitIfFull && thread == nullptr;
+	bool queued;
+	switch (job.Affinity.Type)
+	{
+	case AffinityType::Any:
+		// Jobs spawned by a worker stay on it so a Wait on their counter can run them inline
+		if (queue == GetQueue(JobPriority::Normal) && thread != nullptr)
+		{
+			if (LocalQueues[worker]->Enqueue(handle))
+				return true;
+			if (INSTRUMENTED)
+				LocalQueueOverflows.fetch_add(1, std::memory_order_relaxed);
+		}
+		break;
+	case AffinityType::Worker:
+		queued = EnqueueJob(PinnedQueues[job.Affinity.Worker].get(), handle, wait);
+		if (queued && IsReservedWorker(job.Affinity.Worker))
+			NotifyReservedWorkers();
+		if (!queued)
+			ReleaseUnqueued(handle, worker, waitIfFull);
+		return queued;
+	case AffinityType::LocalityKey:
+		{
+			const size_t owner = LocalityOwners[job.Affinity.Key % LocalityOwners.size()].load(std::memory_order_relaxed);
+			if (owner != SIZE_MAX)
+			{
+				queued = EnqueueJob(PreferredQueues[owner].get(), handle, wait);
+				if (!queued)
+					ReleaseUnqueued(handle, worker, waitIfFull);
+				return queued;
+			}
+			break;
+		}
+	}
+
+	if (!EnqueueJob(queue, handle, wait))
+	{
+		ReleaseUnqueued(handle, worker, waitIfFull);
+		return false;
+	}
+	if (queue == PriorityQueues[0].get())
+		NotifyReservedWorkers();
+	return true;
+}
+
+void Js::JobSystem::ReleaseUnqueued(const JobHandle handle, const size_t worker, const bool waitIfFull)
+{
+	JobPool.Release(handle, worker);
+	if (waitIfFull)
+		throw JsException("Queue is full");
+}
+
+size_t Js::JobSystem::BeginAffinity(const Job& job, const Tls& tls)
+{
+	const size_t previousPin = FiberPins[tls.CurrentFiberIndex].load(std::memory_order_relaxed);
+	switch (job.Affinity.Type)
+	{
+	case AffinityType::Any:
+		break;
+	case AffinityType::Worker:
+		FiberPins[tls.CurrentFiberIndex].store(tls.ThreadIndex, std::memory_order_relaxed);
+		break;
+	case AffinityType::LocalityKey:
+		LocalityOwners[job.Affinity.Key % LocalityOwners.size()].store(tls.ThreadIndex, std::memory_order_relaxed);
+		break;
+	}
+	return previousPin;
+}
+
+void Js::JobSystem::EndAffinity(const Job& job, const Tls& tls, const size_t previousPin)
+{
+	// A job run inline by a waiting pinned job must leave the fiber pinned
+	if (job.Affinity.Type == AffinityType::Worker)
+		FiberPins[tls.CurrentFiberIndex].store(previousPin, std::memory_order_relaxed);
 }
 
-bool Js::JobSystem::TryGetJob(Job& job, Tls* tls)
+void Js::JobSystem::ExecuteJob(const Job& job)
 {
-	if (HighPriorityQueue.Dequeue(job))
+	Tls& jobTls = GetCurrentTls();
+	const bool profiling = INSTRUMENTED && Profiler.IsEnabled();
+	const uint64_t start = profiling ? JobProfiler::Now() : 0;
+	const uint64_t suspendedBefore = profiling ? Profiler.GetSuspendedTime(jobTls.CurrentFiberIndex) : 0;
+	const bool counting = INSTRUMENTED && CpuCounters.IsEnabled();
+	JobCounters::Sample countersBefore;
+	if (counting)
+		countersBefore = CpuCounters.Read(jobTls.CurrentFiberIndex);
+
+	if (jobTls.PendingCounter != job.Counter)
+		FlushDecrements(jobTls);
+
+	Scaler.OnJobBegin(jobTls.ThreadIndex);
+	FiberReserved[jobTls.CurrentFiberIndex].store(IsReservedWorker(jobTls.ThreadIndex), std::memory_order_relaxed);
+	const size_t previousPin = BeginAffinity(job, jobTls);
+	job.Execute();
+	EndAffinity(job, jobTls, previousPin);
+
+	// The job may have been resumed on another worker, the fiber and its stack stay the same
+	Tls& endTls = GetCurrentTls();
+	Scaler.OnJobEnd(endTls.ThreadIndex);
+	if (INSTRUMENTED && Stacks.IsEnabled())
+		Stacks.Measure(endTls.CurrentFiberIndex, job.TagIndex);
+	if (profiling)
+	{
+		const uint64_t end = JobProfiler::Now();
+		const uint64_t suspended = Profiler.GetSuspendedTime(endTls.CurrentFiberIndex) - suspendedBefore;
+		Profiler.Record(endTls.ThreadIndex, job.TagIndex, start - job.EnqueueTime, end - start - suspended, suspended);
+	}
+	if (counting)
+		CpuCounters.Record(endTls.ThreadIndex, job.TagIndex, countersBefore, CpuCounters.Read(endTls.CurrentFiberIndex));
+}
+
+bool Js::JobSystem::TryGetJob(Job& job, Tls* tls, const bool resumeFibers)
+{
+	if (tls == nullptr)
+		tls = &GetCurrentTls();
+
+	if (DequeueJob(PinnedQueues[tls->ThreadIndex].get(), job, *tls) ||
+		DequeueJob(PreferredQueues[tls->ThreadIndex].get(), job, *tls))
+	{
+		return true;
+	}
+
+	// With several priorities the highest one goes ahead of resumed fibers
+	if (PRIORITY_COUNT > 1 && DequeueJob(PriorityQueues[0].get(), job, *tls))
+		return true;
+
+	ReadyFiber readyFiber;
+	while (SharedReadyFibers.Dequeue(readyFiber))
+		tls->ReadyFibers.push_back(readyFiber);
+	while (PinnedReadyFibers[tls->ThreadIndex]->Dequeue(readyFiber))
+		tls->ReadyFibers.push_back(readyFiber);
+
+	if (resumeFibers)
+		ResumeReadyFiber(tls);
+
+	if (DequeueJob(LocalQueues[tls->ThreadIndex].get(), job, *tls))
 		return true;
 
+	for (size_t i = PRIORITY_COUNT > 1 ? 1 : 0; i < PRIORITY_COUNT; ++i)
+	{
+		if (DequeueJob(PriorityQueues[i].get(), job, *tls))
+			return true;
+	}
+
+	for (size_t i = 1; i < ThreadCount; ++i)
+	{
+		const size_t worker = (tls->ThreadIndex + i) % ThreadCount;
+		if (DequeueJob(PreferredQueues[worker].get(), job, *tls) || DequeueJob(LocalQueues[worker].get(), job, *tls))
+			return true;
+	}
+
+	return false;
+}
+
+bool Js::JobSystem::TryGetPinnedJob(Job& job, Tls* tls)
+{
 	if (tls == nullptr)
 		tls = &GetCurrentTls();
 
+	if (DequeueJob(PinnedQueues[tls->ThreadIndex].get(), job, *tls))
+		return true;
+
+	ReadyFiber readyFiber;
+	while (PinnedReadyFibers[tls->ThreadIndex]->Dequeue(readyFiber))
+		tls->ReadyFibers.push_back(readyFiber);
+
+	ResumeReadyFiber(tls);
+	return false;
+}
+
+bool Js::JobSystem::TryGetReservedJob(Job& job, Tls* tls)
+{
+	if (DequeueJob(PinnedQueues[tls->ThreadIndex].get(), job, *tls) || DequeueJob(PriorityQueues[0].get(), job, *tls))
+		return true;
+
+	// Fibers of other jobs are left in the shared queue for the unreserved workers
+	ReadyFiber readyFiber;
+	while (PinnedReadyFibers[tls->ThreadIndex]->Dequeue(readyFiber))
+		tls->ReadyFibers.push_back(readyFiber);
+
+	ResumeReadyFiber(tls);
+	return false;
+}
+
+void Js::JobSystem::WaitForReservedWork(const Tls& tls)
+{
+	// A fiber still being switched away from becomes ready in a moment, no point sleeping
+	if (!tls.ReadyFibers.empty())
+	{
+		_mm_pause();
+		return;
+	}
+
+	uint32_t epoch = HighPriorityEpoch.load(std::memory_order_acquire);
+	SleepingReservedWorkers.fetch_add(1, std::memory_order_relaxed);
+	// Pairs with the fence in NotifyReservedWorkers, either the new work is seen here or this sleeper there
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (PriorityQueues[0]->IsEmpty() && PinnedQueues[tls.ThreadIndex]->IsEmpty() &&
+		PinnedReadyFibers[tls.ThreadIndex]->IsEmpty() && !Quit.load(std::memory_order_relaxed))
+	{
+		// Timers and completions are polled by the loop, the timeout keeps them from waiting on other workers
+		WaitOnAddress(&HighPriorityEpoch, &epoch, sizeof(epoch), RESERVED_IDLE_TIMEOUT_MS);
+	}
+
+	SleepingReservedWorkers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void Js::JobSystem::NotifyReservedWorkers()
+{
+	if (ReservedWorkers == 0)
+		return;
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	HighPriorityEpoch.fetch_add(1, std::memory_order_release);
+	if (SleepingReservedWorkers.load(std::memory_order_relaxed) != 0)
+		WakeByAddressAll(&HighPriorityEpoch);
+}
+
+bool Js::JobSystem::ResumeReadyFiber(Tls*& tls)
+{
 	for (auto it = tls->ReadyFibers.begin(); it != tls->ReadyFibers.end(); ++it)
 	{
 		const uint16_t fiberIndex = it->first;
@@ -210,27 +880,38 @@ bool Js::JobSystem::TryGetJob(Job& job, Tls* tls)
 
 		if (!it->second->load(std::memory_order_relaxed))
 		{
-			Log::Info("JobSystem::TryGetJob: Fiber %d is not ready\n", fiberIndex);
+			Trace("JobSystem::ResumeReadyFiber: Fiber %d is not ready\n", fiberIndex);
 			continue;
 		}
 
-		Log::Info("JobSystem::TryGetJob: Fiber %d is ready\n", fiberIndex);
-		delete it->second;
+		Trace("JobSystem::ResumeReadyFiber: Fiber %d is ready\n", fiberIndex);
 		tls->ReadyFibers.erase(it);
+		// The resumed job may run for long, decrements held for other counters must not wait for it
+		FlushDecrements(*tls);
 
 		tls->PreviousFiberIndex = tls->CurrentFiberIndex;
 		tls->PreviousFiberDestination = FiberDestination::Pool;
 		tls->CurrentFiberIndex = fiberIndex;
-		Log::Info("JobSystem::TryGetJob: Switching from fiber %d to fiber %d\n", tls->PreviousFiberIndex,
+		Trace("JobSystem::ResumeReadyFiber: Switching from fiber %d to fiber %d\n", tls->PreviousFiberIndex,
 		          tls->CurrentFiberIndex);
 
 		tls->ThreadFiber.SwitchTo(&FiberPool.GetFiber(fiberIndex), this);
+
+		// This fiber went back to the pool and may have been picked up by another worker
+		tls = &GetCurrentTls();
 		CleanupPreviousFiber(tls);
 
-		break;
+		return true;
 	}
 
-	return NormalPriorityQueue.Dequeue(job) || LowPriorityQueue.Dequeue(job);
+	return false;
+}
+
+void Js::JobSystem::SetWorkerAffinity(Thread& thread, const size_t worker)
+{
+	const size_t cpu = GetWorkerCpu(worker);
+	if (cpu != SIZE_MAX)
+		thread.SetAffinity(cpu);
 }
 
 void Js::JobSystem::ThreadWorker(Thread* thread)
@@ -241,7 +922,7 @@ void Js::JobSystem::ThreadWorker(Thread* thread)
 
 	Tls& tls = thread->GetTls();
 
-	thread->SetAffinity(tls.ThreadIndex);
+	jobSystem->SetWorkerAffinity(*thread, tls.ThreadIndex);
 	tls.ThreadFiber.FromCurrentThread();
 
 	while (!jobSystem->Initialized.load(std::memory_order_acquire))
@@ -262,21 +943,54 @@ void Js::JobSystem::FiberWorker(Fiber* fiber)
 	const auto jobSystem = static_cast<JobSystem*>(fiber->GetData());
 	jobSystem->CleanupPreviousFiber();
 
+	if (INSTRUMENTED && jobSystem->Stacks.IsEnabled())
+		jobSystem->Stacks.Paint(jobSystem->GetCurrentTls().CurrentFiberIndex);
+
+	uint32_t idleRounds = 0;
 	while (!jobSystem->Quit.load(std::memory_order_acquire))
 	{
 		Tls& tls = jobSystem->GetCurrentTls();
+		jobSystem->Io.PollCompletions();
+		jobSystem->Timers.Poll();
+
 		Job job;
-		if (jobSystem->TryGetJob(job, &tls))
+		if (jobSystem->IsReservedWorker(tls.ThreadIndex))
 		{
-			Log::Info("JobSystem::FiberWorker: Executing job\n");
-			job.Execute();
-			Log::Info("JobSystem::FiberWorker: Job executed\n");
+			if (jobSystem->TryGetReservedJob(job, &tls))
+			{
+				jobSystem->ExecuteJob(job);
+				continue;
+			}
+
+			Tls& idleTls = jobSystem->GetCurrentTls();
+			jobSystem->FlushDecrements(idleTls);
+			jobSystem->WaitForReservedWork(idleTls);
 			continue;
 		}
 
-		SwitchToThread();
+		const bool parked = jobSystem->Scaler.IsParked(tls.ThreadIndex);
+		if (parked ? jobSystem->TryGetPinnedJob(job, &tls) : jobSystem->TryGetJob(job, &tls))
+		{
+			Trace("JobSystem::FiberWorker: Executing job\n");
+			jobSystem->ExecuteJob(job);
+			Trace("JobSystem::FiberWorker: Job executed\n");
+			idleRounds = 0;
+			continue;
+		}
+
+		Tls& idleTls = jobSystem->GetCurrentTls();
+		jobSystem->FlushDecrements(idleTls);
+		if (parked)
+		{
+			jobSystem->Scaler.Park(idleTls.ThreadIndex);
+			continue;
+		}
+
+		jobSystem->Scaler.OnIdle(idleTls.ThreadIndex);
+		Policies::Idle::Idle(idleRounds++);
 	}
 
+	jobSystem->FlushDecrements(jobSystem->GetCurrentTls());
 	assert(fiber->ReturnFiber != nullptr);
 	fiber->SwitchBack();
 }
@@ -285,9 +999,9 @@ void Js::JobSystem::FiberMain(Fiber* fiber)
 {
 	Log::Info("JobSystem::FiberMain: Fiber main\n");
 	const auto jobSystem = static_cast<JobSystem*>(fiber->GetData());
-	Tls& tls = jobSystem->GetCurrentTls();
-	jobSystem->CleanupPreviousFiber();
 
-	assert(fiber->ReturnFiber != nullptr);
-	fiber->SwitchBack();
+	// Stands in for the main thread in the ready lists, every resume hands the thread back to its own stack which
+	// cleans up the fiber it came from
+	for (;;)
+		fiber->SwitchTo(&jobSystem->Threads[0].GetTls().ThreadFiber, jobSystem);
 }
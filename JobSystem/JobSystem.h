@@ -1,10 +1,23 @@
 #pragma once
-#include <thread>
+#include <array>
+#include <memory>
+#include <string>
 
+#include "CpuQuota.h"
 #include "FiberPool.h"
+#include "IoSystem.h"
+#include "JobCounters.h"
+#include "JobPool.h"
+#include "JobProfiler.h"
+#include "JobSystemPolicies.h"
+#include "MemoryResource.h"
 #include "Queue.h"
+#include "StackMonitor.h"
+#include "TagRegistry.h"
 #include "Thread.h"
+#include "TimerWheel.h"
 #include "Tls.h"
+#include "WorkerScaler.h"
 
 namespace Js
 {
@@ -18,24 +31,102 @@ namespace Js
 		Low
 	};
 
-	using JobQueue = Queue<Job>;
+	// Job queues carry handles into the JobPool, the payload is copied in once and moved out by the worker running it
+	using JobQueue = ActivePolicies::Queue<JobHandle>;
+	using ReadyFiberQueue = Queue<ReadyFiber>;
+	// Only the owning worker drains its pinned queues
+	using PinnedJobQueue = MpscQueue<JobHandle>;
+	using PinnedReadyFiberQueue = MpscQueue<ReadyFiber>;
+	// Filled only by the owning worker, drained by it and by idle workers stealing
+	using LocalJobQueue = Queue<JobHandle, QueuePolicy::SingleProducer, QueuePolicy::MultiConsumer>;
 
 	struct Options
 	{
-		Options() : ThreadCount(std::thread::hardware_concurrency()) {}
+		Options() : ThreadCount(GetAvailableCpuCount()) {}
 		~Options() = default;
 
 		size_t ThreadCount;
 		uint16_t FiberCount = 512;
+		// 0 uses Fiber::DEFAULT_STACK_SIZE
+		size_t FiberStackSize = 0;
 
+		// Paints fiber stacks and measures how deep every job reaches, costs a scan of the stack after each job
+		bool StackPainting = false;
+		// Stack size recommended by an earlier run is read from here and replaces FiberStackSize, with
+		// StackPainting the new recommendation is written back at Shutdown
+		std::string StackSizeFile;
+
+		// Records per tag histograms of queue wait, execution and suspended time, see JobSystem::GetJobStats
+		bool JobProfiling = false;
+		// Counts CPU cycles, suspensions and worker migrations per tag, see JobSystem::GetJobCounters
+		bool JobCounters = false;
+
+		// Elastic workers start MaxThreadCount threads (0 means twice ThreadCount) and keep between
+		// MinThreadCount and MaxThreadCount of them active depending on quota, load and blocked jobs
+		bool ElasticWorkers = false;
+		size_t MinThreadCount = 1;
+		size_t MaxThreadCount = 0;
+		uint32_t BlockedJobThresholdMs = 50;
+		uint32_t ScalerIntervalMs = 10;
+
+		// The last ReservedWorkers workers only run High priority jobs, jobs pinned to them and the fibers of those, and
+		// sleep on the High priority queue so a High job is picked up right away even while every other worker
+		// is busy. Needs separate priority queues, not available with ElasticWorkers
+		size_t ReservedWorkers = 0;
+
+		// With fewer than three priority queues, merged priorities use the largest of their sizes
 		size_t LowPriorityQueueSize = 4096;
 		size_t NormalPriorityQueueSize = 2048;
 		size_t HighPriorityQueueSize = 1024;
+		size_t WorkerQueueSize = 256;
+		// Queued jobs each worker keeps in its own pool segment before it falls back to the shared one, which
+		// holds as many jobs as all queues together
+		size_t WorkerJobPoolSize = 256;
+		size_t LocalityTableSize = 4096;
+
+		IoBackend IoBackend = Js::IoBackend::CompletionPort;
+		size_t IoThreadCount = 2;
+
+		// Used for queue rings, the job pool, ready fiber lists and per fiber state, nullptr uses the default resource.
+		// Must outlive the JobSystem
+		MemoryResource* MemoryResource = nullptr;
+	};
+
+	// Bytes the JobSystem allocated up front, reported at Initialize
+	struct MemoryUsage
+	{
+		size_t QueueBytes = 0;
+		size_t JobPoolBytes = 0;
+		size_t ReadyFiberListBytes = 0;
+		size_t FiberStateBytes = 0;
+		// Reserved by CreateFiber outside the memory resource
+		size_t FiberStackBytes = 0;
+
+		size_t ResourceAllocatedBytes = 0;
+		size_t ResourceReservedBytes = 0;
+	};
+
+	// How close the scheduler came to running out of fibers and queue space since Initialize
+	struct SchedulerPressure
+	{
+		uint16_t FiberCount = 0;
+		uint16_t PeakFibersInUse = 0;
+		uint64_t FiberPoolExhausted = 0;
+		// Enqueues that found a full shared or per worker queue and had to wait
+		uint64_t QueueFullRetries = 0;
+		// Jobs spawned by a worker that did not fit in its local queue
+		uint64_t LocalQueueOverflows = 0;
+		// Jobs spawned by a worker whose job pool segment was empty
+		uint64_t JobPoolFallbacks = 0;
 	};
 
 	class JobSystem
 	{
 	public:
+		using Policies = ActivePolicies;
+		static constexpr size_t PRIORITY_COUNT = Policies::PRIORITY_COUNT;
+		static constexpr bool INSTRUMENTED = Policies::Instrumentation::ENABLED;
+
 		explicit JobSystem(const Options& options = Options());
 		JobSystem(const JobSystem&) = delete;
 		JobSystem(JobSystem&&) = delete;
@@ -51,35 +142,140 @@ namespace Js
 
 		void Wait(Counter& counter, const uint32_t targetValue);
 
+		// Queues the job once delayMs have passed, the counter completes when the job ran or its timer was cancelled
+		TimerId AddJobAfter(Job& job, uint32_t delayMs, Counter* counter = nullptr,
+		                    JobPriority priority = JobPriority::Normal);
+		// Queues a copy of the job every periodMs until the timer is cancelled, copies overlap when the job runs
+		// longer than the period
+		TimerId AddPeriodicJob(Job& job, uint32_t periodMs, JobPriority priority = JobPriority::Normal);
+		bool CancelTimer(TimerId timer);
+
+		bool IsWorkerThread();
 		size_t GetThreadCount() const { return ThreadCount; }
+		size_t GetActiveThreadCount() const { return Scaler.GetActiveCount(); }
+		size_t GetReservedWorkerCount() const { return ReservedWorkers; }
+		IoSystem& GetIoSystem() { return Io; }
+		MemoryUsage GetMemoryUsage();
+		SchedulerPressure GetSchedulerPressure() const;
+		const StackMonitor& GetStackMonitor() const { return Stacks; }
+		std::vector<JobTagStats> GetJobStats() const { return Profiler.GetTagStats(); }
+		std::vector<JobCounterStats> GetJobCounters() const { return CpuCounters.GetTagStats(); }
 
 	private:
 		friend class Counter;
+		friend class Job;
+		friend class JobGraph;
+		friend class WaitList;
+		friend class WorkerScaler;
+		friend class TimerWheel;
+		friend void SleepFor(JobSystem& system, uint32_t milliseconds);
 
 		std::atomic_bool Initialized{false};
 		std::atomic<size_t> InitializedThreads{0};
 		std::atomic_bool Quit{false};
 
+		MemoryResource* Memory;
+		uint16_t FiberCount;
+		size_t LocalQueueSize;
+
+		std::atomic<uint64_t> QueueFullRetries{0};
+		std::atomic<uint64_t> LocalQueueOverflows{0};
+
+		size_t ReservedWorkers = 0;
+		// Bumped on every High priority enqueue, idle reserved workers wait on it
+		std::atomic<uint32_t> HighPriorityEpoch{0};
+		std::atomic<uint32_t> SleepingReservedWorkers{0};
+
 		size_t ThreadCount;
 		std::vector<Thread> Threads;
+		WorkerScaler Scaler;
 
 		FiberPool FiberPool;
+		TagRegistry Tags;
+		StackMonitor Stacks;
+		JobProfiler Profiler;
+		JobCounters CpuCounters;
+		IoSystem Io;
+		TimerWheel Timers;
+		JobPool JobPool;
 
 		void CleanupPreviousFiber(Tls* tls = nullptr);
+		// Sharded counters are decremented once per run of their jobs on a worker, see CounterMode
+		void DeferDecrement(Counter& counter);
+		void FlushDecrements(Tls& tls);
+		void WaitExternal(Counter& counter, const uint32_t targetValue);
+		void SuspendCurrentFiber(std::atomic_bool* fiberStored);
+		void ResumeFiber(uint16_t fiberIndex, std::atomic_bool* fiberStored);
 
 		size_t GetCurrentThreadIndex();
+		Thread* FindCurrentThread();
 		Thread& GetCurrentThread();
 		Tls& GetCurrentTls();
 
-		JobQueue HighPriorityQueue;
-		JobQueue NormalPriorityQueue;
-		JobQueue LowPriorityQueue;
+		// Highest priority first
+		std::array<std::unique_ptr<JobQueue>, PRIORITY_COUNT> PriorityQueues;
+
+		ReadyFiberQueue SharedReadyFibers;
+
+		// Per worker inboxes, pinned jobs run only on their worker, preferred ones can be stolen by idle workers
+		std::vector<std::unique_ptr<PinnedJobQueue>> PinnedQueues;
+		std::vector<std::unique_ptr<JobQueue>> PreferredQueues;
+		std::vector<std::unique_ptr<PinnedReadyFiberQueue>> PinnedReadyFibers;
+		// Normal priority jobs spawned by each worker, so Wait can run the awaited counter's jobs inline
+		std::vector<std::unique_ptr<LocalJobQueue>> LocalQueues;
+
+		template <typename T>
+		using ResourceVector = std::vector<T, ResourceAllocator<T>>;
+
+		// Worker a fiber is pinned to while it runs a pinned job
+		ResourceVector<std::atomic<size_t>> FiberPins;
+		ResourceVector<std::atomic<size_t>> LocalityOwners;
+		// Set once a suspended fiber is off its thread's stack, one per fiber since a fiber waits on one thing at a time
+		ResourceVector<std::atomic_bool> FiberStored;
+		// Set while the fiber runs a job a reserved worker took, other fibers are never resumed on reserved workers
+		ResourceVector<std::atomic_bool> FiberReserved;
+		// Jobs nested on each fiber by HelpWait and WaitStackless, bounded to keep fiber stacks from overflowing
+		ResourceVector<uint32_t> InlineDepth;
+		static constexpr uint32_t MAX_INLINE_DEPTH = 16;
+		static constexpr uint32_t RESERVED_IDLE_TIMEOUT_MS = 1;
+
+		std::atomic_bool* ResetFiberStored(uint16_t fiberIndex);
+		void ReportMemoryUsage();
+
+		static size_t GetSharedReadyFibersSize(uint16_t fiberCount);
+		static size_t GetSharedJobPoolSize(const Options& options, size_t threadCount);
 
 		JobQueue* GetQueue(JobPriority priority);
-		bool TryGetJob(Job& job, Tls* tls);
+		void WaitStackless(Counter& counter, uint32_t targetValue);
+		void PrepareJob(Job& job, Counter* counter);
+		bool RouteJob(const Job& job, JobQueue* queue, bool waitIfFull = true);
+		// Gives back the handle of a job no queue took, throws when the caller asked to wait for space
+		void ReleaseUnqueued(JobHandle handle, size_t worker, bool waitIfFull);
+		template <typename TQueue>
+		bool EnqueueJob(TQueue* queue, JobHandle handle, bool waitIfFull = true);
+		template <typename TQueue>
+		bool DequeueJob(TQueue* queue, Job& job, const Tls& tls);
+		bool QueueTimerJob(Job& job, Counter* counter, JobPriority priority);
+		// Jobs of a sealed JobGraph are prepared once and queued again on every replay
+		void QueuePreparedJob(Job& job, JobPriority priority);
+		size_t BeginAffinity(const Job& job, const Tls& tls);
+		void EndAffinity(const Job& job, const Tls& tls, size_t previousPin);
+		void ExecuteJob(const Job& job);
+		bool HelpWait(Counter& counter, uint32_t targetValue);
+		bool TryGetJob(Job& job, Tls* tls, bool resumeFibers = true);
+		bool TryGetPinnedJob(Job& job, Tls* tls);
+		bool IsReservedWorker(const size_t worker) const { return worker >= ThreadCount - ReservedWorkers; }
+		bool TryGetReservedJob(Job& job, Tls* tls);
+		void WaitForReservedWork(const Tls& tls);
+		void NotifyReservedWorkers();
+		bool ResumeReadyFiber(Tls*& tls);
+		void SetWorkerAffinity(Thread& thread, size_t worker);
 
 		static void ThreadWorker(Thread* thread);
 		static void FiberWorker(Fiber* fiber);
 		static void FiberMain(Fiber* fiber);
 	};
+
+	// Suspends only the calling fiber for at least the given time, other threads fall back to Sleep
+	void SleepFor(JobSystem& system, uint32_t milliseconds);
 }
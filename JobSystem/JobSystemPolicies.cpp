@@ -0,0 +1,31 @@
+#include "JobSystemPolicies.h"
+
+#include <immintrin.h>
+
+#include "WindowsMinimal.h"
+
+namespace
+{
+	constexpr uint32_t BACKOFF_SPIN_ROUNDS = 64;
+	constexpr uint32_t BACKOFF_YIELD_ROUNDS = 256;
+}
+
+void Js::IdlePolicy::Yield::Idle(uint32_t)
+{
+	SwitchToThread();
+}
+
+void Js::IdlePolicy::Spin::Idle(uint32_t)
+{
+	_mm_pause();
+}
+
+void Js::IdlePolicy::Backoff::Idle(const uint32_t idleRounds)
+{
+	if (idleRounds < BACKOFF_SPIN_ROUNDS)
+		_mm_pause();
+	else if (idleRounds < BACKOFF_YIELD_ROUNDS)
+		SwitchToThread();
+	else
+		Sleep(1);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "Queue.h"
+
+namespace Js
+{
+	namespace IdlePolicy
+	{
+		// Called by a worker that found no job, idleRounds counts the empty polls since its last job
+
+		// Gives the rest of the time slice to another ready thread
+		struct Yield
+		{
+			static void Idle(uint32_t idleRounds);
+		};
+
+		// Keeps the core busy for the lowest wake-up latency, only when workers do not share cores
+		struct Spin
+		{
+			static void Idle(uint32_t idleRounds);
+		};
+
+		// Spins briefly, then yields, then sleeps so idle workers stop burning CPU
+		struct Backoff
+		{
+			static void Idle(uint32_t idleRounds);
+		};
+	}
+
+	namespace InstrumentationPolicy
+	{
+		// Tracing, stack painting, job profiling and pressure counters, still switched on through Options
+		struct Enabled
+		{
+			static constexpr bool ENABLED = true;
+		};
+
+		// Compiles out tracing and all diagnostics, the matching Options are ignored
+		struct Disabled
+		{
+			static constexpr bool ENABLED = false;
+		};
+	}
+
+	namespace BackendPolicy
+	{
+		// A worker waiting on a counter suspends its fiber and picks up other work on a fresh one
+		struct Fibers
+		{
+			static constexpr bool SUSPENDS_ON_WAIT = true;
+		};
+
+		// A worker waiting on a counter runs other jobs on top of its own stack until the counter is reached,
+		// so a Wait never switches fibers. Workers still run on one pool fiber each, which WaitList based
+		// primitives keep suspending
+		struct Stackless
+		{
+			static constexpr bool SUSPENDS_ON_WAIT = false;
+		};
+	}
+
+	template <template <typename> class TQueue, size_t PriorityCount, typename TIdle, typename TInstrumentation,
+	          typename TBackend>
+	struct JobSystemPolicies
+	{
+		static_assert(PriorityCount >= 1 && PriorityCount <= 3, "JobPriority has three levels");
+
+		// Shared priority queues, per worker queues keep their own producer and consumer policies
+		template <typename T>
+		using Queue = TQueue<T>;
+		// Priorities past the count share the lowest queue
+		static constexpr size_t PRIORITY_COUNT = PriorityCount;
+		using Idle = TIdle;
+		using Instrumentation = TInstrumentation;
+		using Backend = TBackend;
+	};
+
+	using DefaultPolicies = JobSystemPolicies<MpmcQueue, 3, IdlePolicy::Yield, InstrumentationPolicy::Enabled,
+	                                          BackendPolicy::Fibers>;
+	// One queue and no diagnostics for throughput runs
+	using LeanPolicies = JobSystemPolicies<MpmcQueue, 1, IdlePolicy::Backoff, InstrumentationPolicy::Disabled,
+	                                       BackendPolicy::Fibers>;
+}
+
+// Job, Counter and the synchronization primitives all take a JobSystem&, so the policies are picked once per
+// build rather than per instance. Every translation unit has to see the same definition
+#ifndef JS_JOBSYSTEM_POLICIES
+#define JS_JOBSYSTEM_POLICIES Js::DefaultPolicies
+#endif
+
+namespace Js
+{
+	using ActivePolicies = JS_JOBSYSTEM_POLICIES;
+}
@@ -0,0 +1,57 @@
+#include "Latch.h"
+
+#include "WindowsMinimal.h"
+
+#include "JobSystem.h"
+#include "JSException.h"
+
+Js::Latch::Latch(JobSystem& system, const uint32_t count) :
+	Count(count),
+	System(&system) {}
+
+void Js::Latch::CountDown(const uint32_t count)
+{
+	const uint32_t oldCount = Count.fetch_sub(count, std::memory_order_acq_rel);
+	if (oldCount < count)
+		throw JsException("Latch counted down below zero");
+
+	if (oldCount != count)
+		return;
+
+	Waiters.Lock();
+	WaitList::Waiter* waiters = Waiters.PopAll();
+	Waiters.Unlock();
+
+	WaitList::ResumeAll(*System, waiters);
+}
+
+bool Js::Latch::TryWait() const
+{
+	return Count.load(std::memory_order_acquire) == 0;
+}
+
+void Js::Latch::Wait()
+{
+	for (size_t i = 0; i < WaitList::SPIN_COUNT; ++i)
+	{
+		if (TryWait())
+			return;
+
+		_mm_pause();
+	}
+
+	Waiters.Lock();
+	if (TryWait())
+	{
+		Waiters.Unlock();
+		return;
+	}
+
+	Waiters.Park(*System);
+}
+
+void Js::Latch::ArriveAndWait(const uint32_t count)
+{
+	CountDown(count);
+	Wait();
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "WaitList.h"
+
+namespace Js
+{
+	class JobSystem;
+
+	class Latch
+	{
+	public:
+		Latch(JobSystem& system, uint32_t count);
+		Latch(const Latch&) = delete;
+		~Latch() = default;
+
+		void CountDown(uint32_t count = 1);
+		bool TryWait() const;
+		void Wait();
+		void ArriveAndWait(uint32_t count = 1);
+
+	private:
+		std::atomic<uint32_t> Count;
+		JobSystem* System;
+		WaitList Waiters;
+	};
+}
@@ -0,0 +1,116 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	uint32_t GetExponent(uint64_t value)
+	{
+		uint32_t exponent = 0;
+		while (value >>= 1)
+			++exponent;
+		return exponent;
+	}
+
+	// The owning worker is the only writer, so a plain load and store avoids a locked instruction
+	void AddRelaxed(std::atomic<uint64_t>& target, const uint64_t value)
+	{
+		target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+}
+
+Js::LatencyHistogram::LatencyHistogram(const LatencyHistogram& other)
+{
+	Merge(other);
+}
+
+Js::LatencyHistogram& Js::LatencyHistogram::operator=(const LatencyHistogram& other)
+{
+	if (this == &other)
+		return *this;
+
+	for (auto& bucket : Buckets)
+		bucket.store(0, std::memory_order_relaxed);
+	Count.store(0, std::memory_order_relaxed);
+	Sum.store(0, std::memory_order_relaxed);
+	Max.store(0, std::memory_order_relaxed);
+
+	Merge(other);
+	return *this;
+}
+
+size_t Js::LatencyHistogram::GetBucket(const uint64_t value)
+{
+	if (value < SUB_BUCKETS)
+		return static_cast<size_t>(value);
+
+	const uint32_t exponent = GetExponent(value);
+	if (exponent > MAX_EXPONENT)
+		return BUCKET_COUNT - 1;
+
+	const uint32_t shift = exponent - SUB_BUCKET_BITS;
+	const size_t subBucket = static_cast<size_t>(value >> shift) - SUB_BUCKETS;
+	return SUB_BUCKETS + static_cast<size_t>(shift) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t Js::LatencyHistogram::GetBucketValue(const size_t bucket)
+{
+	if (bucket < SUB_BUCKETS)
+		return bucket;
+
+	const uint64_t shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+	const uint64_t subBucket = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+	return ((SUB_BUCKETS + subBucket + 1) << shift) - 1;
+}
+
+void Js::LatencyHistogram::Record(const uint64_t value)
+{
+	AddRelaxed(Buckets[GetBucket(value)], 1);
+	AddRelaxed(Count, 1);
+	AddRelaxed(Sum, value);
+	if (value > Max.load(std::memory_order_relaxed))
+		Max.store(value, std::memory_order_relaxed);
+}
+
+void Js::LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+	for (size_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		const uint64_t count = other.Buckets[i].load(std::memory_order_relaxed);
+		if (count != 0)
+			AddRelaxed(Buckets[i], count);
+	}
+
+	AddRelaxed(Count, other.Count.load(std::memory_order_relaxed));
+	AddRelaxed(Sum, other.Sum.load(std::memory_order_relaxed));
+
+	const uint64_t max = other.Max.load(std::memory_order_relaxed);
+	if (max > Max.load(std::memory_order_relaxed))
+		Max.store(max, std::memory_order_relaxed);
+}
+
+double Js::LatencyHistogram::GetMean() const
+{
+	const uint64_t count = GetCount();
+	return count != 0 ? static_cast<double>(Sum.load(std::memory_order_relaxed)) / static_cast<double>(count) : 0.0;
+}
+
+uint64_t Js::LatencyHistogram::GetPercentile(const double fraction) const
+{
+	uint64_t total = 0;
+	for (const auto& bucket : Buckets)
+		total += bucket.load(std::memory_order_relaxed);
+	if (total == 0)
+		return 0;
+
+	const auto target = static_cast<uint64_t>(std::ceil(static_cast<double>(total) * fraction));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += Buckets[i].load(std::memory_order_relaxed);
+		if (seen >= target)
+			return std::min(GetBucketValue(i), GetMax());
+	}
+	return GetMax();
+}
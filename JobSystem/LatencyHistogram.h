@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Js
+{
+	// HDR-style log-linear histogram of nanosecond durations: exact below 32 ns, then 32 sub-buckets per power
+	// of two (about 3% relative error) up to roughly 18 minutes. Record has a single writer, readers may merge
+	// or copy concurrently and see a slightly stale but consistent enough view
+	class LatencyHistogram
+	{
+	public:
+		LatencyHistogram() = default;
+		LatencyHistogram(const LatencyHistogram& other);
+		LatencyHistogram& operator=(const LatencyHistogram& other);
+		~LatencyHistogram() = default;
+
+		void Record(uint64_t value);
+		void Merge(const LatencyHistogram& other);
+
+		uint64_t GetCount() const { return Count.load(std::memory_order_relaxed); }
+		uint64_t GetMax() const { return Max.load(std::memory_order_relaxed); }
+		double GetMean() const;
+		// Highest value equivalent to the bucket holding the given fraction of samples
+		uint64_t GetPercentile(double fraction) const;
+
+	private:
+		static constexpr uint32_t SUB_BUCKET_BITS = 5;
+		static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+		static constexpr uint32_t MAX_EXPONENT = 40;
+		static constexpr size_t BUCKET_COUNT = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+		std::array<std::atomic<uint64_t>, BUCKET_COUNT> Buckets{};
+		std::atomic<uint64_t> Count{0};
+		std::atomic<uint64_t> Sum{0};
+		std::atomic<uint64_t> Max{0};
+
+		static size_t GetBucket(uint64_t value);
+		static uint64_t GetBucketValue(size_t bucket);
+	};
+}
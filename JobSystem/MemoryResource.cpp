@@ -0,0 +1,159 @@
+#include "MemoryResource.h"
+
+#include <malloc.h>
+#include <new>
+
+#include "WindowsMinimal.h"
+
+#include "JSException.h"
+#include "Log.h"
+
+namespace
+{
+	// Chunk granularity when large pages are unavailable, matches the usual large page size
+	constexpr size_t CHUNK_SIZE = 2ull << 20;
+
+	size_t AlignUp(const size_t value, const size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	bool EnableLockMemoryPrivilege()
+	{
+		HANDLE token = nullptr;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			return false;
+
+		TOKEN_PRIVILEGES privileges{};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+		// AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED when the account lacks the privilege
+		const bool enabled = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+			AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+
+		CloseHandle(token);
+		return enabled;
+	}
+}
+
+void* Js::MemoryResource::Allocate(const size_t size, const size_t alignment)
+{
+	void* pointer = DoAllocate(size, alignment);
+	AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	return pointer;
+}
+
+void Js::MemoryResource::Deallocate(void* pointer, const size_t size, const size_t alignment)
+{
+	if (pointer == nullptr)
+		return;
+
+	DoDeallocate(pointer, size, alignment);
+	AllocatedBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* Js::DefaultMemoryResource::DoAllocate(const size_t size, const size_t alignment)
+{
+	void* pointer = _aligned_malloc(size, alignment);
+	if (pointer == nullptr)
+		throw std::bad_alloc();
+
+	return pointer;
+}
+
+void Js::DefaultMemoryResource::DoDeallocate(void* pointer, size_t, size_t)
+{
+	_aligned_free(pointer);
+}
+
+Js::LargePageMemoryResource::LargePageMemoryResource(const bool allowFallback) : AllowFallback(allowFallback)
+{
+	const size_t largePageSize = GetLargePageMinimum();
+	LargePages = largePageSize != 0 && EnableLockMemoryPrivilege();
+	if (!LargePages && !AllowFallback)
+		throw JsException("Large pages are not available");
+
+	PageSize = LargePages ? largePageSize : CHUNK_SIZE;
+	if (!LargePages)
+		Log::Warning("LargePageMemoryResource::LargePageMemoryResource: Large pages are not available, using regular pages\n");
+}
+
+Js::LargePageMemoryResource::~LargePageMemoryResource()
+{
+	for (const Chunk& chunk : Chunks)
+		VirtualFree(chunk.Base, 0, MEM_RELEASE);
+}
+
+size_t Js::LargePageMemoryResource::GetReservedBytes() const
+{
+	return ReservedBytes.load(std::memory_order_relaxed);
+}
+
+Js::LargePageMemoryResource::Chunk Js::LargePageMemoryResource::AllocateChunk(const size_t size)
+{
+	Chunk chunk;
+	chunk.Size = AlignUp(size, PageSize);
+
+	if (LargePages)
+	{
+		chunk.Base = static_cast<char*>(VirtualAlloc(nullptr, chunk.Size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+		                                             PAGE_READWRITE));
+		if (chunk.Base == nullptr)
+		{
+			// Physical memory can be too fragmented for large pages long after the process started
+			if (!AllowFallback)
+				throw JsException("Failed to allocate large pages");
+
+			Log::Warning("LargePageMemoryResource::AllocateChunk: Large page allocation failed, using regular pages\n");
+			LargePages = false;
+		}
+	}
+
+	if (chunk.Base == nullptr)
+		chunk.Base = static_cast<char*>(VirtualAlloc(nullptr, chunk.Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+	if (chunk.Base == nullptr)
+		throw std::bad_alloc();
+
+	ReservedBytes.fetch_add(chunk.Size, std::memory_order_relaxed);
+	return chunk;
+}
+
+void* Js::LargePageMemoryResource::DoAllocate(const size_t size, const size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(ChunkMutex);
+
+	if (!Chunks.empty())
+	{
+		Chunk& current = Chunks.back();
+		const size_t offset = AlignUp(current.Used, alignment);
+		if (offset + size <= current.Size)
+		{
+			current.Used = offset + size;
+			return current.Base + offset;
+		}
+	}
+
+	// Chunks are page aligned, so any alignment up to the page size holds at offset zero
+	Chunk chunk = AllocateChunk(size);
+	chunk.Used = size;
+
+	// Big blocks get a chunk of their own and keep the partially used chunk open for small ones
+	if (!Chunks.empty() && chunk.Size - chunk.Used < Chunks.back().Size - Chunks.back().Used)
+		Chunks.insert(Chunks.end() - 1, chunk);
+	else
+		Chunks.push_back(chunk);
+
+	return chunk.Base;
+}
+
+void Js::LargePageMemoryResource::DoDeallocate(void*, size_t, size_t)
+{
+	// Internal allocations live as long as the JobSystem, chunks are released with the resource
+}
+
+Js::MemoryResource* Js::GetDefaultMemoryResource()
+{
+	static DefaultMemoryResource resource;
+	return &resource;
+}
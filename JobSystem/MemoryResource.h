@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace Js
+{
+	// Source of the JobSystem's internal allocations, fiber stacks are reserved by CreateFiber and are not routed here
+	class MemoryResource
+	{
+	public:
+		MemoryResource() = default;
+		MemoryResource(const MemoryResource&) = delete;
+		virtual ~MemoryResource() = default;
+
+		void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		void Deallocate(void* pointer, size_t size, size_t alignment = alignof(std::max_align_t));
+
+		size_t GetAllocatedBytes() const { return AllocatedBytes.load(std::memory_order_relaxed); }
+		// Bytes taken from the OS, more than the allocated bytes when the resource rounds up to pages
+		virtual size_t GetReservedBytes() const { return GetAllocatedBytes(); }
+		virtual const char* GetName() const = 0;
+
+	protected:
+		virtual void* DoAllocate(size_t size, size_t alignment) = 0;
+		virtual void DoDeallocate(void* pointer, size_t size, size_t alignment) = 0;
+
+	private:
+		std::atomic<size_t> AllocatedBytes{0};
+	};
+
+	class DefaultMemoryResource final : public MemoryResource
+	{
+	public:
+		const char* GetName() const override { return "default"; }
+
+	protected:
+		void* DoAllocate(size_t size, size_t alignment) override;
+		void DoDeallocate(void* pointer, size_t size, size_t alignment) override;
+	};
+
+	// Carves allocations out of 2 MB large pages, memory goes back to the OS only when the resource is destroyed.
+	// Large pages need the "Lock pages in memory" privilege, without it the resource falls back to regular pages
+	// (still allocated in large chunks) unless fallback is disabled, in which case construction throws
+	class LargePageMemoryResource final : public MemoryResource
+	{
+	public:
+		explicit LargePageMemoryResource(bool allowFallback = true);
+		~LargePageMemoryResource() override;
+
+		bool UsesLargePages() const { return LargePages; }
+		size_t GetReservedBytes() const override;
+		const char* GetName() const override { return LargePages ? "large-pages" : "large-pages (fallback)"; }
+
+	protected:
+		void* DoAllocate(size_t size, size_t alignment) override;
+		void DoDeallocate(void* pointer, size_t size, size_t alignment) override;
+
+	private:
+		struct Chunk
+		{
+			char* Base = nullptr;
+			size_t Size = 0;
+			size_t Used = 0;
+		};
+
+		std::mutex ChunkMutex;
+		std::vector<Chunk> Chunks;
+		size_t PageSize = 0;
+		std::atomic<size_t> ReservedBytes{0};
+		std::atomic_bool LargePages{false};
+		bool AllowFallback;
+
+		Chunk AllocateChunk(size_t size);
+	};
+
+	MemoryResource* GetDefaultMemoryResource();
+
+	// Standard allocator over a MemoryResource for the JobSystem's internal containers
+	template <typename T>
+	class ResourceAllocator
+	{
+	public:
+		using value_type = T;
+		using propagate_on_container_copy_assignment = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		ResourceAllocator() : Resource(GetDefaultMemoryResource()) {}
+		explicit ResourceAllocator(MemoryResource* resource) : Resource(resource) {}
+		template <typename U>
+		ResourceAllocator(const ResourceAllocator<U>& other) : Resource(other.GetResource()) {}
+
+		T* allocate(const size_t count) { return static_cast<T*>(Resource->Allocate(count * sizeof(T), alignof(T))); }
+		void deallocate(T* pointer, const size_t count) { Resource->Deallocate(pointer, count * sizeof(T), alignof(T)); }
+
+		MemoryResource* GetResource() const { return Resource; }
+
+	private:
+		MemoryResource* Resource;
+	};
+
+	template <typename T, typename U>
+	bool operator ==(const ResourceAllocator<T>& a, const ResourceAllocator<U>& b)
+	{
+		return a.GetResource() == b.GetResource();
+	}
+
+	template <typename T, typename U>
+	bool operator !=(const ResourceAllocator<T>& a, const ResourceAllocator<U>& b)
+	{
+		return !(a == b);
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Semaphore.h"
+
+namespace Js
+{
+	class JobSystem;
+
+	class Mutex
+	{
+	public:
+		explicit Mutex(JobSystem& system) : Permit(system, 1) {}
+		Mutex(const Mutex&) = delete;
+		~Mutex() = default;
+
+		void Lock() { Permit.Acquire(); }
+		bool TryLock() { return Permit.TryAcquire(); }
+		void Unlock() { Permit.Release(); }
+
+	private:
+		Semaphore Permit;
+	};
+
+	class MutexLock
+	{
+	public:
+		explicit MutexLock(Mutex& mutex) : Owned(mutex) { Owned.Lock(); }
+		MutexLock(const MutexLock&) = delete;
+		~MutexLock() { Owned.Unlock(); }
+
+	private:
+		Mutex& Owned;
+	};
+}
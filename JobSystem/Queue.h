@@ -1,16 +1,120 @@
 #pragma once
 #include <cassert>
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "MemoryResource.h"
 
 namespace Js
 {
-	template <typename T>
+	namespace QueuePolicy
+	{
+		// Producer and consumer policies, single variants claim slots with plain stores instead of CAS
+		struct SingleProducer {};
+		struct MultiProducer {};
+		struct SingleConsumer {};
+		struct MultiConsumer {};
+
+		// Sequence number stored next to the payload, cells aligned (and so padded) to Alignment when non-zero
+		template <size_t Alignment = 0>
+		struct Interleaved {};
+
+		// Sequence numbers and payloads in separate arrays so producers and consumers touch fewer shared lines
+		struct Split {};
+	}
+
+	namespace Detail
+	{
+		constexpr size_t MaxSize(const size_t a, const size_t b) { return a > b ? a : b; }
+
+		template <typename T, typename Layout>
+		class QueueStorage;
+
+		template <typename T, size_t Alignment>
+		class QueueStorage<T, QueuePolicy::Interleaved<Alignment>>
+		{
+		public:
+			QueueStorage(const size_t size, MemoryResource* resource) : Size(size), Resource(resource)
+			{
+				Cells = static_cast<Cell*>(Resource->Allocate(sizeof(Cell) * size, alignof(Cell)));
+				for (size_t i = 0; i != size; ++i)
+					new(&Cells[i]) Cell();
+			}
+
+			~QueueStorage()
+			{
+				for (size_t i = 0; i != Size; ++i)
+					Cells[i].~Cell();
+				Resource->Deallocate(Cells, sizeof(Cell) * Size, alignof(Cell));
+			}
+
+			std::atomic<size_t>& Sequence(const size_t index) { return Cells[index].Sequence; }
+			const std::atomic<size_t>& Sequence(const size_t index) const { return Cells[index].Sequence; }
+			T& Data(const size_t index) { return Cells[index].Data; }
+
+			size_t GetMemorySize() const { return sizeof(Cell) * Size; }
+
+		private:
+			struct alignas(MaxSize(Alignment, MaxSize(alignof(std::atomic<size_t>), alignof(T)))) Cell
+			{
+				std::atomic<size_t> Sequence;
+				T Data;
+			};
+
+			Cell* Cells;
+			size_t Size;
+			MemoryResource* Resource;
+		};
+
+		template <typename T>
+		class QueueStorage<T, QueuePolicy::Split>
+		{
+		public:
+			QueueStorage(const size_t size, MemoryResource* resource) : Size(size), Resource(resource)
+			{
+				Sequences = static_cast<std::atomic<size_t>*>(
+					Resource->Allocate(sizeof(std::atomic<size_t>) * size, alignof(std::atomic<size_t>)));
+				Payloads = static_cast<T*>(Resource->Allocate(sizeof(T) * size, alignof(T)));
+				for (size_t i = 0; i != size; ++i)
+				{
+					new(&Sequences[i]) std::atomic<size_t>();
+					new(&Payloads[i]) T();
+				}
+			}
+
+			~QueueStorage()
+			{
+				for (size_t i = 0; i != Size; ++i)
+					Payloads[i].~T();
+				Resource->Deallocate(Sequences, sizeof(std::atomic<size_t>) * Size, alignof(std::atomic<size_t>));
+				Resource->Deallocate(Payloads, sizeof(T) * Size, alignof(T));
+			}
+
+			std::atomic<size_t>& Sequence(const size_t index) { return Sequences[index]; }
+			const std::atomic<size_t>& Sequence(const size_t index) const { return Sequences[index]; }
+			T& Data(const size_t index) { return Payloads[index]; }
+
+			size_t GetMemorySize() const { return (sizeof(std::atomic<size_t>) + sizeof(T)) * Size; }
+
+		private:
+			std::atomic<size_t>* Sequences;
+			T* Payloads;
+			size_t Size;
+			MemoryResource* Resource;
+		};
+	}
+
+	template <typename T, typename Producer = QueuePolicy::MultiProducer,
+	          typename Consumer = QueuePolicy::MultiConsumer, typename Layout = QueuePolicy::Interleaved<>>
 	class Queue
 	{
 	public:
-		explicit Queue(const size_t bufferSize);
+		// A null resource uses the default one
+		explicit Queue(const size_t bufferSize, MemoryResource* resource = nullptr);
 
-		~Queue();
+		~Queue() = default;
 
 		Queue(Queue const&) = delete;
 		void operator =(Queue const&) = delete;
@@ -19,94 +123,151 @@ namespace Js
 
 		bool Dequeue(T& data);
 
-	private:
-		struct Cell
-		{
-			std::atomic<size_t> Sequence;
-			T Data;
-		};
+		// Snapshots for callers that park on an empty or full queue, stale as soon as they return
+		bool IsEmpty() const;
+		bool IsFull() const;
+
+		size_t GetMemorySize() const { return Buffer.GetMemorySize(); }
 
+	private:
 		static constexpr size_t CACHELINE_SIZE = 64;
 		typedef char CachelinePad[CACHELINE_SIZE];
 
 		CachelinePad Pad0;
-		Cell* Buffer;
+		Detail::QueueStorage<T, Layout> Buffer;
 		size_t BufferMask;
 		CachelinePad Pad1;
 		std::atomic<size_t> EnqueuePos;
 		CachelinePad Pad2;
 		std::atomic<size_t> DequeuePos;
 		CachelinePad Pad3;
+
+		bool ClaimEnqueue(size_t& pos, QueuePolicy::MultiProducer);
+		bool ClaimEnqueue(size_t& pos, QueuePolicy::SingleProducer);
+		bool ClaimDequeue(size_t& pos, QueuePolicy::MultiConsumer);
+		bool ClaimDequeue(size_t& pos, QueuePolicy::SingleConsumer);
 	};
 
-	template <typename T>
-	Queue<T>::Queue(const size_t bufferSize) : Pad0{}, Buffer(new Cell[bufferSize])
-	                                           , BufferMask(bufferSize - 1), Pad1{}, Pad2{}, Pad3{}
+	template <typename T, typename Producer, typename Consumer, typename Layout>
+	Queue<T, Producer, Consumer, Layout>::Queue(const size_t bufferSize, MemoryResource* resource) :
+		Pad0{}, Buffer(bufferSize, resource != nullptr ? resource : GetDefaultMemoryResource()),
+		BufferMask(bufferSize - 1), Pad1{}, Pad2{}, Pad3{}
 	{
 		assert((bufferSize >= 2) && ((bufferSize & (bufferSize - 1)) == 0));
 		for (size_t i = 0; i != bufferSize; i += 1)
-			Buffer[i].Sequence.store(i, std::memory_order_relaxed);
+			Buffer.Sequence(i).store(i, std::memory_order_relaxed);
 		EnqueuePos.store(0, std::memory_order_relaxed);
 		DequeuePos.store(0, std::memory_order_relaxed);
 	}
 
-	template <typename T>
-	Queue<T>::~Queue()
+	template <typename T, typename Producer, typename Consumer, typename Layout>
+	bool Queue<T, Producer, Consumer, Layout>::Enqueue(T const& data)
 	{
-		delete[] Buffer;
+		size_t pos;
+		if (!ClaimEnqueue(pos, Producer()))
+			return false;
+
+		const size_t index = pos & BufferMask;
+		Buffer.Data(index) = data;
+		Buffer.Sequence(index).store(pos + 1, std::memory_order_release);
+
+		return true;
 	}
 
-	template <typename T>
-	bool Queue<T>::Enqueue(T const& data)
+	template <typename T, typename Producer, typename Consumer, typename Layout>
+	bool Queue<T, Producer, Consumer, Layout>::Dequeue(T& data)
+	{
+		size_t pos;
+		if (!ClaimDequeue(pos, Consumer()))
+			return false;
+
+		const size_t index = pos & BufferMask;
+		data = Buffer.Data(index);
+		Buffer.Sequence(index).store(pos + BufferMask + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	template <typename T, typename Producer, typename Consumer, typename Layout>
+	bool Queue<T, Producer, Consumer, Layout>::IsEmpty() const
+	{
+		const size_t pos = DequeuePos.load(std::memory_order_relaxed);
+		return Buffer.Sequence(pos & BufferMask).load(std::memory_order_acquire) != pos + 1;
+	}
+
+	template <typename T, typename Producer, typename Consumer, typename Layout>
+	bool Queue<T, Producer, Consumer, Layout>::IsFull() const
 	{
-		Cell* cell;
-		size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+		const size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+		return Buffer.Sequence(pos & BufferMask).load(std::memory_order_acquire) != pos;
+	}
+
+	template <typename T, typename Producer, typename Consumer, typename Layout>
+	bool Queue<T, Producer, Consumer, Layout>::ClaimEnqueue(size_t& pos, QueuePolicy::MultiProducer)
+	{
+		pos = EnqueuePos.load(std::memory_order_relaxed);
 		for (;;)
 		{
-			cell = &Buffer[pos & BufferMask];
-			const size_t seq = cell->Sequence.load(std::memory_order_acquire);
+			const size_t seq = Buffer.Sequence(pos & BufferMask).load(std::memory_order_acquire);
 			const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
 			if (dif == 0)
 			{
 				if (EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
-					break;
+					return true;
 			}
 			else if (dif < 0)
 				return false;
 			else
 				pos = EnqueuePos.load(std::memory_order_relaxed);
 		}
+	}
 
-		cell->Data = data;
-		cell->Sequence.store(pos + 1, std::memory_order_release);
+	template <typename T, typename Producer, typename Consumer, typename Layout>
+	bool Queue<T, Producer, Consumer, Layout>::ClaimEnqueue(size_t& pos, QueuePolicy::SingleProducer)
+	{
+		pos = EnqueuePos.load(std::memory_order_relaxed);
+		if (Buffer.Sequence(pos & BufferMask).load(std::memory_order_acquire) != pos)
+			return false;
 
+		EnqueuePos.store(pos + 1, std::memory_order_relaxed);
 		return true;
 	}
 
-	template <typename T>
-	bool Queue<T>::Dequeue(T& data)
+	template <typename T, typename Producer, typename Consumer, typename Layout>
+	bool Queue<T, Producer, Consumer, Layout>::ClaimDequeue(size_t& pos, QueuePolicy::MultiConsumer)
 	{
-		Cell* cell;
-		size_t pos = DequeuePos.load(std::memory_order_relaxed);
+		pos = DequeuePos.load(std::memory_order_relaxed);
 		for (;;)
 		{
-			cell = &Buffer[pos & BufferMask];
-			const size_t seq = cell->Sequence.load(std::memory_order_acquire);
+			const size_t seq = Buffer.Sequence(pos & BufferMask).load(std::memory_order_acquire);
 			const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
 			if (dif == 0)
 			{
 				if (DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
-					break;
+					return true;
 			}
 			else if (dif < 0)
 				return false;
 			else
 				pos = DequeuePos.load(std::memory_order_relaxed);
 		}
+	}
 
-		data = cell->Data;
-		cell->Sequence.store(pos + BufferMask + 1, std::memory_order_release);
+	template <typename T, typename Producer, typename Consumer, typename Layout>
+	bool Queue<T, Producer, Consumer, Layout>::ClaimDequeue(size_t& pos, QueuePolicy::SingleConsumer)
+	{
+		pos = DequeuePos.load(std::memory_order_relaxed);
+		if (Buffer.Sequence(pos & BufferMask).load(std::memory_order_acquire) != pos + 1)
+			return false;
 
+		DequeuePos.store(pos + 1, std::memory_order_relaxed);
 		return true;
 	}
+
+	template <typename T>
+	using SpscQueue = Queue<T, QueuePolicy::SingleProducer, QueuePolicy::SingleConsumer>;
+	template <typename T>
+	using MpscQueue = Queue<T, QueuePolicy::MultiProducer, QueuePolicy::SingleConsumer>;
+	template <typename T>
+	using MpmcQueue = Queue<T, QueuePolicy::MultiProducer, QueuePolicy::MultiConsumer>;
 }
@@ -0,0 +1,144 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "Queue.h"
+
+namespace
+{
+	constexpr size_t QUEUE_SIZE = 1024;
+
+	template <size_t Size>
+	struct Payload
+	{
+		uint64_t Value = 0;
+		char Pad[Size - sizeof(uint64_t)] = {};
+	};
+
+	template <>
+	struct Payload<sizeof(uint64_t)>
+	{
+		uint64_t Value = 0;
+	};
+
+	template <typename TQueue, typename TPayload>
+	double Measure(const size_t producers, const size_t consumers, const size_t itemsPerProducer)
+	{
+		TQueue queue(QUEUE_SIZE);
+		std::atomic_bool start{false};
+		std::atomic_bool producersDone{false};
+		std::atomic<uint64_t> checksum{0};
+
+		std::vector<std::thread> producerThreads;
+		std::vector<std::thread> consumerThreads;
+		for (size_t p = 0; p < producers; ++p)
+		{
+			producerThreads.emplace_back([&]
+			{
+				while (!start.load(std::memory_order_acquire))
+					std::this_thread::yield();
+
+				TPayload payload;
+				for (size_t i = 0; i < itemsPerProducer; ++i)
+				{
+					payload.Value = i;
+					while (!queue.Enqueue(payload))
+						std::this_thread::yield();
+				}
+			});
+		}
+
+		for (size_t c = 0; c < consumers; ++c)
+		{
+			consumerThreads.emplace_back([&]
+			{
+				while (!start.load(std::memory_order_acquire))
+					std::this_thread::yield();
+
+				TPayload payload;
+				uint64_t sum = 0;
+				for (;;)
+				{
+					if (queue.Dequeue(payload))
+					{
+						sum += payload.Value;
+						continue;
+					}
+
+					// Every producer has published all items once the flag is set, so a failed dequeue means empty
+					if (producersDone.load(std::memory_order_acquire) && !queue.Dequeue(payload))
+						break;
+
+					std::this_thread::yield();
+				}
+				checksum.fetch_add(sum, std::memory_order_relaxed);
+			});
+		}
+
+		const auto begin = std::chrono::steady_clock::now();
+		start.store(true, std::memory_order_release);
+		for (auto& thread : producerThreads)
+			thread.join();
+		producersDone.store(true, std::memory_order_release);
+		for (auto& thread : consumerThreads)
+			thread.join();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+		const uint64_t expected = producers * (static_cast<uint64_t>(itemsPerProducer) * (itemsPerProducer - 1) / 2);
+		if (checksum.load() != expected)
+			std::cerr << "Queue benchmark lost items" << std::endl;
+
+		return static_cast<double>(producers * itemsPerProducer) / elapsed.count() / 1e6;
+	}
+
+	template <typename Producer, typename Consumer, typename Layout, typename TPayload>
+	void Report(const char* policy, const char* layout, const size_t producers, const size_t consumers,
+	            const size_t itemsPerProducer)
+	{
+		using TQueue = Js::Queue<TPayload, Producer, Consumer, Layout>;
+		const double mops = Measure<TQueue, TPayload>(producers, consumers, itemsPerProducer);
+		std::cout << policy << "," << layout << "," << sizeof(TPayload) << "," << producers << "," << consumers << ","
+			<< mops << std::endl;
+	}
+
+	template <typename Layout, typename TPayload>
+	void RunLayout(const char* layout, const size_t maxThreads, const size_t itemsPerProducer)
+	{
+		using namespace Js::QueuePolicy;
+
+		Report<SingleProducer, SingleConsumer, Layout, TPayload>("spsc", layout, 1, 1, itemsPerProducer);
+		for (size_t producers = 1; producers <= maxThreads; producers *= 2)
+			Report<MultiProducer, SingleConsumer, Layout, TPayload>("mpsc", layout, producers, 1, itemsPerProducer);
+		for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+			Report<MultiProducer, MultiConsumer, Layout, TPayload>("mpmc", layout, threads, threads, itemsPerProducer);
+	}
+
+	template <typename TPayload>
+	void RunElementSize(const size_t maxThreads, const size_t itemsPerProducer)
+	{
+		using namespace Js::QueuePolicy;
+
+		RunLayout<Interleaved<>, TPayload>("interleaved", maxThreads, itemsPerProducer);
+		RunLayout<Interleaved<64>, TPayload>("interleaved64", maxThreads, itemsPerProducer);
+		RunLayout<Split, TPayload>("split", maxThreads, itemsPerProducer);
+	}
+}
+
+// Usage: queue-bench [items per producer]
+int RunQueueBenchmark(const int argc, char** argv)
+{
+	const size_t itemsPerProducer = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+	const size_t maxThreads = std::max<size_t>(1, std::thread::hardware_concurrency() / 2);
+
+	std::cout << "policy,layout,element_bytes,producers,consumers,mops" << std::endl;
+	RunElementSize<Payload<8>>(maxThreads, itemsPerProducer);
+	RunElementSize<Payload<64>>(maxThreads, itemsPerProducer);
+	RunElementSize<Payload<256>>(maxThreads, itemsPerProducer);
+	return 0;
+}
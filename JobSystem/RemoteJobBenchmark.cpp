@@ -0,0 +1,189 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Counter.h"
+#include "JobSystem.h"
+#include "RemoteJobs.h"
+#include "WindowsMinimal.h"
+
+namespace
+{
+	constexpr uint32_t SORT_JOB = 0;
+	constexpr size_t SORT_CHUNK_VALUES = 1u << 16;
+	constexpr uint32_t NODE_TIMEOUT_MS = 10000;
+
+	// Jobs this node ran, a node started with a crash count terminates itself in the middle of that job
+	std::atomic<uint64_t> JobsRun{0};
+	uint64_t CrashAfter = UINT64_MAX;
+
+	// Sorts one chunk of the coordinator's values, the coordinator merges the sorted chunks
+	void SortJob(Js::JobSystem&, const std::vector<char>& payload, std::vector<char>& result)
+	{
+		if (JobsRun.fetch_add(1, std::memory_order_relaxed) == CrashAfter)
+			TerminateProcess(GetCurrentProcess(), 3);
+
+		std::vector<uint32_t> values(payload.size() / sizeof(uint32_t));
+		std::memcpy(values.data(), payload.data(), values.size() * sizeof(uint32_t));
+		std::sort(values.begin(), values.end());
+
+		result.resize(values.size() * sizeof(uint32_t));
+		std::memcpy(result.data(), values.data(), result.size());
+	}
+
+	bool StartNode(const uint16_t port, const bool crash, PROCESS_INFORMATION& process)
+	{
+		char path[MAX_PATH];
+		GetModuleFileNameA(nullptr, path, MAX_PATH);
+
+		std::string commandLine = std::string("\"") + path + "\" remote-bench node 127.0.0.1 " + std::to_string(port);
+		if (crash)
+			commandLine += " 3";
+
+		STARTUPINFOA startup = {};
+		startup.cb = sizeof(startup);
+		return CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup,
+		                      &process) != 0;
+	}
+
+	int RunNode(Js::JobSystem& jobSystem, const int argc, char** argv)
+	{
+		if (argc <= 4)
+			return 1;
+		if (argc > 5)
+			CrashAfter = std::strtoull(argv[5], nullptr, 10);
+
+		Js::RemoteWorker worker(jobSystem);
+		worker.Register(SORT_JOB, SortJob);
+		const bool finished = worker.Run(argv[3], static_cast<uint16_t>(std::strtoul(argv[4], nullptr, 10)));
+
+		std::cout << "Node ran " << worker.GetExecutedCount() << " jobs" << std::endl;
+		return finished ? 0 : 1;
+	}
+}
+
+// Usage: remote-bench [nodes] [values in millions] [crash]
+//        remote-bench node <address> <port> [crash after jobs]
+// Sorts random values in chunks on that many node processes over loopback and merges them here, with crash the
+// first node terminates itself in the middle of a job and its jobs are sent to the others
+int RunRemoteJobBenchmark(Js::JobSystem& jobSystem, const int argc, char** argv)
+{
+	if (argc > 2 && std::strcmp(argv[2], "node") == 0)
+		return RunNode(jobSystem, argc, argv);
+
+	const size_t nodeCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 3;
+	const size_t valueCount = (argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 16) << 20;
+	const bool crash = argc > 4 && std::strcmp(argv[4], "crash") == 0;
+
+	Js::RemoteCoordinatorOptions options;
+	options.NodeTimeoutMs = NODE_TIMEOUT_MS;
+	Js::RemoteCoordinator coordinator(jobSystem, options);
+	const uint16_t port = coordinator.Listen();
+
+	std::vector<PROCESS_INFORMATION> nodes;
+	for (size_t i = 0; i < nodeCount; ++i)
+	{
+		PROCESS_INFORMATION process = {};
+		if (!StartNode(port, crash && i == 0, process))
+		{
+			std::cerr << "Failed to start node process: " << GetLastError() << std::endl;
+			break;
+		}
+		CloseHandle(process.hThread);
+		nodes.push_back(process);
+	}
+	if (!coordinator.WaitForNodes(nodes.size(), NODE_TIMEOUT_MS))
+		std::cerr << "Not every node connected, going on with " << coordinator.GetStats().NodeCount << std::endl;
+
+	std::mt19937 random(42);
+	std::vector<Js::RemoteJob> jobs((valueCount + SORT_CHUNK_VALUES - 1) / SORT_CHUNK_VALUES);
+	uint64_t inputSum = 0;
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		const size_t count = std::min(SORT_CHUNK_VALUES, valueCount - i * SORT_CHUNK_VALUES);
+		std::vector<uint32_t> values(count);
+		for (uint32_t& value : values)
+		{
+			value = random();
+			inputSum += value;
+		}
+
+		jobs[i].TypeId = SORT_JOB;
+		jobs[i].Payload.resize(count * sizeof(uint32_t));
+		std::memcpy(jobs[i].Payload.data(), values.data(), jobs[i].Payload.size());
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	Js::Counter counter;
+	coordinator.AddJobs(jobs, &counter);
+	jobSystem.Wait(counter, 0);
+	const std::chrono::duration<double> remoteElapsed = std::chrono::steady_clock::now() - start;
+
+	// Merges all sorted chunks in one pass, a heap keeps the chunks ordered by their next value
+	struct Cursor
+	{
+		const uint32_t* Next;
+		const uint32_t* End;
+	};
+	std::vector<Cursor> cursors;
+	size_t failed = 0;
+	for (const Js::RemoteJob& job : jobs)
+	{
+		if (job.Failed)
+		{
+			++failed;
+			continue;
+		}
+
+		const auto* values = reinterpret_cast<const uint32_t*>(job.Result.data());
+		if (!job.Result.empty())
+			cursors.push_back({values, values + job.Result.size() / sizeof(uint32_t)});
+	}
+
+	const auto later = [](const Cursor& left, const Cursor& right) { return *left.Next > *right.Next; };
+	std::make_heap(cursors.begin(), cursors.end(), later);
+	std::vector<uint32_t> sorted;
+	sorted.reserve(valueCount);
+	while (!cursors.empty())
+	{
+		std::pop_heap(cursors.begin(), cursors.end(), later);
+		Cursor& cursor = cursors.back();
+		sorted.push_back(*cursor.Next++);
+		if (cursor.Next == cursor.End)
+			cursors.pop_back();
+		else
+			std::push_heap(cursors.begin(), cursors.end(), later);
+	}
+	const std::chrono::duration<double> totalElapsed = std::chrono::steady_clock::now() - start;
+
+	uint64_t outputSum = 0;
+	for (const uint32_t value : sorted)
+		outputSum += value;
+	const bool correct = failed == 0 && sorted.size() == valueCount && outputSum == inputSum &&
+		std::is_sorted(sorted.begin(), sorted.end());
+
+	const Js::RemoteStats stats = coordinator.GetStats();
+	std::cout << "Sorted " << valueCount << " values in " << jobs.size() << " jobs on " << nodes.size()
+		<< " nodes: remote " << remoteElapsed.count() << " s, with merge " << totalElapsed.count() << " s, "
+		<< (correct ? "correct" : "WRONG") << std::endl;
+	std::cout << "Jobs sent " << stats.JobsSent << ", completed " << stats.JobsCompleted << ", reassigned "
+		<< stats.JobsReassigned << std::endl;
+	std::cout << "Batches sent " << stats.BatchesSent << ", received " << stats.BatchesReceived << ", "
+		<< (stats.BytesSent >> 20) << " MB out, " << (stats.BytesReceived >> 20) << " MB in" << std::endl;
+
+	coordinator.Shutdown();
+	for (const PROCESS_INFORMATION& node : nodes)
+	{
+		WaitForSingleObject(node.hProcess, INFINITE);
+		CloseHandle(node.hProcess);
+	}
+	return correct ? 0 : 1;
+}
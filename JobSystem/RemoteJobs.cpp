@@ -0,0 +1,915 @@
+#include "RemoteJobs.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+#include "WindowsMinimal.h"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "Counter.h"
+#include "Job.h"
+#include "JobSystem.h"
+#include "JSException.h"
+#include "Log.h"
+
+namespace
+{
+	// Every message is a header followed by Size bytes of body, integers are sent little endian as they are
+	enum class FrameType : uint8_t
+	{
+		// Node to coordinator: uint32 credits, uint32 process id
+		Hello,
+		// Coordinator to node: uint32 count, then per job uint64 id, uint32 type, uint32 size and the payload
+		Jobs,
+		// Node to coordinator: uint32 count, then per job uint64 id, uint8 failed, uint32 size and the result
+		Results,
+		Heartbeat,
+		Shutdown
+	};
+
+	struct FrameHeader
+	{
+		uint32_t Size;
+		uint8_t Type;
+		uint8_t Padding[3];
+	};
+
+	constexpr uint32_t MAX_FRAME_SIZE = 256u << 20;
+	// A payload or result still fits a frame of its own
+	constexpr size_t MAX_PAYLOAD_SIZE = MAX_FRAME_SIZE - 64;
+	constexpr size_t RECEIVE_CHUNK_SIZE = 64u << 10;
+
+	// WSAStartup and WSACleanup are reference counted, every coordinator and worker holds one reference
+	void StartWinsock()
+	{
+		WSADATA data;
+		if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+			throw Js::JsException("Failed to initialize Winsock");
+	}
+
+	template <typename T>
+	void Put(std::vector<char>& buffer, const T value)
+	{
+		const size_t offset = buffer.size();
+		buffer.resize(offset + sizeof(T));
+		std::memcpy(&buffer[offset], &value, sizeof(T));
+	}
+
+	void PutBytes(std::vector<char>& buffer, const std::vector<char>& bytes)
+	{
+		buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+	}
+
+	// Appends a header whose size EndFrame fills in, returns where the frame starts
+	size_t BeginFrame(std::vector<char>& buffer, const FrameType type)
+	{
+		const size_t start = buffer.size();
+		FrameHeader header = {};
+		header.Type = static_cast<uint8_t>(type);
+		Put(buffer, header);
+		return start;
+	}
+
+	void EndFrame(std::vector<char>& buffer, const size_t start)
+	{
+		const auto size = static_cast<uint32_t>(buffer.size() - start - sizeof(FrameHeader));
+		std::memcpy(&buffer[start], &size, sizeof(size));
+	}
+
+	// Bounds checked reads from a frame body, a frame that ends early fails the read
+	class FrameReader
+	{
+	public:
+		FrameReader(const char* body, const uint32_t size) : Position(body), End(body + size) {}
+
+		template <typename T>
+		bool Read(T& value)
+		{
+			if (static_cast<size_t>(End - Position) < sizeof(T))
+				return false;
+			std::memcpy(&value, Position, sizeof(T));
+			Position += sizeof(T);
+			return true;
+		}
+
+		bool ReadBytes(std::vector<char>& bytes, const uint32_t size)
+		{
+			if (static_cast<size_t>(End - Position) < size)
+				return false;
+			bytes.assign(Position, Position + size);
+			Position += size;
+			return true;
+		}
+
+	private:
+		const char* Position;
+		const char* End;
+	};
+
+	// A non-blocking socket signalling its event on reads, writes and close, with the bytes that did not fit
+	// in the socket yet and the frames received so far
+	struct Connection
+	{
+		SOCKET Socket = INVALID_SOCKET;
+		WSAEVENT Event = WSA_INVALID_EVENT;
+
+		std::vector<char> Inbox;
+		size_t InboxRead = 0;
+		std::vector<char> Outbox;
+		size_t OutboxSent = 0;
+
+		Connection() = default;
+		Connection(const Connection&) = delete;
+		~Connection() { Close(); }
+
+		bool Open(const SOCKET socket)
+		{
+			Socket = socket;
+			Event = WSACreateEvent();
+			if (Event == WSA_INVALID_EVENT)
+				return false;
+
+			// Frames are batched already, waiting for more only delays them
+			const BOOL noDelay = TRUE;
+			setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+			return WSAEventSelect(Socket, Event, FD_READ | FD_WRITE | FD_CLOSE) == 0;
+		}
+
+		void Close()
+		{
+			if (Socket != INVALID_SOCKET)
+				closesocket(Socket);
+			if (Event != WSA_INVALID_EVENT)
+				WSACloseEvent(Event);
+			Socket = INVALID_SOCKET;
+			Event = WSA_INVALID_EVENT;
+		}
+
+		// Every read and write is retried on each wakeup anyway, the events only need resetting
+		void ResetEvent()
+		{
+			WSANETWORKEVENTS events;
+			WSAEnumNetworkEvents(Socket, Event, &events);
+		}
+
+		// Sends as much of the outbox as the socket takes, returns the bytes sent or -1 once the connection broke
+		int64_t Flush()
+		{
+			int64_t sent = 0;
+			while (OutboxSent < Outbox.size())
+			{
+				const int size = static_cast<int>(std::min<size_t>(Outbox.size() - OutboxSent, INT32_MAX));
+				const int result = send(Socket, &Outbox[OutboxSent], size, 0);
+				if (result == SOCKET_ERROR)
+					return WSAGetLastError() == WSAEWOULDBLOCK ? sent : -1;
+
+				OutboxSent += result;
+				sent += result;
+			}
+
+			Outbox.clear();
+			OutboxSent = 0;
+			return sent;
+		}
+
+		// Reads whatever arrived, returns the bytes read or -1 once the connection closed or broke. Frames read
+		// before the connection closed stay in the inbox
+		int64_t Receive()
+		{
+			if (InboxRead != 0)
+			{
+				Inbox.erase(Inbox.begin(), Inbox.begin() + InboxRead);
+				InboxRead = 0;
+			}
+
+			int64_t received = 0;
+			for (;;)
+			{
+				const size_t used = Inbox.size();
+				Inbox.resize(used + RECEIVE_CHUNK_SIZE);
+				const int result = recv(Socket, &Inbox[used], static_cast<int>(RECEIVE_CHUNK_SIZE), 0);
+				Inbox.resize(used + (result > 0 ? result : 0));
+
+				if (result == 0)
+					return -1;
+				if (result == SOCKET_ERROR)
+					return WSAGetLastError() == WSAEWOULDBLOCK ? received : -1;
+				received += result;
+			}
+		}
+
+		// Next whole frame of the inbox, valid until the next Receive. Fails the connection on an oversized frame
+		bool NextFrame(FrameType& type, const char*& body, uint32_t& size, bool& broken)
+		{
+			broken = false;
+			if (Inbox.size() - InboxRead < sizeof(FrameHeader))
+				return false;
+
+			FrameHeader header;
+			std::memcpy(&header, &Inbox[InboxRead], sizeof(header));
+			if (header.Size > MAX_FRAME_SIZE)
+			{
+				broken = true;
+				return false;
+			}
+			if (Inbox.size() - InboxRead - sizeof(FrameHeader) < header.Size)
+				return false;
+
+			type = static_cast<FrameType>(header.Type);
+			body = Inbox.data() + InboxRead + sizeof(FrameHeader);
+			size = header.Size;
+			InboxRead += sizeof(FrameHeader) + header.Size;
+			return true;
+		}
+	};
+}
+
+struct Js::RemoteCoordinator::Node
+{
+	Connection Link;
+	uint32_t ProcessId = 0;
+	// Jobs are only sent once the node said hello
+	bool Ready = false;
+	uint32_t Credits = 0;
+	std::unordered_set<uint64_t> InFlight;
+	uint64_t LastReceive = 0;
+};
+
+struct Js::RemoteWorker::WorkItem
+{
+	RemoteWorker* Worker = nullptr;
+	uint64_t Id = 0;
+	uint32_t TypeId = 0;
+	std::vector<char> Payload;
+	std::vector<char> Result;
+	bool Failed = false;
+};
+
+struct Js::RemoteWorker::Session
+{
+	RemoteWorker* Worker = nullptr;
+	Connection Link;
+	// Released by the serving thread once the connection is done with
+	Counter Done;
+	bool Served = false;
+};
+
+Js::RemoteCoordinator::RemoteCoordinator(JobSystem& system, const RemoteCoordinatorOptions& options) :
+	System(&system),
+	Options(options),
+	ListenSocket(INVALID_SOCKET)
+{
+	if (Options.MaxBatchJobs == 0)
+		throw JsException("Remote batches must hold at least one job");
+
+	StartWinsock();
+}
+
+Js::RemoteCoordinator::~RemoteCoordinator()
+{
+	Shutdown();
+	WSACleanup();
+}
+
+uint16_t Js::RemoteCoordinator::Listen(const char* address, const uint16_t port)
+{
+	if (Started)
+		throw JsException("Coordinator is already listening");
+
+	sockaddr_in endpoint = {};
+	endpoint.sin_family = AF_INET;
+	endpoint.sin_port = htons(port);
+	if (inet_pton(AF_INET, address, &endpoint.sin_addr) != 1)
+		throw JsException("Invalid coordinator address");
+
+	const SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listenSocket == INVALID_SOCKET)
+		throw JsException("Failed to create coordinator socket");
+	ListenSocket = listenSocket;
+
+	int length = sizeof(endpoint);
+	if (bind(listenSocket, reinterpret_cast<const sockaddr*>(&endpoint), sizeof(endpoint)) != 0 ||
+		listen(listenSocket, SOMAXCONN) != 0 ||
+		getsockname(listenSocket, reinterpret_cast<sockaddr*>(&endpoint), &length) != 0)
+		throw JsException("Failed to listen for worker nodes");
+
+	ListenEvent = WSACreateEvent();
+	WakeEvent = WSACreateEvent();
+	if (ListenEvent == WSA_INVALID_EVENT || WakeEvent == WSA_INVALID_EVENT ||
+		WSAEventSelect(listenSocket, ListenEvent, FD_ACCEPT) != 0)
+		throw JsException("Failed to create coordinator events");
+
+	if (!NetworkThread.Create(NetworkMain, this))
+		throw JsException("Failed to start coordinator thread");
+	Started = true;
+
+	const uint16_t boundPort = ntohs(endpoint.sin_port);
+	Log::Info("RemoteCoordinator::Listen: Listening on %s:%d\n", address, boundPort);
+	return boundPort;
+}
+
+void Js::RemoteCoordinator::Shutdown()
+{
+	if (Started)
+	{
+		Quit.store(true, std::memory_order_release);
+		WSASetEvent(WakeEvent);
+		NetworkThread.Join();
+		Started = false;
+	}
+
+	if (ListenSocket != INVALID_SOCKET)
+		closesocket(ListenSocket);
+	ListenSocket = INVALID_SOCKET;
+	for (void** event : {&ListenEvent, &WakeEvent})
+	{
+		if (*event != WSA_INVALID_EVENT)
+			WSACloseEvent(*event);
+		*event = WSA_INVALID_EVENT;
+	}
+}
+
+void Js::RemoteCoordinator::AddJob(RemoteJob& job, Counter* counter)
+{
+	if (job.Payload.size() > MAX_PAYLOAD_SIZE)
+		throw JsException("Remote job payload is too large");
+	if (counter != nullptr)
+		counter->Initialize(System, 1);
+
+	{
+		std::lock_guard<std::mutex> lock(SubmittedMutex);
+		Submitted.push_back(Task{&job, counter, nullptr});
+	}
+	Wake();
+}
+
+void Js::RemoteCoordinator::AddJobs(std::vector<RemoteJob>& jobs, Counter* counter)
+{
+	for (const RemoteJob& job : jobs)
+	{
+		if (job.Payload.size() > MAX_PAYLOAD_SIZE)
+			throw JsException("Remote job payload is too large");
+	}
+	if (counter != nullptr)
+		counter->Initialize(System, static_cast<uint32_t>(jobs.size()));
+
+	{
+		std::lock_guard<std::mutex> lock(SubmittedMutex);
+		for (RemoteJob& job : jobs)
+			Submitted.push_back(Task{&job, counter, nullptr});
+	}
+	Wake();
+}
+
+bool Js::RemoteCoordinator::WaitForNodes(const size_t count, const uint32_t timeoutMs)
+{
+	const uint64_t deadline = GetTickCount64() + timeoutMs;
+	while (ReadyNodes.load(std::memory_order_acquire) < count)
+	{
+		if (GetTickCount64() >= deadline)
+			return false;
+		SleepFor(*System, 1);
+	}
+	return true;
+}
+
+Js::RemoteStats Js::RemoteCoordinator::GetStats() const
+{
+	RemoteStats stats;
+	stats.NodeCount = ReadyNodes.load(std::memory_order_relaxed);
+	stats.JobsSent = JobsSent.load(std::memory_order_relaxed);
+	stats.JobsCompleted = JobsCompleted.load(std::memory_order_relaxed);
+	stats.JobsReassigned = JobsReassigned.load(std::memory_order_relaxed);
+	stats.BatchesSent = BatchesSent.load(std::memory_order_relaxed);
+	stats.BatchesReceived = BatchesReceived.load(std::memory_order_relaxed);
+	stats.BytesSent = BytesSent.load(std::memory_order_relaxed);
+	stats.BytesReceived = BytesReceived.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void Js::RemoteCoordinator::Wake()
+{
+	// Jobs added while the network thread has not picked up the last ones ride along without another wake
+	if (!WakePending.exchange(true, std::memory_order_acq_rel))
+		WSASetEvent(WakeEvent);
+}
+
+void Js::RemoteCoordinator::NetworkMain(Thread* thread)
+{
+	auto* coordinator = static_cast<RemoteCoordinator*>(thread->GetData());
+	std::vector<WSAEVENT> events;
+
+	while (!coordinator->Quit.load(std::memory_order_acquire))
+	{
+		events.assign({coordinator->WakeEvent, coordinator->ListenEvent});
+		for (const auto& node : coordinator->Nodes)
+			events.push_back(node->Link.Event);
+
+		WSAWaitForMultipleEvents(static_cast<DWORD>(events.size()), events.data(), FALSE,
+		                         coordinator->Options.PollIntervalMs, FALSE);
+		WSAResetEvent(coordinator->WakeEvent);
+		coordinator->WakePending.store(false, std::memory_order_release);
+
+		coordinator->AcceptNodes();
+
+		const uint64_t now = GetTickCount64();
+		for (size_t i = coordinator->Nodes.size(); i-- != 0;)
+		{
+			Node& node = *coordinator->Nodes[i];
+			// Serving the node may move LastReceive past now
+			if (!coordinator->ServeNode(node))
+				coordinator->DropNode(i, "connection closed");
+			else if (!node.InFlight.empty() && now > node.LastReceive + coordinator->Options.NodeTimeoutMs)
+				coordinator->DropNode(i, "timed out");
+		}
+
+		coordinator->TakeSubmitted();
+		coordinator->Dispatch();
+	}
+
+	coordinator->SendShutdown();
+}
+
+void Js::RemoteCoordinator::AcceptNodes()
+{
+	WSANETWORKEVENTS events;
+	if (WSAEnumNetworkEvents(ListenSocket, ListenEvent, &events) != 0 || (events.lNetworkEvents & FD_ACCEPT) == 0)
+		return;
+
+	for (;;)
+	{
+		const SOCKET socket = accept(ListenSocket, nullptr, nullptr);
+		if (socket == INVALID_SOCKET)
+			return;
+
+		// Two events of every wait belong to the coordinator itself
+		if (Nodes.size() + 2 >= WSA_MAXIMUM_WAIT_EVENTS)
+		{
+			Log::Warning("RemoteCoordinator::AcceptNodes: Refusing node, %zu nodes is the most one coordinator serves\n",
+			             Nodes.size());
+			closesocket(socket);
+			continue;
+		}
+
+		std::unique_ptr<Node> node(new Node());
+		if (!node->Link.Open(socket))
+		{
+			Log::Warning("RemoteCoordinator::AcceptNodes: Failed to set up node connection: %d\n", WSAGetLastError());
+			continue;
+		}
+		node->LastReceive = GetTickCount64();
+		Nodes.push_back(std::move(node));
+	}
+}
+
+bool Js::RemoteCoordinator::ServeNode(Node& node)
+{
+	const int64_t sent = node.Link.Flush();
+	if (sent < 0)
+		return false;
+	BytesSent.fetch_add(sent, std::memory_order_relaxed);
+
+	node.Link.ResetEvent();
+	const int64_t received = node.Link.Receive();
+	if (received > 0)
+		BytesReceived.fetch_add(received, std::memory_order_relaxed);
+
+	FrameType type;
+	const char* body;
+	uint32_t size;
+	bool broken;
+	while (node.Link.NextFrame(type, body, size, broken))
+	{
+		node.LastReceive = GetTickCount64();
+		switch (type)
+		{
+		case FrameType::Hello:
+		{
+			FrameReader reader(body, size);
+			if (node.Ready || !reader.Read(node.Credits) || !reader.Read(node.ProcessId) || node.Credits == 0)
+				return false;
+
+			node.Ready = true;
+			ReadyNodes.fetch_add(1, std::memory_order_acq_rel);
+			Log::Info("RemoteCoordinator::ServeNode: Node of process %u joined with %u credits\n", node.ProcessId,
+			          node.Credits);
+			break;
+		}
+		case FrameType::Results:
+			BatchesReceived.fetch_add(1, std::memory_order_relaxed);
+			if (!HandleResults(node, body, size))
+				return false;
+			break;
+		case FrameType::Heartbeat:
+			break;
+		default:
+			return false;
+		}
+	}
+	return received >= 0 && !broken;
+}
+
+bool Js::RemoteCoordinator::HandleResults(Node& node, const char* body, const uint32_t size)
+{
+	FrameReader reader(body, size);
+	uint32_t count;
+	if (!reader.Read(count))
+		return false;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint64_t id;
+		uint8_t failed;
+		uint32_t resultSize;
+		if (!reader.Read(id) || !reader.Read(failed) || !reader.Read(resultSize))
+			return false;
+
+		// Results only come from the node a job is in flight on, anything else is a broken node
+		const auto task = Tasks.find(id);
+		if (task == Tasks.end() || task->second.Owner != &node)
+			return false;
+		if (!reader.ReadBytes(task->second.Job->Result, resultSize))
+			return false;
+		task->second.Job->Failed = failed != 0;
+
+		Js::Counter* counter = task->second.Counter;
+		node.InFlight.erase(id);
+		++node.Credits;
+		Tasks.erase(task);
+		JobsCompleted.fetch_add(1, std::memory_order_relaxed);
+
+		if (counter != nullptr)
+			counter->Decrement();
+	}
+	return true;
+}
+
+void Js::RemoteCoordinator::DropNode(const size_t index, const char* reason)
+{
+	Node& node = *Nodes[index];
+	Log::Warning("RemoteCoordinator::DropNode: Node of process %u %s, reassigning %zu jobs\n", node.ProcessId, reason,
+	             node.InFlight.size());
+
+	for (const uint64_t id : node.InFlight)
+	{
+		Tasks[id].Owner = nullptr;
+		Unassigned.push_front(id);
+	}
+	JobsReassigned.fetch_add(node.InFlight.size(), std::memory_order_relaxed);
+
+	if (node.Ready)
+		ReadyNodes.fetch_sub(1, std::memory_order_acq_rel);
+	Nodes.erase(Nodes.begin() + index);
+}
+
+void Js::RemoteCoordinator::TakeSubmitted()
+{
+	std::vector<Task> submitted;
+	{
+		std::lock_guard<std::mutex> lock(SubmittedMutex);
+		submitted.swap(Submitted);
+	}
+
+	for (const Task& task : submitted)
+	{
+		const uint64_t id = NextTaskId++;
+		Tasks.emplace(id, task);
+		Unassigned.push_back(id);
+	}
+}
+
+void Js::RemoteCoordinator::Dispatch()
+{
+	// Round robin, each node with credit gets a fair share of the queued jobs per round so a burst is spread over
+	// all nodes rather than filling the first one
+	bool sent = true;
+	while (sent && !Unassigned.empty())
+	{
+		sent = false;
+		size_t readyNodes = 0;
+		for (const auto& node : Nodes)
+			readyNodes += node->Ready && node->Credits != 0;
+		if (readyNodes == 0)
+			return;
+
+		const size_t share = (Unassigned.size() + readyNodes - 1) / readyNodes;
+		for (size_t i = Nodes.size(); i-- != 0 && !Unassigned.empty();)
+		{
+			Node& node = *Nodes[i];
+			if (!node.Ready || node.Credits == 0)
+				continue;
+
+			const size_t jobCount = std::min<size_t>({share, node.Credits, Options.MaxBatchJobs});
+			if (!SendBatch(node, jobCount))
+			{
+				DropNode(i, "failed to send");
+				continue;
+			}
+			sent = true;
+		}
+	}
+}
+
+bool Js::RemoteCoordinator::SendBatch(Node& node, const size_t jobCount)
+{
+	std::vector<char>& outbox = node.Link.Outbox;
+	const size_t start = BeginFrame(outbox, FrameType::Jobs);
+	const size_t countOffset = outbox.size();
+	Put(outbox, uint32_t{0});
+
+	uint32_t count = 0;
+	size_t bytes = 0;
+	while (count < jobCount && !Unassigned.empty())
+	{
+		const uint64_t id = Unassigned.front();
+		Task& task = Tasks[id];
+		const size_t size = task.Job->Payload.size();
+		if (count != 0 && bytes + size > Options.MaxBatchBytes)
+			break;
+		Put(outbox, id);
+		Put(outbox, task.Job->TypeId);
+		Put(outbox, static_cast<uint32_t>(size));
+		PutBytes(outbox, task.Job->Payload);
+
+		task.Owner = &node;
+		node.InFlight.insert(id);
+		Unassigned.pop_front();
+		bytes += size;
+		++count;
+	}
+
+	std::memcpy(&outbox[countOffset], &count, sizeof(count));
+	EndFrame(outbox, start);
+	node.Credits -= count;
+	JobsSent.fetch_add(count, std::memory_order_relaxed);
+	BatchesSent.fetch_add(1, std::memory_order_relaxed);
+
+	const int64_t sent = node.Link.Flush();
+	if (sent < 0)
+		return false;
+	BytesSent.fetch_add(sent, std::memory_order_relaxed);
+	return true;
+}
+
+void Js::RemoteCoordinator::SendShutdown()
+{
+	for (const auto& node : Nodes)
+	{
+		EndFrame(node->Link.Outbox, BeginFrame(node->Link.Outbox, FrameType::Shutdown));
+		node->Link.Flush();
+	}
+
+	// Closing a socket with unread data resets the connection and may discard the frame on the node, so give the
+	// nodes up to a poll interval to read it and hang up first
+	const uint64_t deadline = GetTickCount64() + Options.PollIntervalMs;
+	for (const auto& node : Nodes)
+	{
+		while (!node->Link.Outbox.empty() && GetTickCount64() < deadline && node->Link.Flush() >= 0)
+			Sleep(1);
+		shutdown(node->Link.Socket, SD_SEND);
+		while (GetTickCount64() < deadline && node->Link.Receive() >= 0)
+			Sleep(1);
+	}
+
+	if (!Tasks.empty())
+		Log::Warning("RemoteCoordinator::SendShutdown: %zu jobs never completed\n", Tasks.size());
+
+	Nodes.clear();
+	ReadyNodes.store(0, std::memory_order_release);
+}
+
+Js::RemoteWorker::RemoteWorker(JobSystem& system, const RemoteWorkerOptions& options) :
+	System(&system),
+	Options(options)
+{
+	if (Options.Credits == 0)
+		Options.Credits = static_cast<uint32_t>(4 * System->GetThreadCount());
+	if (Options.MaxBatchJobs == 0)
+		throw JsException("Remote batches must hold at least one job");
+
+	StartWinsock();
+	CompletionEvent = WSACreateEvent();
+	if (CompletionEvent == WSA_INVALID_EVENT)
+	{
+		WSACleanup();
+		throw JsException("Failed to create worker completion event");
+	}
+}
+
+Js::RemoteWorker::~RemoteWorker()
+{
+	WSACloseEvent(CompletionEvent);
+	WSACleanup();
+}
+
+void Js::RemoteWorker::Register(const uint32_t typeId, const RemoteJobFunction function)
+{
+	if (typeId >= Functions.size())
+		Functions.resize(typeId + 1, nullptr);
+	Functions[typeId] = function;
+}
+
+bool Js::RemoteWorker::Run(const char* address, const uint16_t port)
+{
+	addrinfo hints = {};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	addrinfo* endpoint = nullptr;
+	if (getaddrinfo(address, std::to_string(port).c_str(), &hints, &endpoint) != 0)
+		throw JsException("Failed to resolve coordinator address");
+
+	const SOCKET socket = ::socket(endpoint->ai_family, endpoint->ai_socktype, endpoint->ai_protocol);
+	const bool connected = socket != INVALID_SOCKET &&
+		connect(socket, endpoint->ai_addr, static_cast<int>(endpoint->ai_addrlen)) == 0;
+	freeaddrinfo(endpoint);
+
+	Session session;
+	session.Worker = this;
+	if (!connected)
+	{
+		if (socket != INVALID_SOCKET)
+			closesocket(socket);
+		throw JsException("Failed to connect to coordinator");
+	}
+	if (!session.Link.Open(socket))
+		throw JsException("Failed to set up coordinator connection");
+
+	const size_t hello = BeginFrame(session.Link.Outbox, FrameType::Hello);
+	Put(session.Link.Outbox, Options.Credits);
+	Put(session.Link.Outbox, static_cast<uint32_t>(GetCurrentProcessId()));
+	EndFrame(session.Link.Outbox, hello);
+	Log::Info("RemoteWorker::Run: Connected to %s:%d with %u credits\n", address, port, Options.Credits);
+
+	if (!System->IsWorkerThread())
+		return Serve(session);
+
+	// A worker only picks the fiber back up between jobs, so the connection gets a thread of its own to keep the
+	// heartbeats going while every worker is busy
+	session.Done.Initialize(System, 1);
+	Thread thread;
+	if (!thread.Create(ServeMain, &session))
+		throw JsException("Failed to start remote worker thread");
+	System->Wait(session.Done, 0);
+	thread.Join();
+	return session.Served;
+}
+
+void Js::RemoteWorker::ServeMain(Thread* thread)
+{
+	auto* session = static_cast<Session*>(thread->GetData());
+	session->Served = session->Worker->Serve(*session);
+	session->Done.Decrement();
+}
+
+bool Js::RemoteWorker::Serve(Session& session)
+{
+	Connection& link = session.Link;
+	const WSAEVENT events[] = {CompletionEvent, link.Event};
+	uint64_t lastSend = GetTickCount64();
+	size_t inFlight = 0;
+	bool shutdown = false;
+	bool broken = false;
+
+	// After a shutdown or a broken connection the loop keeps going until the jobs still running are done with
+	// this worker
+	while ((!shutdown && !broken) || inFlight != 0)
+	{
+		// A broken connection is no longer served, so its event would stay set and only the results are waited for
+		const DWORD eventCount = broken ? 1 : 2;
+		WSAWaitForMultipleEvents(eventCount, events, FALSE, Options.HeartbeatIntervalMs, FALSE);
+		WSAResetEvent(CompletionEvent);
+		CompletionPending.store(false, std::memory_order_release);
+
+		std::vector<WorkItem*> completed = TakeCompleted();
+		inFlight -= completed.size();
+		Executed.fetch_add(completed.size(), std::memory_order_relaxed);
+		for (size_t next = 0; next < completed.size() && !broken;)
+		{
+			const size_t start = BeginFrame(link.Outbox, FrameType::Results);
+			const size_t countOffset = link.Outbox.size();
+			Put(link.Outbox, uint32_t{0});
+
+			uint32_t count = 0;
+			size_t bytes = 0;
+			for (; next < completed.size() && count < Options.MaxBatchJobs; ++next, ++count)
+			{
+				const WorkItem& item = *completed[next];
+				if (count != 0 && bytes + item.Result.size() > Options.MaxBatchBytes)
+					break;
+
+				Put(link.Outbox, item.Id);
+				Put(link.Outbox, static_cast<uint8_t>(item.Failed));
+				Put(link.Outbox, static_cast<uint32_t>(item.Result.size()));
+				PutBytes(link.Outbox, item.Result);
+				bytes += item.Result.size();
+			}
+
+			std::memcpy(&link.Outbox[countOffset], &count, sizeof(count));
+			EndFrame(link.Outbox, start);
+		}
+		for (WorkItem* item : completed)
+			delete item;
+
+		if (broken)
+			continue;
+
+		if (link.Outbox.empty() && GetTickCount64() - lastSend >= Options.HeartbeatIntervalMs)
+			EndFrame(link.Outbox, BeginFrame(link.Outbox, FrameType::Heartbeat));
+		if (!link.Outbox.empty())
+			lastSend = GetTickCount64();
+		link.ResetEvent();
+		const bool closed = link.Flush() < 0 || link.Receive() < 0;
+
+		FrameType type;
+		const char* body;
+		uint32_t size;
+		bool oversized = false;
+		std::vector<Job> jobs;
+		while (!shutdown && !broken && link.NextFrame(type, body, size, oversized))
+		{
+			if (type == FrameType::Shutdown)
+			{
+				shutdown = true;
+				break;
+			}
+			if (type != FrameType::Jobs)
+				continue;
+
+			FrameReader reader(body, size);
+			uint32_t count = 0;
+			broken = !reader.Read(count);
+			for (uint32_t i = 0; i < count && !broken; ++i)
+			{
+				std::unique_ptr<WorkItem> item(new WorkItem());
+				uint32_t payloadSize;
+				item->Worker = this;
+				broken = !reader.Read(item->Id) || !reader.Read(item->TypeId) || !reader.Read(payloadSize) ||
+					!reader.ReadBytes(item->Payload, payloadSize);
+				if (broken)
+					break;
+
+				jobs.emplace_back(ExecuteItem, item.release());
+				jobs.back().Tag = "RemoteJob";
+			}
+		}
+
+		if (!jobs.empty())
+		{
+			inFlight += jobs.size();
+			System->AddJobs(jobs);
+		}
+
+		broken = broken || oversized;
+		if (broken)
+			Log::Warning("RemoteWorker::Serve: Coordinator sent a malformed frame\n");
+		else if (closed && !shutdown)
+		{
+			Log::Warning("RemoteWorker::Serve: Lost the coordinator with %zu jobs running\n", inFlight);
+			broken = true;
+		}
+		shutdown = shutdown || closed;
+	}
+
+	Log::Info("RemoteWorker::Serve: Ran %llu jobs\n", GetExecutedCount());
+	return !broken;
+}
+
+std::vector<Js::RemoteWorker::WorkItem*> Js::RemoteWorker::TakeCompleted()
+{
+	std::vector<WorkItem*> completed;
+	std::lock_guard<std::mutex> lock(CompletedMutex);
+	completed.swap(Completed);
+	return completed;
+}
+
+void Js::RemoteWorker::ExecuteItem(JobSystem& system, void* data)
+{
+	auto* item = static_cast<WorkItem*>(data);
+	RemoteWorker* worker = item->Worker;
+
+	const RemoteJobFunction function = item->TypeId < worker->Functions.size() ? worker->Functions[item->TypeId] : nullptr;
+	if (function != nullptr)
+		function(system, item->Payload, item->Result);
+	else
+		item->Failed = true;
+
+	if (item->Result.size() > MAX_PAYLOAD_SIZE)
+	{
+		Log::Warning("RemoteWorker::ExecuteItem: Result of %zu bytes is too large to send\n", item->Result.size());
+		item->Result.clear();
+		item->Failed = true;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(worker->CompletedMutex);
+		worker->Completed.push_back(item);
+	}
+	// Results finishing while Run has not picked up the last ones go back in the same batch
+	if (!worker->CompletionPending.exchange(true, std::memory_order_acq_rel))
+		WSASetEvent(worker->CompletionEvent);
+}
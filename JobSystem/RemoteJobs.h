@@ -0,0 +1,183 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Thread.h"
+
+namespace Js
+{
+	class Counter;
+	class JobSystem;
+
+	// Runs on a worker node with the payload the coordinator sent, whatever it leaves in result is sent back
+	using RemoteJobFunction = void (*)(JobSystem& system, const std::vector<char>& payload, std::vector<char>& result);
+
+	// Must stay alive and untouched until its counter completes, Result and Failed are filled in by then
+	struct RemoteJob
+	{
+		uint32_t TypeId = 0;
+		std::vector<char> Payload;
+		std::vector<char> Result;
+		// The node had no function registered for TypeId or its result was too large to send
+		bool Failed = false;
+	};
+
+	struct RemoteCoordinatorOptions
+	{
+		// Jobs and bytes of payload sent to a node in one message
+		size_t MaxBatchJobs = 64;
+		size_t MaxBatchBytes = 256u << 10;
+		// A node with jobs in flight that sent nothing for this long, not even a heartbeat, is dropped
+		uint32_t NodeTimeoutMs = 5000;
+		uint32_t PollIntervalMs = 100;
+	};
+
+	struct RemoteWorkerOptions
+	{
+		// Jobs the coordinator may have in flight on this node, 0 uses four per thread of the JobSystem
+		uint32_t Credits = 0;
+		size_t MaxBatchJobs = 64;
+		size_t MaxBatchBytes = 256u << 10;
+		uint32_t HeartbeatIntervalMs = 500;
+	};
+
+	struct RemoteStats
+	{
+		size_t NodeCount = 0;
+		uint64_t JobsSent = 0;
+		uint64_t JobsCompleted = 0;
+		// Jobs sent again after the node running them disappeared
+		uint64_t JobsReassigned = 0;
+		uint64_t BatchesSent = 0;
+		uint64_t BatchesReceived = 0;
+		uint64_t BytesSent = 0;
+		uint64_t BytesReceived = 0;
+	};
+
+	// Sends jobs to worker nodes connected over TCP and decrements their counters as the results come back. Every
+	// node announces how many jobs it takes at once and is only sent more as it returns results, so a slow node is
+	// never flooded. Jobs queued while no node has credit wait for one. The jobs in flight on a node whose
+	// connection closes or goes quiet are sent to the others again, so a job may run more than once but completes
+	// exactly once. The sockets are served by one thread of its own
+	class RemoteCoordinator
+	{
+	public:
+		explicit RemoteCoordinator(JobSystem& system, const RemoteCoordinatorOptions& options = RemoteCoordinatorOptions());
+		RemoteCoordinator(const RemoteCoordinator&) = delete;
+		~RemoteCoordinator();
+
+		// Starts accepting nodes, port 0 picks a free one, returns the port listened on
+		uint16_t Listen(const char* address = "127.0.0.1", uint16_t port = 0);
+		// Sends the nodes home, jobs still queued or in flight never complete
+		void Shutdown();
+
+		void AddJob(RemoteJob& job, Counter* counter = nullptr);
+		void AddJobs(std::vector<RemoteJob>& jobs, Counter* counter = nullptr);
+
+		// Waits until that many nodes said hello, false if the time ran out first
+		bool WaitForNodes(size_t count, uint32_t timeoutMs);
+		RemoteStats GetStats() const;
+
+	private:
+		struct Node;
+
+		struct Task
+		{
+			RemoteJob* Job = nullptr;
+			Js::Counter* Counter = nullptr;
+			// Node the job is in flight on
+			Node* Owner = nullptr;
+		};
+
+		JobSystem* System;
+		RemoteCoordinatorOptions Options;
+
+		uintptr_t ListenSocket;
+		void* ListenEvent = nullptr;
+		// Set by AddJobs and Shutdown to wake the network thread
+		void* WakeEvent = nullptr;
+		std::atomic_bool WakePending{false};
+		std::atomic_bool Quit{false};
+		Thread NetworkThread;
+		bool Started = false;
+
+		std::mutex SubmittedMutex;
+		std::vector<Task> Submitted;
+
+		// Touched only by the network thread
+		std::vector<std::unique_ptr<Node>> Nodes;
+		std::unordered_map<uint64_t, Task> Tasks;
+		// Jobs taken back from a dropped node go first
+		std::deque<uint64_t> Unassigned;
+		uint64_t NextTaskId = 1;
+
+		std::atomic<size_t> ReadyNodes{0};
+		std::atomic<uint64_t> JobsSent{0};
+		std::atomic<uint64_t> JobsCompleted{0};
+		std::atomic<uint64_t> JobsReassigned{0};
+		std::atomic<uint64_t> BatchesSent{0};
+		std::atomic<uint64_t> BatchesReceived{0};
+		std::atomic<uint64_t> BytesSent{0};
+		std::atomic<uint64_t> BytesReceived{0};
+
+		void Wake();
+		void AcceptNodes();
+		bool ServeNode(Node& node);
+		bool HandleResults(Node& node, const char* body, uint32_t size);
+		void DropNode(size_t index, const char* reason);
+		void TakeSubmitted();
+		void Dispatch();
+		bool SendBatch(Node& node, size_t jobCount);
+		void SendShutdown();
+
+		static void NetworkMain(Thread* thread);
+	};
+
+	// Connects to a coordinator and runs the jobs it sends on the JobSystem, batching results on their way back
+	class RemoteWorker
+	{
+	public:
+		explicit RemoteWorker(JobSystem& system, const RemoteWorkerOptions& options = RemoteWorkerOptions());
+		RemoteWorker(const RemoteWorker&) = delete;
+		~RemoteWorker();
+
+		// Every node must register the functions of the job types it is sent before Run
+		void Register(uint32_t typeId, RemoteJobFunction function);
+
+		// Serves the coordinator until it shuts down or the connection breaks, false in the latter case. On a worker
+		// thread the connection is served from a thread of its own while the fiber waits, so heartbeats do not depend
+		// on the pool. The jobs still queue behind the pool's other work, so Run should not share the pool with jobs
+		// that outlast the coordinator's node timeout or their results come back late
+		bool Run(const char* address, uint16_t port);
+
+		uint64_t GetExecutedCount() const { return Executed.load(std::memory_order_relaxed); }
+
+	private:
+		struct WorkItem;
+		struct Session;
+
+		JobSystem* System;
+		RemoteWorkerOptions Options;
+		std::vector<RemoteJobFunction> Functions;
+
+		// Set by finished jobs to wake Run
+		void* CompletionEvent = nullptr;
+		std::atomic_bool CompletionPending{false};
+		std::mutex CompletedMutex;
+		std::vector<WorkItem*> Completed;
+
+		std::atomic<uint64_t> Executed{0};
+
+		std::vector<WorkItem*> TakeCompleted();
+		bool Serve(Session& session);
+
+		static void ServeMain(Thread* thread);
+		static void ExecuteItem(JobSystem& system, void* data);
+	};
+}
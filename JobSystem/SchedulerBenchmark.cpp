@@ -0,0 +1,595 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "Counter.h"
+#include "Job.h"
+#include "JobGraph.h"
+#include "JobSystem.h"
+#include "JSException.h"
+#include "LatencyHistogram.h"
+
+namespace
+{
+	constexpr size_t REPEATS = 3;
+
+	constexpr uint32_t FIB_N = 24;
+	// Below this fib runs serially inside the job
+	constexpr uint32_t FIB_CUTOFF = 12;
+
+	constexpr uint32_t TREE_BRANCHING = 8;
+	constexpr uint32_t TREE_DEPTH = 4;
+
+	constexpr size_t FLAT_JOBS = 20000;
+
+	constexpr size_t CHAIN_COUNT = 8;
+	constexpr size_t CHAIN_LENGTH = 1000;
+
+	constexpr size_t IMBALANCED_JOBS = 8000;
+	// One leaf in IMBALANCED_PERIOD costs IMBALANCED_FACTOR times the others
+	constexpr size_t IMBALANCED_PERIOD = 64;
+	constexpr uint32_t IMBALANCED_FACTOR = 100;
+
+	constexpr size_t MIXED_JOBS_PER_PRIORITY = 5000;
+
+	constexpr size_t GRAPH_WIDTH = 16;
+	constexpr size_t GRAPH_LAYERS = 8;
+	constexpr size_t GRAPH_REPLAYS = 200;
+
+	// Roughly a microsecond of arithmetic
+	constexpr uint32_t LEAF_WORK = 1000;
+
+	constexpr size_t LATENCY_PROBES = 5000;
+	// Background jobs kept queued per worker, each a few hundred microseconds long
+	constexpr size_t BACKGROUND_JOBS_PER_WORKER = 4;
+	constexpr uint32_t BACKGROUND_WORK = LEAF_WORK * 200;
+
+	const uint16_t FIBER_COUNTS[] = {128, 512};
+	const size_t QUEUE_SIZES[] = {256, 4096};
+
+	volatile uint64_t Sink = 0;
+
+	void Spin(const uint32_t iterations)
+	{
+		uint64_t value = iterations;
+		for (uint32_t i = 0; i < iterations; ++i)
+			value = value * 6364136223846793005ull + 1442695040888963407ull;
+		Sink = value;
+	}
+
+	void RunJobs(Js::JobSystem& jobSystem, std::vector<Js::Job>& jobs, const char* tag,
+	             const Js::JobPriority priority = Js::JobPriority::Normal)
+	{
+		for (Js::Job& job : jobs)
+			job.Tag = tag;
+
+		Js::Counter counter;
+		jobSystem.AddJobs(jobs, &counter, priority);
+		jobSystem.Wait(counter, 0);
+	}
+
+	// Adds a batch wider than the queues in slices with at most two in flight, the main thread is a worker
+	// and must not enqueue into a full queue
+	void RunSliced(Js::JobSystem& jobSystem, std::vector<Js::Job>& jobs, const char* tag, const size_t sliceSize,
+	               const Js::JobPriority priority = Js::JobPriority::Normal,
+	               const Js::CounterMode mode = Js::CounterMode::Shared)
+	{
+		std::vector<std::unique_ptr<Js::Counter>> counters((jobs.size() + sliceSize - 1) / sliceSize);
+		for (size_t i = 0; i < counters.size(); ++i)
+		{
+			if (i >= 2)
+				jobSystem.Wait(*counters[i - 2], 0);
+
+			const size_t begin = i * sliceSize;
+			const size_t end = std::min(jobs.size(), begin + sliceSize);
+			std::vector<Js::Job> slice(jobs.begin() + static_cast<std::ptrdiff_t>(begin),
+			                           jobs.begin() + static_cast<std::ptrdiff_t>(end));
+			for (Js::Job& job : slice)
+				job.Tag = tag;
+			counters[i].reset(new Js::Counter(mode));
+			jobSystem.AddJobs(slice, counters[i].get(), priority);
+		}
+
+		for (size_t i = counters.size() >= 2 ? counters.size() - 2 : 0; i < counters.size(); ++i)
+			jobSystem.Wait(*counters[i], 0);
+	}
+
+	void LeafJob(Js::JobSystem&, void* data)
+	{
+		Spin(data != nullptr ? *static_cast<const uint32_t*>(data) : LEAF_WORK);
+	}
+
+	// Recursive fib, two child jobs per call above the cutoff
+
+	struct FibData
+	{
+		uint32_t N = 0;
+		uint64_t Result = 0;
+	};
+
+	uint64_t SerialFib(const uint32_t n)
+	{
+		return n < 2 ? n : SerialFib(n - 1) + SerialFib(n - 2);
+	}
+
+	uint64_t CountFibJobs(const uint32_t n)
+	{
+		return n < FIB_CUTOFF ? 1 : 1 + CountFibJobs(n - 1) + CountFibJobs(n - 2);
+	}
+
+	void FibJob(Js::JobSystem& jobSystem, void* data)
+	{
+		const auto fib = static_cast<FibData*>(data);
+		if (fib->N < FIB_CUTOFF)
+		{
+			fib->Result = SerialFib(fib->N);
+			return;
+		}
+
+		FibData children[2];
+		children[0].N = fib->N - 1;
+		children[1].N = fib->N - 2;
+		std::vector<Js::Job> jobs{Js::Job(FibJob, &children[0]), Js::Job(FibJob, &children[1])};
+		RunJobs(jobSystem, jobs, "bench-fib");
+
+		fib->Result = children[0].Result + children[1].Result;
+	}
+
+	uint64_t RunFib(Js::JobSystem& jobSystem, size_t)
+	{
+		FibData root;
+		root.N = FIB_N;
+		std::vector<Js::Job> jobs{Js::Job(FibJob, &root)};
+		RunJobs(jobSystem, jobs, "bench-fib");
+
+		if (root.Result != SerialFib(FIB_N))
+			throw Js::JsException("Fib benchmark computed a wrong result");
+		return CountFibJobs(FIB_N);
+	}
+
+	// Every inner node spawns TREE_BRANCHING children, leaves spin
+
+	void TreeJob(Js::JobSystem& jobSystem, void* data)
+	{
+		const uint32_t depth = *static_cast<const uint32_t*>(data);
+		if (depth == 0)
+		{
+			Spin(LEAF_WORK);
+			return;
+		}
+
+		uint32_t childDepth = depth - 1;
+		std::vector<Js::Job> jobs(TREE_BRANCHING, Js::Job(TreeJob, &childDepth));
+		RunJobs(jobSystem, jobs, "bench-tree");
+	}
+
+	uint64_t RunTree(Js::JobSystem& jobSystem, size_t)
+	{
+		uint32_t depth = TREE_DEPTH;
+		std::vector<Js::Job> jobs{Js::Job(TreeJob, &depth)};
+		RunJobs(jobSystem, jobs, "bench-tree");
+
+		uint64_t count = 0;
+		for (uint64_t level = 1, i = 0; i <= TREE_DEPTH; ++i, level *= TREE_BRANCHING)
+			count += level;
+		return count;
+	}
+
+	// One batch from the main thread, wider than the smaller queue sizes
+
+	uint64_t RunFlat(Js::JobSystem& jobSystem, const size_t sliceSize)
+	{
+		std::vector<Js::Job> jobs(FLAT_JOBS, Js::Job(LeafJob));
+		RunSliced(jobSystem, jobs, "bench-flat", sliceSize);
+		return FLAT_JOBS;
+	}
+
+	// The same batch with sharded counters, so the cost of the shared decrement shows against flat
+
+	uint64_t RunFlatSharded(Js::JobSystem& jobSystem, const size_t sliceSize)
+	{
+		std::vector<Js::Job> jobs(FLAT_JOBS, Js::Job(LeafJob));
+		RunSliced(jobSystem, jobs, "bench-flat-sharded", sliceSize, Js::JobPriority::Normal, Js::CounterMode::Sharded);
+		return FLAT_JOBS;
+	}
+
+	// Independent chains where every link waits for the one before it, dominated by wake-up latency
+
+	void ChainJob(Js::JobSystem& jobSystem, void*)
+	{
+		for (size_t i = 0; i < CHAIN_LENGTH; ++i)
+		{
+			std::vector<Js::Job> jobs{Js::Job(LeafJob)};
+			RunJobs(jobSystem, jobs, "bench-chain-link");
+		}
+	}
+
+	uint64_t RunChain(Js::JobSystem& jobSystem, size_t)
+	{
+		std::vector<Js::Job> jobs(CHAIN_COUNT, Js::Job(ChainJob));
+		RunJobs(jobSystem, jobs, "bench-chain");
+		return CHAIN_COUNT * (CHAIN_LENGTH + 1);
+	}
+
+	// Leaves with a heavy tail, the batch finishes only when the expensive ones are balanced across workers
+
+	uint64_t RunImbalanced(Js::JobSystem& jobSystem, const size_t sliceSize)
+	{
+		std::vector<uint32_t> costs(IMBALANCED_JOBS, LEAF_WORK);
+		for (size_t i = 0; i < costs.size(); i += IMBALANCED_PERIOD)
+			costs[i] = LEAF_WORK * IMBALANCED_FACTOR;
+
+		std::vector<Js::Job> jobs;
+		for (uint32_t& cost : costs)
+			jobs.emplace_back(LeafJob, &cost);
+		RunSliced(jobSystem, jobs, "bench-imbalanced", sliceSize);
+		return IMBALANCED_JOBS;
+	}
+
+	// Every priority fed by its own chain of batches at the same time
+
+	struct MixedData
+	{
+		Js::JobPriority Priority = Js::JobPriority::Normal;
+		size_t SliceSize = 0;
+	};
+
+	void MixedJob(Js::JobSystem& jobSystem, void* data)
+	{
+		const auto mixed = static_cast<const MixedData*>(data);
+		std::vector<Js::Job> jobs(MIXED_JOBS_PER_PRIORITY, Js::Job(LeafJob));
+		RunSliced(jobSystem, jobs, "bench-mixed", mixed->SliceSize, mixed->Priority);
+	}
+
+	uint64_t RunMixed(Js::JobSystem& jobSystem, const size_t sliceSize)
+	{
+		MixedData data[] = {
+			{Js::JobPriority::Low, sliceSize},
+			{Js::JobPriority::Normal, sliceSize},
+			{Js::JobPriority::High, sliceSize},
+		};
+
+		std::vector<Js::Job> jobs;
+		for (MixedData& mixed : data)
+			jobs.emplace_back(MixedJob, &mixed);
+		RunJobs(jobSystem, jobs, "bench-mixed-feeder");
+		return 3 * (MIXED_JOBS_PER_PRIORITY + 1);
+	}
+
+	// One layered graph recorded once and replayed, every node waits for two nodes of the layer above
+
+	uint64_t RunGraph(Js::JobSystem& jobSystem, size_t)
+	{
+		Js::JobGraph graph(jobSystem);
+		std::vector<Js::JobGraph::NodeId> nodes;
+		for (size_t layer = 0; layer < GRAPH_LAYERS; ++layer)
+		{
+			for (size_t i = 0; i < GRAPH_WIDTH; ++i)
+			{
+				Js::Job job(LeafJob);
+				job.Tag = "bench-graph";
+				nodes.push_back(graph.AddNode(job));
+				if (layer == 0)
+					continue;
+
+				const size_t above = (layer - 1) * GRAPH_WIDTH;
+				graph.AddDependency(nodes[above + i], nodes.back());
+				graph.AddDependency(nodes[above + (i + 1) % GRAPH_WIDTH], nodes.back());
+			}
+		}
+		graph.Seal();
+
+		for (size_t i = 0; i < GRAPH_REPLAYS; ++i)
+			graph.Run();
+		return GRAPH_WIDTH * GRAPH_LAYERS * GRAPH_REPLAYS;
+	}
+
+	struct Workload
+	{
+		const char* Name;
+		uint64_t (*Run)(Js::JobSystem&, size_t sliceSize);
+	};
+
+	const Workload WORKLOADS[] = {
+		{"fib", RunFib},
+		{"tree", RunTree},
+		{"flat", RunFlat},
+		{"flat-sharded", RunFlatSharded},
+		{"chain", RunChain},
+		{"imbalanced", RunImbalanced},
+		{"mixed", RunMixed},
+		{"graph", RunGraph},
+	};
+
+	struct Result
+	{
+		std::string Workload;
+		size_t Threads = 0;
+		uint16_t Fibers = 0;
+		size_t QueueSize = 0;
+		uint64_t Jobs = 0;
+		double Milliseconds = 0.0;
+		double JobsPerSecond = 0.0;
+		double Efficiency = 0.0;
+		Js::SchedulerPressure Pressure;
+	};
+
+	const char* const REPORT_HEADER = "workload,threads,fibers,queue_size,jobs,ms,jobs_per_sec,efficiency,"
+		"peak_fibers,fiber_exhausted,queue_full_retries,local_overflows,job_pool_fallbacks";
+
+	void WriteResult(std::ostream& stream, const Result& result)
+	{
+		stream << result.Workload << "," << result.Threads << "," << result.Fibers << "," << result.QueueSize << ","
+			<< result.Jobs << "," << result.Milliseconds << "," << result.JobsPerSecond << "," << result.Efficiency << ","
+			<< result.Pressure.PeakFibersInUse << "," << result.Pressure.FiberPoolExhausted << ","
+			<< result.Pressure.QueueFullRetries << "," << result.Pressure.LocalQueueOverflows << ","
+			<< result.Pressure.JobPoolFallbacks << std::endl;
+	}
+
+	Result Measure(const Workload& workload, const size_t threads, const uint16_t fibers, const size_t queueSize)
+	{
+		Js::Options options;
+		options.ThreadCount = threads;
+		options.FiberCount = fibers;
+		options.HighPriorityQueueSize = queueSize;
+		options.NormalPriorityQueueSize = queueSize;
+		options.LowPriorityQueueSize = queueSize;
+		options.WorkerQueueSize = std::min<size_t>(queueSize, 256);
+
+		Js::JobSystem jobSystem(options);
+		jobSystem.Initialize();
+
+		Result result;
+		result.Workload = workload.Name;
+		result.Threads = threads;
+		result.Fibers = fibers;
+		result.QueueSize = queueSize;
+
+		// Best of several runs, the first also warms up the fiber stacks
+		result.Milliseconds = 1e300;
+		for (size_t i = 0; i < REPEATS; ++i)
+		{
+			const auto begin = std::chrono::steady_clock::now();
+			result.Jobs = workload.Run(jobSystem, std::max<size_t>(queueSize / 4, 1));
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+			result.Milliseconds = std::min(result.Milliseconds, elapsed.count());
+		}
+
+		result.JobsPerSecond = static_cast<double>(result.Jobs) * 1000.0 / result.Milliseconds;
+		result.Pressure = jobSystem.GetSchedulerPressure();
+		jobSystem.Shutdown(true);
+		return result;
+	}
+
+	std::vector<size_t> GetThreadCounts(const size_t maxThreads)
+	{
+		std::vector<size_t> counts;
+		for (size_t count = 1; count < maxThreads; count *= 2)
+			counts.push_back(count);
+		counts.push_back(maxThreads);
+		return counts;
+	}
+
+	int Sweep(const char* reportPath, const size_t maxThreads)
+	{
+		std::ofstream report;
+		if (reportPath != nullptr)
+		{
+			report.open(reportPath, std::ios::trunc);
+			if (!report)
+			{
+				std::cerr << "Failed to open " << reportPath << std::endl;
+				return 1;
+			}
+			report << REPORT_HEADER << std::endl;
+		}
+
+		std::cout << REPORT_HEADER << std::endl;
+		for (const uint16_t fibers : FIBER_COUNTS)
+		{
+			for (const size_t queueSize : QUEUE_SIZES)
+			{
+				for (const Workload& workload : WORKLOADS)
+				{
+					double singleThreadRate = 0.0;
+					for (const size_t threads : GetThreadCounts(maxThreads))
+					{
+						Result result = Measure(workload, threads, fibers, queueSize);
+						if (threads == 1)
+							singleThreadRate = result.JobsPerSecond;
+						result.Efficiency = result.JobsPerSecond / (singleThreadRate * static_cast<double>(threads));
+
+						WriteResult(std::cout, result);
+						if (report.is_open())
+							WriteResult(report, result);
+					}
+				}
+			}
+		}
+		return 0;
+	}
+
+	using ReportKey = std::tuple<std::string, size_t, size_t, size_t>;
+
+	bool ReadReport(const char* path, std::map<ReportKey, double>& rates)
+	{
+		std::ifstream file(path);
+		std::string line;
+		if (!std::getline(file, line) || line != REPORT_HEADER)
+		{
+			std::cerr << path << " is not a scheduler benchmark report" << std::endl;
+			return false;
+		}
+
+		while (std::getline(file, line))
+		{
+			std::vector<std::string> fields;
+			std::stringstream stream(line);
+			for (std::string field; std::getline(stream, field, ',');)
+				fields.push_back(field);
+			if (fields.size() < 7)
+				continue;
+
+			const ReportKey key(fields[0], std::strtoull(fields[1].c_str(), nullptr, 10),
+			                    std::strtoull(fields[2].c_str(), nullptr, 10), std::strtoull(fields[3].c_str(), nullptr, 10));
+			rates[key] = std::strtod(fields[6].c_str(), nullptr);
+		}
+		return true;
+	}
+
+	// Throughput of every configuration present in both reports, a ratio above one means the new build is faster
+	int Compare(const char* baselinePath, const char* reportPath)
+	{
+		std::map<ReportKey, double> baseline;
+		std::map<ReportKey, double> current;
+		if (!ReadReport(baselinePath, baseline) || !ReadReport(reportPath, current))
+			return 1;
+
+		std::cout << "workload,threads,fibers,queue_size,baseline_jobs_per_sec,jobs_per_sec,ratio" << std::endl;
+		for (const auto& entry : current)
+		{
+			const auto base = baseline.find(entry.first);
+			if (base == baseline.end() || base->second <= 0.0)
+				continue;
+
+			std::cout << std::get<0>(entry.first) << "," << std::get<1>(entry.first) << "," << std::get<2>(entry.first)
+				<< "," << std::get<3>(entry.first) << "," << base->second << "," << entry.second << ","
+				<< entry.second / base->second << std::endl;
+		}
+		return 0;
+	}
+
+	// Dispatch latency of High priority jobs submitted by an outside thread while every worker is kept busy
+	// with long Normal priority jobs, the case reserved workers are for
+
+	struct LatencyRun
+	{
+		Js::LatencyHistogram Dispatch;
+		std::atomic_bool Stop{false};
+		std::atomic<size_t> Background{0};
+	};
+
+	struct Probe
+	{
+		LatencyRun* Run = nullptr;
+		uint64_t SubmitTime = 0;
+	};
+
+	void BackgroundJob(Js::JobSystem& jobSystem, void* data)
+	{
+		const auto run = static_cast<LatencyRun*>(data);
+		Spin(BACKGROUND_WORK);
+		if (run->Stop.load(std::memory_order_relaxed))
+		{
+			run->Background.fetch_sub(1, std::memory_order_release);
+			return;
+		}
+
+		Js::Job job(BackgroundJob, run);
+		job.Tag = "bench-background";
+		jobSystem.AddJob(job);
+	}
+
+	void ProbeJob(Js::JobSystem&, void* data)
+	{
+		// Probes run one at a time, so the histogram keeps a single writer
+		const auto probe = static_cast<Probe*>(data);
+		probe->Run->Dispatch.Record(Js::JobProfiler::Now() - probe->SubmitTime);
+	}
+
+	void SubmitProbes(Js::JobSystem* jobSystem, LatencyRun* run)
+	{
+		for (size_t i = 0; i < LATENCY_PROBES; ++i)
+		{
+			Probe probe;
+			probe.Run = run;
+			Js::Job job(ProbeJob, &probe);
+			job.Tag = "bench-probe";
+
+			Js::Counter counter;
+			probe.SubmitTime = Js::JobProfiler::Now();
+			jobSystem->AddJob(job, &counter, Js::JobPriority::High);
+			jobSystem->Wait(counter, 0);
+		}
+	}
+
+	void MeasureLatency(const size_t threads, const size_t reservedWorkers)
+	{
+		Js::Options options;
+		options.ThreadCount = threads;
+		options.ReservedWorkers = reservedWorkers;
+
+		Js::JobSystem jobSystem(options);
+		jobSystem.Initialize();
+
+		LatencyRun run;
+		const size_t backgroundJobs = threads * BACKGROUND_JOBS_PER_WORKER;
+		run.Background.store(backgroundJobs, std::memory_order_relaxed);
+		for (size_t i = 0; i < backgroundJobs; ++i)
+		{
+			Js::Job job(BackgroundJob, &run);
+			job.Tag = "bench-background";
+			jobSystem.AddJob(job);
+		}
+
+		std::thread client(SubmitProbes, &jobSystem, &run);
+		client.join();
+
+		run.Stop.store(true, std::memory_order_relaxed);
+		while (run.Background.load(std::memory_order_acquire) != 0)
+			Js::SleepFor(jobSystem, 1);
+
+		std::cout << jobSystem.GetReservedWorkerCount() << "," << threads << "," << run.Dispatch.GetCount() << ","
+			<< run.Dispatch.GetPercentile(0.5) / 1000.0 << "," << run.Dispatch.GetPercentile(0.99) / 1000.0 << ","
+			<< run.Dispatch.GetPercentile(0.999) / 1000.0 << "," << run.Dispatch.GetMax() / 1000.0 << std::endl;
+		jobSystem.Shutdown(true);
+	}
+
+	int Latency(const size_t reservedWorkers, const size_t threads)
+	{
+		std::cout << "reserved,threads,probes,p50_us,p99_us,p999_us,max_us" << std::endl;
+		MeasureLatency(threads, 0);
+		MeasureLatency(threads, reservedWorkers);
+		return 0;
+	}
+}
+
+// Usage: sched-bench [report.csv] [max threads]
+//        sched-bench compare <baseline.csv> <report.csv>
+//        sched-bench latency [reserved workers] [threads]
+int RunSchedulerBenchmark(const int argc, char** argv)
+{
+	if (argc > 2 && std::strcmp(argv[2], "latency") == 0)
+	{
+		const size_t reservedWorkers = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+		const size_t threads = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : Js::GetAvailableCpuCount();
+		// The main thread and one more worker stay unreserved
+		return Latency(reservedWorkers, std::max<size_t>(threads, reservedWorkers + 2));
+	}
+
+	if (argc > 2 && std::strcmp(argv[2], "compare") == 0)
+	{
+		if (argc < 5)
+		{
+			std::cerr << "Usage: sched-bench compare <baseline.csv> <report.csv>" << std::endl;
+			return 1;
+		}
+		return Compare(argv[3], argv[4]);
+	}
+
+	const char* reportPath = argc > 2 ? argv[2] : nullptr;
+	const size_t maxThreads = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : Js::GetAvailableCpuCount();
+	return Sweep(reportPath, std::max<size_t>(maxThreads, 1));
+}
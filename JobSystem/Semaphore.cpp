@@ -0,0 +1,95 @@
+#include "Semaphore.h"
+
+#include "WindowsMinimal.h"
+
+#include "JobSystem.h"
+
+namespace
+{
+	constexpr uint32_t WAITERS_BIT = 1;
+	constexpr uint32_t COUNT_UNIT = 2;
+}
+
+Js::Semaphore::Semaphore(JobSystem& system, const uint32_t initialCount) :
+	State(initialCount * COUNT_UNIT),
+	System(&system) {}
+
+void Js::Semaphore::Acquire()
+{
+	for (size_t i = 0; i < WaitList::SPIN_COUNT; ++i)
+	{
+		if (TryAcquire())
+			return;
+
+		_mm_pause();
+	}
+
+	Waiters.Lock();
+	uint32_t state = State.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		if (state >= COUNT_UNIT)
+		{
+			if (State.compare_exchange_weak(state, state - COUNT_UNIT, std::memory_order_acquire))
+			{
+				Waiters.Unlock();
+				return;
+			}
+			continue;
+		}
+
+		if (State.compare_exchange_weak(state, state | WAITERS_BIT, std::memory_order_relaxed))
+			break;
+	}
+
+	// Release hands its unit directly to the first waiter, so waking up means the semaphore is acquired
+	Waiters.Park(*System);
+}
+
+bool Js::Semaphore::TryAcquire()
+{
+	uint32_t state = State.load(std::memory_order_relaxed);
+	while (state >= COUNT_UNIT)
+	{
+		if (State.compare_exchange_weak(state, state - COUNT_UNIT, std::memory_order_acquire))
+			return true;
+	}
+	return false;
+}
+
+void Js::Semaphore::Release(const uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t state = State.load(std::memory_order_relaxed);
+		bool released = false;
+		while ((state & WAITERS_BIT) == 0)
+		{
+			if (State.compare_exchange_weak(state, state + COUNT_UNIT, std::memory_order_release))
+			{
+				released = true;
+				break;
+			}
+		}
+
+		if (released)
+			continue;
+
+		Waiters.Lock();
+		WaitList::Waiter* waiter = Waiters.PopFront();
+		if (waiter == nullptr)
+		{
+			// Another release took the last waiter after this one saw the bit, the unit goes to the count instead
+			state = State.load(std::memory_order_relaxed);
+			while (!State.compare_exchange_weak(state, (state & ~WAITERS_BIT) + COUNT_UNIT, std::memory_order_release,
+			                                    std::memory_order_relaxed));
+			Waiters.Unlock();
+			continue;
+		}
+		if (Waiters.IsEmpty())
+			State.fetch_and(~WAITERS_BIT, std::memory_order_release);
+		Waiters.Unlock();
+
+		WaitList::Resume(*System, waiter);
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "WaitList.h"
+
+namespace Js
+{
+	class JobSystem;
+
+	class Semaphore
+	{
+	public:
+		explicit Semaphore(JobSystem& system, uint32_t initialCount = 0);
+		Semaphore(const Semaphore&) = delete;
+		~Semaphore() = default;
+
+		void Acquire();
+		bool TryAcquire();
+		void Release(uint32_t count = 1);
+
+	private:
+		// Bit 0 is set while waiters are queued, the remaining bits hold the available count
+		std::atomic<uint32_t> State;
+		JobSystem* System;
+		WaitList Waiters;
+	};
+}
@@ -0,0 +1,160 @@
+#include "Benchmarks.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+#include "SharedJobs.h"
+#include "WindowsMinimal.h"
+
+namespace
+{
+	constexpr uint32_t COMPUTE_FUNCTION = 0;
+	constexpr uint32_t COMPUTE_ROUNDS = 200000;
+	constexpr size_t PUMP_COUNT = 2;
+
+	struct Record
+	{
+		uint64_t Input;
+		uint64_t Result;
+		uint32_t RanBy;
+	};
+
+	// Jobs this process ran, a worker started with a crash count terminates itself in the middle of that job
+	std::atomic<uint64_t> JobsRun{0};
+	uint64_t CrashAfter = UINT64_MAX;
+
+	uint64_t Compute(uint64_t value)
+	{
+		for (uint32_t i = 0; i < COMPUTE_ROUNDS; ++i)
+		{
+			value ^= value << 13;
+			value ^= value >> 7;
+			value ^= value << 17;
+		}
+		return value;
+	}
+
+	void ComputeJob(Js::JobSystem&, Js::SharedJobHost& host, const uint64_t offset)
+	{
+		auto* record = static_cast<Record*>(host.GetData(offset));
+		if (JobsRun.fetch_add(1, std::memory_order_relaxed) == CrashAfter)
+			TerminateProcess(GetCurrentProcess(), 3);
+
+		record->Result = Compute(record->Input);
+		record->RanBy = static_cast<uint32_t>(host.GetPeerIndex());
+	}
+
+	bool StartWorker(const std::string& name, const bool crash, PROCESS_INFORMATION& process)
+	{
+		char path[MAX_PATH];
+		GetModuleFileNameA(nullptr, path, MAX_PATH);
+
+		std::string commandLine = std::string("\"") + path + "\" shm-bench worker " + name;
+		if (crash)
+			commandLine += " 3";
+
+		STARTUPINFOA startup = {};
+		startup.cb = sizeof(startup);
+		return CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup,
+		                      &process) != 0;
+	}
+
+	int RunWorker(Js::JobSystem& jobSystem, const int argc, char** argv)
+	{
+		if (argc <= 3)
+			return 1;
+		if (argc > 4)
+			CrashAfter = std::strtoull(argv[4], nullptr, 10);
+
+		Js::SharedJobHost host(jobSystem, argv[3]);
+		host.Register(COMPUTE_FUNCTION, ComputeJob);
+		host.Serve(PUMP_COUNT);
+		host.WaitForShutdown();
+		host.Stop();
+
+		std::cout << "Peer " << host.GetPeerIndex() << " ran " << host.GetExecutedCount() << " jobs, stole "
+			<< host.GetStolenCount() << std::endl;
+		return 0;
+	}
+}
+
+// Usage: shm-bench [processes] [jobs] [crash]
+// Runs the jobs on this process and that many worker processes sharing one segment, with crash the first worker
+// terminates itself in the middle of a job and the others pick it up again
+int RunSharedJobBenchmark(Js::JobSystem& jobSystem, const int argc, char** argv)
+{
+	if (argc > 2 && std::strcmp(argv[2], "worker") == 0)
+		return RunWorker(jobSystem, argc, argv);
+
+	const size_t processCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 3;
+	const size_t jobCount = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 4096;
+	const bool crash = argc > 4 && std::strcmp(argv[4], "crash") == 0;
+
+	const std::string name = "JsSharedJobs" + std::to_string(GetCurrentProcessId());
+	Js::SharedJobHost host(jobSystem, name.c_str());
+	host.Register(COMPUTE_FUNCTION, ComputeJob);
+
+	const uint64_t records = host.AllocateData(sizeof(Record) * jobCount, alignof(Record));
+	auto* record = static_cast<Record*>(host.GetData(records));
+	std::vector<Js::SharedJob> jobs(jobCount);
+	for (size_t i = 0; i < jobCount; ++i)
+	{
+		record[i] = Record{i + 1, 0, UINT32_MAX};
+		jobs[i].FunctionId = COMPUTE_FUNCTION;
+		jobs[i].Offset = records + i * sizeof(Record);
+	}
+
+	std::vector<PROCESS_INFORMATION> workers;
+	for (size_t i = 0; i < processCount; ++i)
+	{
+		PROCESS_INFORMATION process = {};
+		if (!StartWorker(name, crash && i == 0, process))
+		{
+			std::cerr << "Failed to start worker process: " << GetLastError() << std::endl;
+			break;
+		}
+		CloseHandle(process.hThread);
+		workers.push_back(process);
+	}
+
+	host.Serve(PUMP_COUNT);
+
+	const auto start = std::chrono::steady_clock::now();
+	const uint32_t counter = host.CreateCounter();
+	host.AddJobs(jobs, counter);
+	host.Wait(counter);
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	host.ReleaseCounter(counter);
+
+	size_t wrong = 0;
+	std::vector<size_t> perPeer(host.GetPeerCount());
+	for (size_t i = 0; i < jobCount; ++i)
+	{
+		if (record[i].Result != Compute(record[i].Input))
+			++wrong;
+		else if (record[i].RanBy < perPeer.size())
+			++perPeer[record[i].RanBy];
+	}
+
+	std::cout << "Ran " << jobCount << " jobs on " << workers.size() + 1 << " processes in " << elapsed.count()
+		<< " s, " << wrong << " wrong results" << std::endl;
+	for (size_t peer = 0; peer < perPeer.size(); ++peer)
+		std::cout << "Peer " << peer << ": " << perPeer[peer] << " results" << std::endl;
+	std::cout << "This process ran " << host.GetExecutedCount() << " jobs, stole " << host.GetStolenCount()
+		<< ", recovered from crashed peers: " << host.GetRecoveredJobCount() << std::endl;
+
+	host.RequestShutdown();
+	host.Stop();
+	for (const PROCESS_INFORMATION& worker : workers)
+	{
+		WaitForSingleObject(worker.hProcess, INFINITE);
+		CloseHandle(worker.hProcess);
+	}
+	return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,648 @@
+#include "SharedJobs.h"
+
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <immintrin.h>
+
+#include "Job.h"
+#include "JobSystem.h"
+#include "JSException.h"
+#include "Log.h"
+#include "WindowsMinimal.h"
+
+namespace
+{
+	constexpr char SEGMENT_MAGIC[8] = {'J', 'S', 'S', 'H', 'J', 'O', 'B', 'S'};
+	constexpr uint32_t SEGMENT_VERSION = 1;
+	constexpr size_t CACHELINE_SIZE = 64;
+
+	// Process id of a peer slot whose jobs are being requeued
+	constexpr uint32_t RECOVERING = UINT32_MAX;
+
+	constexpr uint32_t IDLE_SPIN_ROUNDS = 64;
+
+	// Cell states hold the ring position plus one, so a cell never written matches no position, then the status
+	// and the peer running the job
+	enum CellStatus : uint64_t
+	{
+		FREE = 0,
+		QUEUED = 1,
+		RUNNING = 2,
+		// The job ran but its counter may not have been decremented yet
+		DONE = 3
+	};
+
+	constexpr uint64_t MakeState(const uint64_t position, const CellStatus status, const size_t peer)
+	{
+		return (position + 1) << 16 | static_cast<uint64_t>(status) << 8 | peer;
+	}
+
+	CellStatus GetStatus(const uint64_t state) { return static_cast<CellStatus>(state >> 8 & 0xFF); }
+	size_t GetRunningPeer(const uint64_t state) { return static_cast<size_t>(state & 0xFF); }
+
+	size_t AlignUp(const size_t value, const size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	uint64_t GetProcessStart(const HANDLE process)
+	{
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(process, &creation, &exit, &kernel, &user))
+			return 0;
+		return static_cast<uint64_t>(creation.dwHighDateTime) << 32 | creation.dwLowDateTime;
+	}
+
+	size_t GetRingSize(const size_t size)
+	{
+		size_t ringSize = 2;
+		while (ringSize < size)
+			ringSize <<= 1;
+		return ringSize;
+	}
+
+	static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+	              "Atomics shared between processes must be lock free");
+}
+
+struct Js::SharedJobHost::Header
+{
+	char Magic[8];
+	uint32_t Version;
+	std::atomic<uint32_t> Ready;
+
+	uint64_t MaxPeers;
+	uint64_t RingSize;
+	uint64_t CounterCount;
+	uint64_t DataSize;
+
+	uint64_t PeersOffset;
+	uint64_t CellsOffset;
+	uint64_t CountersOffset;
+	uint64_t DataOffset;
+
+	std::atomic<uint64_t> DataUsed;
+	std::atomic<uint64_t> RecoveredJobs;
+	std::atomic<uint32_t> Shutdown;
+};
+
+struct Js::SharedJobHost::Peer
+{
+	// 0 while the slot is free
+	std::atomic<uint32_t> ProcessId;
+	// Creation time of the process, tells a reused process id apart, 0 until the attaching peer stores it
+	std::atomic<uint64_t> ProcessStart;
+
+	// Next position the ring publishes to, advanced only by the peer's own process
+	alignas(CACHELINE_SIZE) std::atomic<uint64_t> Head;
+	// No job before this position is still queued, a hint consumers advance
+	alignas(CACHELINE_SIZE) std::atomic<uint64_t> Tail;
+};
+
+struct Js::SharedJobHost::Cell
+{
+	std::atomic<uint64_t> State;
+	// Written by the publisher while the cell is free, read by the peer that claimed it
+	uint32_t FunctionId;
+	uint32_t Counter;
+	uint64_t Offset;
+};
+
+struct Js::SharedJobHost::SharedCounter
+{
+	std::atomic<uint32_t> InUse;
+	std::atomic<uint32_t> Value;
+};
+
+Js::SharedJobHost::SharedJobHost(JobSystem& system, const char* name, const SharedJobOptions& options) :
+	System(&system),
+	Options(options),
+	Functions(options.MaxFunctions, nullptr)
+{
+	if (Options.MaxPeers == 0 || Options.MaxPeers > 0xFF)
+		throw JsException("Shared jobs support 1 to 255 peers");
+	if (Options.CounterCount == 0 || Options.CounterCount >= UINT32_MAX)
+		throw JsException("Invalid shared job counter count");
+
+	Options.RingSize = GetRingSize(Options.RingSize);
+	RingMask = Options.RingSize - 1;
+	Attach(name);
+}
+
+Js::SharedJobHost::~SharedJobHost()
+{
+	Stop();
+	Detach();
+}
+
+size_t Js::SharedJobHost::GetSegmentSize(const SharedJobOptions& options)
+{
+	size_t size = AlignUp(sizeof(Header), CACHELINE_SIZE);
+	size += AlignUp(sizeof(Peer) * options.MaxPeers, CACHELINE_SIZE);
+	size += AlignUp(sizeof(Cell) * options.MaxPeers * options.RingSize, CACHELINE_SIZE);
+	size += AlignUp(sizeof(SharedCounter) * options.CounterCount, CACHELINE_SIZE);
+	return size + options.DataSize;
+}
+
+void Js::SharedJobHost::Attach(const char* name)
+{
+	const uint64_t size = GetSegmentSize(Options);
+
+	// Backed by the paging file and gone once the last process closed it
+	Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+	                             static_cast<DWORD>(size), name);
+	if (Mapping == nullptr)
+		throw JsException(std::string("Failed to create shared job segment ") + name);
+	Creator = GetLastError() != ERROR_ALREADY_EXISTS;
+
+	View = static_cast<char*>(MapViewOfFile(Mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(size)));
+	if (View == nullptr)
+	{
+		CloseHandle(Mapping);
+		Mapping = nullptr;
+		throw JsException(std::string("Failed to map shared job segment ") + name);
+	}
+	Segment = reinterpret_cast<Header*>(View);
+
+	if (Creator)
+	{
+		// The mapping starts zeroed, the other processes wait for Ready before reading anything else
+		new(Segment) Header();
+		std::memcpy(Segment->Magic, SEGMENT_MAGIC, sizeof(Segment->Magic));
+		Segment->Version = SEGMENT_VERSION;
+		Segment->MaxPeers = Options.MaxPeers;
+		Segment->RingSize = Options.RingSize;
+		Segment->CounterCount = Options.CounterCount;
+		Segment->DataSize = Options.DataSize;
+		Segment->PeersOffset = AlignUp(sizeof(Header), CACHELINE_SIZE);
+		Segment->CellsOffset = Segment->PeersOffset + AlignUp(sizeof(Peer) * Options.MaxPeers, CACHELINE_SIZE);
+		Segment->CountersOffset = Segment->CellsOffset +
+			AlignUp(sizeof(Cell) * Options.MaxPeers * Options.RingSize, CACHELINE_SIZE);
+		Segment->DataOffset = Segment->CountersOffset + AlignUp(sizeof(SharedCounter) * Options.CounterCount,
+		                                                        CACHELINE_SIZE);
+
+		for (size_t i = 0; i < Options.MaxPeers; ++i)
+			new(&GetPeer(i)) Peer();
+		for (size_t i = 0; i < Options.MaxPeers * Options.RingSize; ++i)
+			new(View + Segment->CellsOffset + i * sizeof(Cell)) Cell();
+		for (uint32_t i = 0; i < Options.CounterCount; ++i)
+			new(&GetCounter(i)) SharedCounter();
+
+		Segment->Ready.store(1, std::memory_order_release);
+	}
+	else
+	{
+		while (Segment->Ready.load(std::memory_order_acquire) == 0)
+			SwitchToThread();
+
+		if (std::memcmp(Segment->Magic, SEGMENT_MAGIC, sizeof(Segment->Magic)) != 0 ||
+			Segment->Version != SEGMENT_VERSION || Segment->MaxPeers != Options.MaxPeers ||
+			Segment->RingSize != Options.RingSize || Segment->CounterCount != Options.CounterCount ||
+			Segment->DataSize != Options.DataSize)
+		{
+			Detach();
+			throw JsException(std::string("Shared job segment was created with other options ") + name);
+		}
+	}
+
+	const HANDLE process = GetCurrentProcess();
+	const auto processId = static_cast<uint32_t>(GetCurrentProcessId());
+	for (int attempt = 0; attempt < 2 && PeerIndex == SIZE_MAX; ++attempt)
+	{
+		for (size_t i = 0; i < Options.MaxPeers; ++i)
+		{
+			uint32_t expected = 0;
+			if (GetPeer(i).ProcessId.compare_exchange_strong(expected, processId, std::memory_order_acq_rel))
+			{
+				GetPeer(i).ProcessStart.store(GetProcessStart(process), std::memory_order_release);
+				PeerIndex = i;
+				break;
+			}
+		}
+
+		// Slots of crashed peers are freed by whoever notices first
+		if (PeerIndex == SIZE_MAX)
+			RecoverCrashedPeers();
+	}
+
+	if (PeerIndex == SIZE_MAX)
+	{
+		Detach();
+		throw JsException(std::string("Shared job segment has no free peer slot ") + name);
+	}
+
+	Log::Info("SharedJobHost::Attach: Attached to %s as peer %zu%s\n", name, PeerIndex, Creator ? ", created it" : "");
+}
+
+void Js::SharedJobHost::Detach()
+{
+	if (Segment != nullptr && PeerIndex != SIZE_MAX)
+	{
+		// Jobs still queued in the ring are left for the other peers
+		Peer& self = GetPeer(PeerIndex);
+		self.ProcessStart.store(0, std::memory_order_relaxed);
+		self.ProcessId.store(0, std::memory_order_release);
+		PeerIndex = SIZE_MAX;
+	}
+
+	if (View != nullptr)
+		UnmapViewOfFile(View);
+	if (Mapping != nullptr)
+		CloseHandle(Mapping);
+
+	View = nullptr;
+	Mapping = nullptr;
+	Segment = nullptr;
+}
+
+Js::SharedJobHost::Peer& Js::SharedJobHost::GetPeer(const size_t index) const
+{
+	return *reinterpret_cast<Peer*>(View + Segment->PeersOffset + index * sizeof(Peer));
+}
+
+Js::SharedJobHost::Cell& Js::SharedJobHost::GetCell(const size_t peer, const uint64_t position) const
+{
+	const size_t index = peer * Options.RingSize + static_cast<size_t>(position & RingMask);
+	return *reinterpret_cast<Cell*>(View + Segment->CellsOffset + index * sizeof(Cell));
+}
+
+Js::SharedJobHost::SharedCounter& Js::SharedJobHost::GetCounter(const uint32_t counter) const
+{
+	if (counter >= Options.CounterCount)
+		throw JsException("Invalid shared job counter");
+
+	return *reinterpret_cast<SharedCounter*>(View + Segment->CountersOffset + counter * sizeof(SharedCounter));
+}
+
+void Js::SharedJobHost::Register(const uint32_t functionId, const SharedJobFunction function)
+{
+	if (functionId >= Functions.size())
+		throw JsException("Shared job function id is out of range");
+
+	Functions[functionId] = function;
+}
+
+uint32_t Js::SharedJobHost::CreateCounter()
+{
+	for (uint32_t i = 0; i < Options.CounterCount; ++i)
+	{
+		SharedCounter& counter = GetCounter(i);
+		uint32_t expected = 0;
+		if (counter.InUse.compare_exchange_strong(expected, 1, std::memory_order_acq_rel))
+		{
+			counter.Value.store(0, std::memory_order_relaxed);
+			return i;
+		}
+	}
+
+	throw JsException("Shared job segment has no free counter");
+}
+
+void Js::SharedJobHost::ReleaseCounter(const uint32_t counter)
+{
+	GetCounter(counter).InUse.store(0, std::memory_order_release);
+}
+
+uint32_t Js::SharedJobHost::GetCounterValue(const uint32_t counter) const
+{
+	return GetCounter(counter).Value.load(std::memory_order_acquire);
+}
+
+uint64_t Js::SharedJobHost::AllocateData(const size_t size, const size_t alignment)
+{
+	uint64_t used = Segment->DataUsed.load(std::memory_order_relaxed);
+	uint64_t offset;
+	do
+	{
+		offset = AlignUp(static_cast<size_t>(used), alignment);
+		if (offset + size > Options.DataSize)
+			throw JsException("Shared job data area is full");
+	}
+	while (!Segment->DataUsed.compare_exchange_weak(used, offset + size, std::memory_order_relaxed));
+
+	return offset;
+}
+
+void* Js::SharedJobHost::GetData(const uint64_t offset)
+{
+	if (offset >= Options.DataSize)
+		throw JsException("Shared job data offset is out of range");
+
+	return View + Segment->DataOffset + offset;
+}
+
+void Js::SharedJobHost::AddJob(const SharedJob& job, const uint32_t counter)
+{
+	CheckFunction(job.FunctionId);
+	GetCounter(counter).Value.fetch_add(1, std::memory_order_relaxed);
+
+	uint32_t idleRounds = 0;
+	while (!TryPublish(job, counter))
+	{
+		if (!RunOne())
+			Idle(idleRounds++);
+	}
+}
+
+void Js::SharedJobHost::AddJobs(const std::vector<SharedJob>& jobs, const uint32_t counter)
+{
+	for (const SharedJob& job : jobs)
+		CheckFunction(job.FunctionId);
+	GetCounter(counter).Value.fetch_add(static_cast<uint32_t>(jobs.size()), std::memory_order_relaxed);
+
+	for (const SharedJob& job : jobs)
+	{
+		uint32_t idleRounds = 0;
+		while (!TryPublish(job, counter))
+		{
+			if (!RunOne())
+				Idle(idleRounds++);
+		}
+	}
+}
+
+void Js::SharedJobHost::Wait(const uint32_t counter)
+{
+	uint32_t idleRounds = 0;
+	while (GetCounter(counter).Value.load(std::memory_order_acquire) != 0)
+	{
+		if (RunOne())
+		{
+			idleRounds = 0;
+			continue;
+		}
+		Idle(idleRounds++);
+	}
+}
+
+bool Js::SharedJobHost::IsRegistered(const uint32_t functionId) const
+{
+	return functionId < Functions.size() && Functions[functionId] != nullptr;
+}
+
+void Js::SharedJobHost::CheckFunction(const uint32_t functionId) const
+{
+	if (!IsRegistered(functionId))
+		throw JsException("Shared job function is not registered");
+}
+
+bool Js::SharedJobHost::TryPublish(const SharedJob& job, const uint32_t counter)
+{
+	// Every worker of this process publishes to the same ring, a position belongs to whoever moved Head past it
+	Peer& self = GetPeer(PeerIndex);
+	uint64_t head = self.Head.load(std::memory_order_relaxed);
+	Cell* cell;
+	for (;;)
+	{
+		cell = &GetCell(PeerIndex, head);
+		if (GetStatus(cell->State.load(std::memory_order_acquire)) != FREE)
+			return false;
+		if (self.Head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+			break;
+	}
+
+	cell->FunctionId = job.FunctionId;
+	cell->Counter = counter;
+	cell->Offset = job.Offset;
+	cell->State.store(MakeState(head, QUEUED, 0), std::memory_order_release);
+	return true;
+}
+
+bool Js::SharedJobHost::TryClaim(const size_t peer, Cell*& cell, uint64_t& position)
+{
+	Peer& owner = GetPeer(peer);
+	const uint64_t head = owner.Head.load(std::memory_order_acquire);
+	uint64_t tail = owner.Tail.load(std::memory_order_relaxed);
+
+	// A position a crashed publisher claimed but never wrote holds Tail back until the ring wraps past it
+	if (head - tail > Options.RingSize)
+	{
+		const uint64_t wrapped = head - Options.RingSize;
+		owner.Tail.compare_exchange_strong(tail, wrapped, std::memory_order_relaxed);
+		tail = wrapped;
+	}
+
+	bool advance = true;
+	for (uint64_t p = tail; p < head; ++p)
+	{
+		Cell& candidate = GetCell(peer, p);
+		uint64_t state = candidate.State.load(std::memory_order_acquire);
+		// A job of a function this process never registered stays queued for the peers that did
+		if (state == MakeState(p, QUEUED, 0) && IsRegistered(candidate.FunctionId) &&
+			candidate.State.compare_exchange_strong(state, MakeState(p, RUNNING, PeerIndex), std::memory_order_acquire))
+		{
+			cell = &candidate;
+			position = p;
+			return true;
+		}
+
+		// Only finished positions are skipped for good, a running job may still be queued again by recovery
+		const uint64_t written = state >> 16;
+		const bool finished = written > p + 1 || (written == p + 1 && GetStatus(state) == FREE);
+		if (advance && finished)
+		{
+			uint64_t expected = p;
+			owner.Tail.compare_exchange_strong(expected, p + 1, std::memory_order_relaxed);
+		}
+		else
+		{
+			advance = false;
+		}
+	}
+	return false;
+}
+
+bool Js::SharedJobHost::RunOne()
+{
+	Cell* cell;
+	uint64_t position;
+	if (TryClaim(PeerIndex, cell, position))
+	{
+		Execute(*cell, position);
+		return true;
+	}
+
+	// Rings of detached and crashed peers are drained the same way
+	for (size_t i = 1; i < Options.MaxPeers; ++i)
+	{
+		const size_t peer = (PeerIndex + i) % Options.MaxPeers;
+		if (GetPeer(peer).Head.load(std::memory_order_relaxed) == 0 || !TryClaim(peer, cell, position))
+			continue;
+
+		Stolen.fetch_add(1, std::memory_order_relaxed);
+		Execute(*cell, position);
+		return true;
+	}
+	return false;
+}
+
+void Js::SharedJobHost::Execute(Cell& cell, const uint64_t position)
+{
+	const uint32_t functionId = cell.FunctionId;
+	const uint32_t counter = cell.Counter;
+	const uint64_t offset = cell.Offset;
+
+	Functions[functionId](*System, *this, offset);
+
+	// Whoever frees the cell decrements, this peer or recovery once it is gone
+	uint64_t done = MakeState(position, DONE, PeerIndex);
+	cell.State.store(done, std::memory_order_release);
+	if (cell.State.compare_exchange_strong(done, MakeState(position, FREE, 0), std::memory_order_acq_rel))
+		GetCounter(counter).Value.fetch_sub(1, std::memory_order_acq_rel);
+	Executed.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Js::SharedJobHost::IsPeerAlive(const Peer& peer) const
+{
+	const uint32_t processId = peer.ProcessId.load(std::memory_order_acquire);
+	const uint64_t processStart = peer.ProcessStart.load(std::memory_order_acquire);
+
+	const HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, processId);
+	if (process == nullptr)
+		return GetLastError() != ERROR_INVALID_PARAMETER;
+
+	// A peer that died while attaching never stored its start time, so only its process id is checked
+	const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT &&
+		(processStart == 0 || GetProcessStart(process) == processStart);
+	CloseHandle(process);
+	return alive;
+}
+
+size_t Js::SharedJobHost::RecoverCrashedPeers()
+{
+	size_t recovered = 0;
+	for (size_t i = 0; i < Options.MaxPeers; ++i)
+	{
+		if (i == PeerIndex)
+			continue;
+
+		Peer& peer = GetPeer(i);
+		uint32_t processId = peer.ProcessId.load(std::memory_order_acquire);
+		if (processId == 0 || processId == RECOVERING || IsPeerAlive(peer))
+			continue;
+		if (!peer.ProcessId.compare_exchange_strong(processId, RECOVERING, std::memory_order_acq_rel))
+			continue;
+
+		uint64_t requeued = 0;
+		for (size_t ring = 0; ring < Options.MaxPeers; ++ring)
+		{
+			for (uint64_t slot = 0; slot < Options.RingSize; ++slot)
+			{
+				Cell& cell = GetCell(ring, slot);
+				uint64_t state = cell.State.load(std::memory_order_acquire);
+				const CellStatus status = GetStatus(state);
+				if ((status != RUNNING && status != DONE) || GetRunningPeer(state) != i)
+					continue;
+
+				const uint64_t position = (state >> 16) - 1;
+				if (status == DONE)
+				{
+					// Finished but not freed, so the peer never decremented and the one freeing the cell does
+					const uint32_t counter = cell.Counter;
+					if (cell.State.compare_exchange_strong(state, MakeState(position, FREE, 0), std::memory_order_acq_rel))
+						GetCounter(counter).Value.fetch_sub(1, std::memory_order_acq_rel);
+					continue;
+				}
+
+				if (cell.State.compare_exchange_strong(state, MakeState(position, QUEUED, 0), std::memory_order_acq_rel))
+					++requeued;
+			}
+		}
+
+		Segment->RecoveredJobs.fetch_add(requeued, std::memory_order_relaxed);
+		Log::Warning("SharedJobHost::RecoverCrashedPeers: Peer %zu (process %u) is gone, requeued %llu jobs\n", i,
+		             processId, requeued);
+
+		peer.ProcessStart.store(0, std::memory_order_relaxed);
+		peer.ProcessId.store(0, std::memory_order_release);
+		++recovered;
+	}
+	return recovered;
+}
+
+uint64_t Js::SharedJobHost::GetRecoveredJobCount() const
+{
+	return Segment->RecoveredJobs.load(std::memory_order_relaxed);
+}
+
+size_t Js::SharedJobHost::GetPeerCount() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < Options.MaxPeers; ++i)
+	{
+		const uint32_t processId = GetPeer(i).ProcessId.load(std::memory_order_relaxed);
+		if (processId != 0 && processId != RECOVERING)
+			++count;
+	}
+	return count;
+}
+
+void Js::SharedJobHost::Idle(const uint32_t idleRounds)
+{
+	const uint64_t now = GetTickCount64();
+	uint64_t last = LastRecovery.load(std::memory_order_relaxed);
+	if (now - last >= Options.RecoveryIntervalMs &&
+		LastRecovery.compare_exchange_strong(last, now, std::memory_order_relaxed))
+	{
+		RecoverCrashedPeers();
+	}
+
+	// Other processes cannot wake a fiber here, so idle pumps poll, sleeping lets this process run local jobs
+	if (idleRounds < IDLE_SPIN_ROUNDS)
+		_mm_pause();
+	else
+		SleepFor(*System, 1);
+}
+
+void Js::SharedJobHost::Serve(const size_t pumpCount)
+{
+	Stopping.store(false, std::memory_order_relaxed);
+
+	std::vector<Job> jobs;
+	for (size_t i = 0; i < pumpCount; ++i)
+	{
+		jobs.emplace_back(Pump, this);
+		jobs.back().Tag = "SharedJobPump";
+	}
+	System->AddJobs(jobs, &Pumps);
+}
+
+void Js::SharedJobHost::Stop()
+{
+	Stopping.store(true, std::memory_order_relaxed);
+	System->Wait(Pumps, 0);
+}
+
+void Js::SharedJobHost::RequestShutdown()
+{
+	Segment->Shutdown.store(1, std::memory_order_release);
+}
+
+bool Js::SharedJobHost::IsShutdownRequested() const
+{
+	return Segment->Shutdown.load(std::memory_order_acquire) != 0;
+}
+
+void Js::SharedJobHost::WaitForShutdown()
+{
+	while (!IsShutdownRequested())
+		SleepFor(*System, 1);
+}
+
+void Js::SharedJobHost::Pump(JobSystem&, void* data)
+{
+	auto* host = static_cast<SharedJobHost*>(data);
+
+	uint32_t idleRounds = 0;
+	while (!host->Stopping.load(std::memory_order_relaxed) && !host->IsShutdownRequested())
+	{
+		if (host->RunOne())
+		{
+			idleRounds = 0;
+			continue;
+		}
+		host->Idle(idleRounds++);
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Counter.h"
+
+namespace Js
+{
+	class JobSystem;
+	class SharedJobHost;
+
+	// Shared jobs name their function by an id every process registers and their input by an offset into the
+	// segment's data area, so they can run in any process attached to it
+	using SharedJobFunction = void (*)(JobSystem& system, SharedJobHost& host, uint64_t offset);
+
+	struct SharedJob
+	{
+		uint32_t FunctionId = 0;
+		uint64_t Offset = 0;
+	};
+
+	struct SharedJobOptions
+	{
+		// Must match in every process attaching to the segment
+		size_t MaxPeers = 16;
+		// Jobs each peer can have published, rounded up to a power of two
+		size_t RingSize = 1024;
+		size_t CounterCount = 256;
+		size_t DataSize = 16ull << 20;
+		size_t MaxFunctions = 256;
+		// How often idle pumps look for crashed peers
+		uint32_t RecoveryIntervalMs = 100;
+	};
+
+	// Runs jobs across processes through a named shared memory segment. Every attached process is a peer with a
+	// ring of published jobs in the segment, its pumps run jobs from its own ring and steal from the others. The
+	// segment only holds offsets, so each process may map it at a different address. A peer whose process exited
+	// is detected by its process handle, the jobs it was running are queued again, the ones it finished without
+	// counting are counted and its ring stays open to the others, so jobs run at least once even when a peer crashes.
+	// A peer dying between freeing a finished job's cell and decrementing its counter leaves the counter one short,
+	// a Wait on it then never returns, but a counter is never decremented twice
+	class SharedJobHost
+	{
+	public:
+		// Creates the segment or attaches to the one of that name
+		SharedJobHost(JobSystem& system, const char* name, const SharedJobOptions& options = SharedJobOptions());
+		SharedJobHost(const SharedJobHost&) = delete;
+		~SharedJobHost();
+
+		// Every process must register the same function under the same id before its pumps start
+		void Register(uint32_t functionId, SharedJobFunction function);
+
+		// Counters live in the segment, any peer may wait on them
+		uint32_t CreateCounter();
+		void ReleaseCounter(uint32_t counter);
+		uint32_t GetCounterValue(uint32_t counter) const;
+
+		// Publishes to this peer's ring, runs shared jobs while the ring is full. Throws for a function id this
+		// process has not registered
+		void AddJob(const SharedJob& job, uint32_t counter);
+		void AddJobs(const std::vector<SharedJob>& jobs, uint32_t counter);
+		// Runs shared jobs until the counter reaches zero
+		void Wait(uint32_t counter);
+
+		// Bump allocation in the data area, released only with the segment
+		uint64_t AllocateData(size_t size, size_t alignment = alignof(std::max_align_t));
+		void* GetData(uint64_t offset);
+
+		// Starts pumps, jobs of this JobSystem that run shared jobs until Stop or a shutdown request
+		void Serve(size_t pumpCount);
+		void Stop();
+		// Stops the pumps of every peer
+		void RequestShutdown();
+		bool IsShutdownRequested() const;
+		void WaitForShutdown();
+
+		bool IsCreator() const { return Creator; }
+		size_t GetPeerIndex() const { return PeerIndex; }
+		size_t GetPeerCount() const;
+		// Requeues the running jobs of peers whose process is gone, returns how many peers were recovered
+		size_t RecoverCrashedPeers();
+		uint64_t GetExecutedCount() const { return Executed.load(std::memory_order_relaxed); }
+		uint64_t GetStolenCount() const { return Stolen.load(std::memory_order_relaxed); }
+		// Jobs requeued by any peer since the segment was created
+		uint64_t GetRecoveredJobCount() const;
+
+	private:
+		struct Header;
+		struct Peer;
+		struct Cell;
+		struct SharedCounter;
+
+		JobSystem* System;
+		SharedJobOptions Options;
+		bool Creator = false;
+		size_t PeerIndex = SIZE_MAX;
+		uint64_t RingMask = 0;
+
+		void* Mapping = nullptr;
+		char* View = nullptr;
+		Header* Segment = nullptr;
+
+		std::vector<SharedJobFunction> Functions;
+
+		std::atomic_bool Stopping{false};
+		Counter Pumps;
+		std::atomic<uint64_t> LastRecovery{0};
+
+		std::atomic<uint64_t> Executed{0};
+		std::atomic<uint64_t> Stolen{0};
+
+		static size_t GetSegmentSize(const SharedJobOptions& options);
+
+		void Attach(const char* name);
+		void Detach();
+		Peer& GetPeer(size_t index) const;
+		Cell& GetCell(size_t peer, uint64_t position) const;
+		SharedCounter& GetCounter(uint32_t counter) const;
+
+		bool IsRegistered(uint32_t functionId) const;
+		void CheckFunction(uint32_t functionId) const;
+		bool TryPublish(const SharedJob& job, uint32_t counter);
+		bool TryClaim(size_t peer, Cell*& cell, uint64_t& position);
+		// Runs one job of this peer's ring or, failing that, stolen from another
+		bool RunOne();
+		void Execute(Cell& cell, uint64_t position);
+		bool IsPeerAlive(const Peer& peer) const;
+		void Idle(uint32_t idleRounds);
+
+		static void Pump(JobSystem& system, void* data);
+	};
+}
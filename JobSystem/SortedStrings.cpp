@@ -0,0 +1,376 @@
+#include "SortedStrings.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Counter.h"
+#include "File.h"
+#include "Job.h"
+#include "JobSystem.h"
+#include "JSException.h"
+#include "WindowsMinimal.h"
+
+namespace
+{
+	constexpr size_t MAX_IO_SIZE = 1u << 30;
+	constexpr size_t WRITE_BUFFER_SIZE = 1u << 20;
+	constexpr size_t INDEX_KEY_SIZE = 8;
+	constexpr char SORTED_STRINGS_MAGIC[8] = {'J', 'S', 'S', 'T', 'R', 'S', '0', '1'};
+
+	struct Header
+	{
+		char Magic[8];
+		uint64_t Count;
+		uint64_t IndexStride;
+		uint64_t IndexCount;
+		uint64_t OffsetsOffset;
+		uint64_t IndexOffset;
+		uint64_t BlobOffset;
+		uint64_t BlobSize;
+	};
+
+	static_assert(sizeof(Header) == 64, "Sorted strings header layout changed");
+
+	struct PartitionData
+	{
+		const std::vector<std::string>* Strings;
+		size_t First;
+		size_t Last;
+		size_t IndexStride;
+
+		// Filled by MeasurePartition
+		uint64_t BlobSize = 0;
+		bool Sorted = true;
+
+		// Set before WritePartition
+		Js::File* Output = nullptr;
+		const Header* Layout = nullptr;
+		uint64_t BlobOffset = 0;
+	};
+
+	void WriteAll(Js::File& file, const char* data, size_t size, uint64_t offset)
+	{
+		for (size_t position = 0; position < size;)
+		{
+			const auto chunk = static_cast<uint32_t>(std::min(MAX_IO_SIZE, size - position));
+			const uint32_t written = file.Write(data + position, chunk, offset);
+			if (written == 0)
+				throw Js::JsException("Failed to write sorted strings");
+
+			position += written;
+			offset += written;
+		}
+	}
+
+	void MeasurePartition(Js::JobSystem&, void* data)
+	{
+		auto* partition = static_cast<PartitionData*>(data);
+		const std::vector<std::string>& strings = *partition->Strings;
+
+		// Comparing the first string with the one before it also checks the boundary with the previous partition
+		for (size_t i = partition->First; i < partition->Last; ++i)
+		{
+			partition->BlobSize += strings[i].size();
+			if (i != 0 && strings[i] < strings[i - 1])
+				partition->Sorted = false;
+		}
+	}
+
+	void WritePartition(Js::JobSystem&, void* data)
+	{
+		auto* partition = static_cast<PartitionData*>(data);
+		const std::vector<std::string>& strings = *partition->Strings;
+		const Header& layout = *partition->Layout;
+
+		// The last partition also writes the end offset of the blob
+		const bool last = partition->Last == strings.size();
+		std::vector<uint64_t> offsets;
+		offsets.reserve(partition->Last - partition->First + (last ? 1 : 0));
+
+		const size_t stride = partition->IndexStride;
+		const size_t firstEntry = (partition->First + stride - 1) / stride;
+		std::vector<char> index;
+
+		std::vector<char> buffer;
+		buffer.reserve(WRITE_BUFFER_SIZE);
+		uint64_t blobOffset = partition->BlobOffset;
+		uint64_t bufferOffset = layout.BlobOffset + blobOffset;
+
+		for (size_t i = partition->First; i < partition->Last; ++i)
+		{
+			const std::string& value = strings[i];
+			offsets.push_back(blobOffset);
+			blobOffset += value.size();
+
+			if (i % stride == 0)
+			{
+				char key[INDEX_KEY_SIZE] = {};
+				std::memcpy(key, value.data(), std::min(value.size(), INDEX_KEY_SIZE));
+				index.insert(index.end(), key, key + INDEX_KEY_SIZE);
+			}
+
+			if (buffer.size() + value.size() > WRITE_BUFFER_SIZE && !buffer.empty())
+			{
+				WriteAll(*partition->Output, buffer.data(), buffer.size(), bufferOffset);
+				bufferOffset += buffer.size();
+				buffer.clear();
+			}
+			buffer.insert(buffer.end(), value.begin(), value.end());
+		}
+
+		if (last)
+			offsets.push_back(blobOffset);
+
+		WriteAll(*partition->Output, buffer.data(), buffer.size(), bufferOffset);
+		WriteAll(*partition->Output, reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t),
+		         layout.OffsetsOffset + partition->First * sizeof(uint64_t));
+		WriteAll(*partition->Output, index.data(), index.size(), layout.IndexOffset + firstEntry * INDEX_KEY_SIZE);
+	}
+}
+
+void Js::WriteSortedStrings(JobSystem& system, const std::vector<std::string>& strings, const char* path,
+                            const SortedStringOptions& options)
+{
+	if (options.IndexStride == 0)
+		throw JsException("Sorted strings index stride must not be 0");
+
+	const size_t partitionCount = std::max<size_t>(1, std::min(strings.size(), options.Partitions != 0
+		                                                                               ? options.Partitions
+		                                                                               : system.GetThreadCount() * 2));
+
+	std::vector<PartitionData> partitions(partitionCount);
+	std::vector<Job> jobs;
+	for (size_t i = 0; i < partitionCount; ++i)
+	{
+		PartitionData& partition = partitions[i];
+		partition.Strings = &strings;
+		partition.First = i * strings.size() / partitionCount;
+		partition.Last = (i + 1) * strings.size() / partitionCount;
+		partition.IndexStride = options.IndexStride;
+		jobs.emplace_back(MeasurePartition, &partition);
+	}
+
+	Counter counter;
+	system.AddJobs(jobs, &counter);
+	system.Wait(counter, 0);
+
+	Header header = {};
+	std::memcpy(header.Magic, SORTED_STRINGS_MAGIC, sizeof(header.Magic));
+	header.Count = strings.size();
+	header.IndexStride = options.IndexStride;
+	header.IndexCount = (strings.size() + options.IndexStride - 1) / options.IndexStride;
+	header.OffsetsOffset = sizeof(Header);
+	header.IndexOffset = header.OffsetsOffset + (header.Count + 1) * sizeof(uint64_t);
+	header.BlobOffset = header.IndexOffset + header.IndexCount * INDEX_KEY_SIZE;
+
+	for (PartitionData& partition : partitions)
+	{
+		if (!partition.Sorted)
+			throw JsException("Strings are not sorted");
+
+		partition.BlobOffset = header.BlobSize;
+		header.BlobSize += partition.BlobSize;
+	}
+
+	File output;
+	output.Open(system, path, FileAccess::Write);
+	WriteAll(output, reinterpret_cast<const char*>(&header), sizeof(header), 0);
+
+	jobs.clear();
+	for (PartitionData& partition : partitions)
+	{
+		partition.Output = &output;
+		partition.Layout = &header;
+		jobs.emplace_back(WritePartition, &partition);
+	}
+
+	// Every partition writes its own slices of the offset table, the index and the blob
+	system.AddJobs(jobs, &counter);
+	system.Wait(counter, 0);
+}
+
+Js::SortedStringReader::SortedStringReader(const char* path)
+{
+	Open(path);
+}
+
+Js::SortedStringReader::~SortedStringReader()
+{
+	Close();
+}
+
+void Js::SortedStringReader::Open(const char* path)
+{
+	Close();
+
+	const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+	                                nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw JsException(std::string("Failed to open file ") + path);
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || static_cast<uint64_t>(size.QuadPart) < sizeof(Header))
+	{
+		CloseHandle(file);
+		throw JsException(std::string("Not a sorted strings file ") + path);
+	}
+
+	// The mapping keeps the file open
+	Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (Mapping == nullptr)
+		throw JsException(std::string("Failed to map file ") + path);
+
+	View = static_cast<const char*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (View == nullptr)
+	{
+		Close();
+		throw JsException(std::string("Failed to map file ") + path);
+	}
+
+	Header header;
+	std::memcpy(&header, View, sizeof(header));
+	const auto fileSize = static_cast<uint64_t>(size.QuadPart);
+	const bool valid = std::memcmp(header.Magic, SORTED_STRINGS_MAGIC, sizeof(header.Magic)) == 0
+		&& header.IndexStride != 0
+		&& header.IndexCount == (header.Count + header.IndexStride - 1) / header.IndexStride
+		&& header.OffsetsOffset == sizeof(Header)
+		&& header.IndexOffset == header.OffsetsOffset + (header.Count + 1) * sizeof(uint64_t)
+		&& header.BlobOffset == header.IndexOffset + header.IndexCount * INDEX_KEY_SIZE
+		&& header.BlobOffset <= fileSize && header.BlobSize == fileSize - header.BlobOffset;
+	if (!valid)
+	{
+		Close();
+		throw JsException(std::string("Not a sorted strings file ") + path);
+	}
+
+	Count = static_cast<size_t>(header.Count);
+	IndexStride = static_cast<size_t>(header.IndexStride);
+	IndexCount = static_cast<size_t>(header.IndexCount);
+	Offsets = reinterpret_cast<const uint64_t*>(View + header.OffsetsOffset);
+	Index = View + header.IndexOffset;
+	Blob = View + header.BlobOffset;
+
+	if (Offsets[Count] != header.BlobSize)
+	{
+		Close();
+		throw JsException(std::string("Not a sorted strings file ") + path);
+	}
+}
+
+void Js::SortedStringReader::Close()
+{
+	if (View != nullptr)
+		UnmapViewOfFile(View);
+	if (Mapping != nullptr)
+		CloseHandle(Mapping);
+
+	Mapping = nullptr;
+	View = nullptr;
+	Count = 0;
+	IndexStride = 0;
+	IndexCount = 0;
+	Offsets = nullptr;
+	Index = nullptr;
+	Blob = nullptr;
+}
+
+Js::StringRef Js::SortedStringReader::Get(const size_t index) const
+{
+	if (index >= Count)
+		throw JsException("Sorted string index out of range");
+
+	StringRef value;
+	value.Data = Blob + Offsets[index];
+	value.Size = static_cast<size_t>(Offsets[index + 1] - Offsets[index]);
+	return value;
+}
+
+int Js::SortedStringReader::Compare(const StringRef value, const char* key, const size_t keySize)
+{
+	const int result = std::memcmp(value.Data, key, std::min(value.Size, keySize));
+	if (result != 0)
+		return result;
+	return value.Size < keySize ? -1 : value.Size > keySize ? 1 : 0;
+}
+
+size_t Js::SortedStringReader::LowerBound(const char* key, const size_t keySize) const
+{
+	char probe[INDEX_KEY_SIZE] = {};
+	std::memcpy(probe, key, std::min(keySize, INDEX_KEY_SIZE));
+
+	// Padded prefixes never decrease along sorted strings, so an entry below the probe is a string below the key
+	// and an entry above it a string above the key. Only the strings between those two entries are searched
+	size_t below = 0;
+	size_t above = IndexCount;
+	while (below < above)
+	{
+		const size_t middle = below + (above - below) / 2;
+		if (std::memcmp(Index + middle * INDEX_KEY_SIZE, probe, INDEX_KEY_SIZE) < 0)
+			below = middle + 1;
+		else
+			above = middle;
+	}
+	size_t first = below == 0 ? 0 : (below - 1) * IndexStride + 1;
+
+	above = IndexCount;
+	while (below < above)
+	{
+		const size_t middle = below + (above - below) / 2;
+		if (std::memcmp(Index + middle * INDEX_KEY_SIZE, probe, INDEX_KEY_SIZE) <= 0)
+			below = middle + 1;
+		else
+			above = middle;
+	}
+	size_t last = below == IndexCount ? Count : below * IndexStride;
+
+	while (first < last)
+	{
+		const size_t middle = first + (last - first) / 2;
+		if (Compare(Get(middle), key, keySize) < 0)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+	return first;
+}
+
+size_t Js::SortedStringReader::Find(const char* key, const size_t keySize) const
+{
+	const size_t index = LowerBound(key, keySize);
+	if (index == Count || Compare(Get(index), key, keySize) != 0)
+		return NOT_FOUND;
+	return index;
+}
+
+std::pair<size_t, size_t> Js::SortedStringReader::FindPrefix(const char* prefix, const size_t prefixSize) const
+{
+	const size_t first = LowerBound(prefix, prefixSize);
+
+	// The strings starting with the prefix end at the first one whose leading bytes compare above it, an index
+	// entry whose leading bytes do already bounds the search
+	const size_t keyBytes = std::min(prefixSize, INDEX_KEY_SIZE);
+	size_t below = first / IndexStride;
+	size_t above = IndexCount;
+	while (below < above)
+	{
+		const size_t middle = below + (above - below) / 2;
+		if (std::memcmp(Index + middle * INDEX_KEY_SIZE, prefix, keyBytes) <= 0)
+			below = middle + 1;
+		else
+			above = middle;
+	}
+
+	size_t begin = first;
+	size_t end = below == IndexCount ? Count : std::max(first, below * IndexStride);
+	while (begin < end)
+	{
+		const size_t middle = begin + (end - begin) / 2;
+		const StringRef value = Get(middle);
+		if (value.Size >= prefixSize && std::memcmp(value.Data, prefix, prefixSize) == 0)
+			begin = middle + 1;
+		else
+			end = middle;
+	}
+	return std::make_pair(first, begin);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Js
+{
+	class JobSystem;
+
+	// Binary format for a sorted list of strings, searched in place once mapped. A 64 byte header is followed by a
+	// table of Count + 1 blob offsets, a sparse index holding the first 8 bytes of every IndexStride'th string padded
+	// with zeros, and the blob of all strings without separators. Integers are little endian
+	struct SortedStringOptions
+	{
+		// Strings per sparse index entry, a lookup binary searches the index and then at most this many offsets
+		uint32_t IndexStride = 64;
+		// Number of writer jobs, 0 uses twice the thread count
+		size_t Partitions = 0;
+	};
+
+	struct StringRef
+	{
+		const char* Data = nullptr;
+		size_t Size = 0;
+
+		std::string ToString() const { return std::string(Data, Size); }
+	};
+
+	// Writes strings, which have to be sorted, to path. Partitions are sized, laid out and written by parallel jobs
+	void WriteSortedStrings(JobSystem& system, const std::vector<std::string>& strings, const char* path,
+	                        const SortedStringOptions& options = SortedStringOptions());
+
+	// Read only view of a file written by WriteSortedStrings, mapped into memory so opening costs no parsing and
+	// strings are returned pointing into the mapping
+	class SortedStringReader
+	{
+	public:
+		static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+		SortedStringReader() = default;
+		explicit SortedStringReader(const char* path);
+		SortedStringReader(const SortedStringReader&) = delete;
+		~SortedStringReader();
+
+		void Open(const char* path);
+		void Close();
+		bool IsOpen() const { return View != nullptr; }
+
+		size_t GetCount() const { return Count; }
+		StringRef Get(size_t index) const;
+
+		// Index of the first string not less than key, GetCount when there is none
+		size_t LowerBound(const char* key, size_t keySize) const;
+		size_t LowerBound(const std::string& key) const { return LowerBound(key.data(), key.size()); }
+		// Index of the string equal to key or NOT_FOUND
+		size_t Find(const char* key, size_t keySize) const;
+		size_t Find(const std::string& key) const { return Find(key.data(), key.size()); }
+		// Indices [first, last) of the strings starting with prefix
+		std::pair<size_t, size_t> FindPrefix(const char* prefix, size_t prefixSize) const;
+		std::pair<size_t, size_t> FindPrefix(const std::string& prefix) const
+		{
+			return FindPrefix(prefix.data(), prefix.size());
+		}
+
+	private:
+		void* Mapping = nullptr;
+		const char* View = nullptr;
+
+		size_t Count = 0;
+		size_t IndexStride = 0;
+		size_t IndexCount = 0;
+		const uint64_t* Offsets = nullptr;
+		const char* Index = nullptr;
+		const char* Blob = nullptr;
+
+		static int Compare(StringRef value, const char* key, size_t keySize);
+	};
+}
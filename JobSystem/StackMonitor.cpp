@@ -0,0 +1,183 @@
+#include "StackMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "WindowsMinimal.h"
+
+#include "JobSystem.h"
+#include "Log.h"
+#include "TagRegistry.h"
+
+namespace
+{
+	constexpr uint64_t CANARY = 0x57AC57AC57AC57ACull;
+	// Left unpainted below the painting frame so PaintRange never writes over its own frame
+	constexpr size_t PAINT_MARGIN = 4096;
+
+	constexpr double RECOMMENDED_PERCENTILE = 0.9999;
+	constexpr double RECOMMENDED_MARGIN = 1.25;
+	constexpr size_t RECOMMENDED_ROUNDING = 64ull << 10;
+
+	void AtomicMax(std::atomic<size_t>& target, const size_t value)
+	{
+		size_t current = target.load(std::memory_order_relaxed);
+		while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+
+	NT_TIB* GetCurrentTib()
+	{
+		return reinterpret_cast<NT_TIB*>(NtCurrentTeb());
+	}
+}
+
+Js::StackMonitor::StackMonitor(const Options& options, const TagRegistry& tags) :
+	Tags(tags),
+	Enabled(options.StackPainting),
+	StackSize(GetStackSize(options)),
+	StackSizeFile(options.StackSizeFile),
+	Stacks(options.StackPainting ? options.FiberCount : 0),
+	TagStacks(options.StackPainting ? TagRegistry::MAX_TAGS : 0),
+	// Stacks can grow past the committed size into their reservation
+	UsageBuckets(options.StackPainting ? 2 * StackSize / BUCKET_SIZE + 1 : 0)
+{
+}
+
+size_t Js::StackMonitor::GetStackSize(const Options& options)
+{
+	const size_t configured = options.FiberStackSize != 0 ? options.FiberStackSize : Fiber::DEFAULT_STACK_SIZE;
+	if (options.StackSizeFile.empty())
+		return configured;
+
+	std::ifstream file(options.StackSizeFile);
+	size_t saved = 0;
+	if (!(file >> saved) || saved == 0)
+		return configured;
+
+	Log::Info("StackMonitor::GetStackSize: Using stack size %zu from %s\n", saved, options.StackSizeFile.c_str());
+	return saved;
+}
+
+void Js::StackMonitor::PaintRange(char* from, char* to)
+{
+	auto word = reinterpret_cast<uint64_t*>(from);
+	const auto end = reinterpret_cast<uint64_t*>(reinterpret_cast<uintptr_t>(to) & ~static_cast<uintptr_t>(7));
+	for (; word < end; ++word)
+		*word = CANARY;
+}
+
+void Js::StackMonitor::Paint(const uint16_t fiberIndex)
+{
+	// The committed part of the stack, the guard page and reservation below it must not be touched
+	const NT_TIB* tib = GetCurrentTib();
+	FiberStack& stack = Stacks[fiberIndex];
+	stack.Low = static_cast<char*>(tib->StackLimit);
+	stack.High = static_cast<char*>(tib->StackBase);
+
+	char marker = 0;
+	PaintRange(stack.Low, &marker - PAINT_MARGIN);
+}
+
+void Js::StackMonitor::Measure(const uint16_t fiberIndex, const size_t tagIndex)
+{
+	FiberStack& stack = Stacks[fiberIndex];
+
+	// Jobs run inline by a thread fiber, such as the main thread inside Wait, are not on a painted stack
+	char marker = 0;
+	if (&marker < stack.Low || &marker >= stack.High)
+		return;
+
+	auto word = reinterpret_cast<const uint64_t*>(stack.Low);
+	const auto end = reinterpret_cast<const uint64_t*>(stack.High);
+	while (word != end && *word == CANARY)
+		++word;
+
+	const auto dirty = reinterpret_cast<const char*>(word);
+	const size_t used = static_cast<size_t>(stack.High - dirty);
+
+	AtomicMax(stack.HighWaterMark, used);
+	AtomicMax(TagStacks[tagIndex].HighWaterMark, used);
+	TagStacks[tagIndex].JobCount.fetch_add(1, std::memory_order_relaxed);
+
+	// A job that dirtied the lowest painted word may have grown the stack past it, so the usage is a lower bound
+	const bool overflowed = dirty == stack.Low;
+	const size_t bucket = overflowed ? UsageBuckets.size() - 1 : std::min(used / BUCKET_SIZE, UsageBuckets.size() - 1);
+	UsageBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	if (overflowed)
+	{
+		Log::Warning("StackMonitor::Measure: Fiber %d used at least %zu bytes of stack\n", fiberIndex, used);
+		stack.Low = static_cast<char*>(GetCurrentTib()->StackLimit);
+		PaintRange(stack.Low, &marker - PAINT_MARGIN);
+		return;
+	}
+
+	// Everything below the dirty word is still painted
+	PaintRange(const_cast<char*>(dirty), &marker - PAINT_MARGIN);
+}
+
+size_t Js::StackMonitor::GetFiberHighWaterMark(const uint16_t fiberIndex) const
+{
+	if (fiberIndex >= Stacks.size())
+		return 0;
+
+	return Stacks[fiberIndex].HighWaterMark.load(std::memory_order_relaxed);
+}
+
+std::vector<Js::TagStackUsage> Js::StackMonitor::GetTagUsage() const
+{
+	std::vector<TagStackUsage> usage;
+	for (size_t i = 0; i < TagStacks.size(); ++i)
+	{
+		const uint64_t jobCount = TagStacks[i].JobCount.load(std::memory_order_relaxed);
+		if (jobCount == 0)
+			continue;
+
+		usage.push_back(TagStackUsage{Tags.GetTag(i), TagStacks[i].HighWaterMark.load(std::memory_order_relaxed), jobCount});
+	}
+	return usage;
+}
+
+size_t Js::StackMonitor::GetUsagePercentile(const double fraction) const
+{
+	uint64_t total = 0;
+	for (const auto& bucket : UsageBuckets)
+		total += bucket.load(std::memory_order_relaxed);
+	if (total == 0)
+		return 0;
+
+	const auto target = static_cast<uint64_t>(std::ceil(static_cast<double>(total) * fraction));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < UsageBuckets.size(); ++i)
+	{
+		seen += UsageBuckets[i].load(std::memory_order_relaxed);
+		if (seen >= target)
+			return (i + 1) * BUCKET_SIZE;
+	}
+	return UsageBuckets.size() * BUCKET_SIZE;
+}
+
+size_t Js::StackMonitor::GetRecommendedStackSize() const
+{
+	const size_t percentile = GetUsagePercentile(RECOMMENDED_PERCENTILE);
+	if (percentile == 0)
+		return StackSize;
+
+	const auto withMargin = static_cast<size_t>(static_cast<double>(percentile) * RECOMMENDED_MARGIN);
+	const size_t rounded = (withMargin + RECOMMENDED_ROUNDING - 1) / RECOMMENDED_ROUNDING * RECOMMENDED_ROUNDING;
+	return std::max(rounded, RECOMMENDED_ROUNDING);
+}
+
+void Js::StackMonitor::SaveRecommendation() const
+{
+	const size_t recommended = GetRecommendedStackSize();
+	Log::Info("StackMonitor::SaveRecommendation: Stack size %zu, recommended %zu\n", StackSize, recommended);
+	if (StackSizeFile.empty())
+		return;
+
+	std::ofstream file(StackSizeFile, std::ios::trunc);
+	file << recommended << '\n';
+	if (!file)
+		Log::Warning("StackMonitor::SaveRecommendation: Failed to write %s\n", StackSizeFile.c_str());
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Js
+{
+	struct Options;
+	class TagRegistry;
+
+	struct TagStackUsage
+	{
+		const char* Tag = nullptr;
+		size_t HighWaterMark = 0;
+		uint64_t JobCount = 0;
+	};
+
+	// Paints fiber stacks with a canary and scans them after every job to find how deep the job reached.
+	// Only a fiber touches its own stack, so painting and scanning run on the fiber between jobs
+	class StackMonitor
+	{
+	public:
+		StackMonitor(const Options& options, const TagRegistry& tags);
+		StackMonitor(const StackMonitor&) = delete;
+		~StackMonitor() = default;
+
+		// Options::FiberStackSize, or the size saved in Options::StackSizeFile by an earlier run
+		static size_t GetStackSize(const Options& options);
+
+		bool IsEnabled() const { return Enabled; }
+		size_t GetStackSize() const { return StackSize; }
+
+		// Called by a fiber when it starts and after each job it runs
+		void Paint(uint16_t fiberIndex);
+		void Measure(uint16_t fiberIndex, size_t tagIndex);
+
+		size_t GetFiberHighWaterMark(uint16_t fiberIndex) const;
+		std::vector<TagStackUsage> GetTagUsage() const;
+		// Stack usage covering the given fraction of measured jobs, rounded up to the histogram granularity
+		size_t GetUsagePercentile(double fraction) const;
+		// Smallest stack covering p99.99 of measured jobs plus a safety margin, the current size without samples
+		size_t GetRecommendedStackSize() const;
+
+		// Writes the recommendation to Options::StackSizeFile so the next start picks it up
+		void SaveRecommendation() const;
+
+	private:
+		struct FiberStack
+		{
+			char* Low = nullptr;
+			char* High = nullptr;
+			std::atomic<size_t> HighWaterMark{0};
+		};
+
+		struct TagStack
+		{
+			std::atomic<size_t> HighWaterMark{0};
+			std::atomic<uint64_t> JobCount{0};
+		};
+
+		static constexpr size_t BUCKET_SIZE = 4096;
+
+		const TagRegistry& Tags;
+		bool Enabled;
+		size_t StackSize;
+		std::string StackSizeFile;
+
+		std::vector<FiberStack> Stacks;
+		std::vector<TagStack> TagStacks;
+		// Jobs by stack usage in BUCKET_SIZE steps, the last bucket also counts jobs that outgrew the painted area
+		std::vector<std::atomic<uint64_t>> UsageBuckets;
+
+		static void PaintRange(char* from, char* to);
+	};
+}
@@ -0,0 +1,48 @@
+#include "TagRegistry.h"
+
+#include <cstring>
+
+namespace
+{
+	size_t HashTag(const char* tag)
+	{
+		size_t hash = 14695981039346656037ull;
+		for (; *tag != '\0'; ++tag)
+			hash = (hash ^ static_cast<unsigned char>(*tag)) * 1099511628211ull;
+		return hash;
+	}
+}
+
+Js::TagRegistry::TagRegistry()
+{
+	for (auto& tag : Tags)
+		tag.store(nullptr, std::memory_order_relaxed);
+
+	UntaggedIndex = Insert("untagged");
+}
+
+size_t Js::TagRegistry::GetIndex(const char* tag)
+{
+	if (tag == nullptr)
+		return UntaggedIndex;
+
+	const size_t index = Insert(tag);
+	return index != SIZE_MAX ? index : UntaggedIndex;
+}
+
+size_t Js::TagRegistry::Insert(const char* tag)
+{
+	const size_t start = HashTag(tag) % MAX_TAGS;
+	for (size_t i = 0; i < MAX_TAGS; ++i)
+	{
+		const size_t index = (start + i) % MAX_TAGS;
+		const char* slotTag = Tags[index].load(std::memory_order_acquire);
+		if (slotTag == nullptr && Tags[index].compare_exchange_strong(slotTag, tag, std::memory_order_acq_rel))
+			return index;
+
+		// Either the slot was taken or another thread just claimed it
+		if (slotTag == tag || std::strcmp(slotTag, tag) == 0)
+			return index;
+	}
+	return SIZE_MAX;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace Js
+{
+	// Maps static job tags to small indices so diagnostics can keep per tag data in flat arrays.
+	// Tags are compared by content, so equal names from different translation units share an index
+	class TagRegistry
+	{
+	public:
+		static constexpr size_t MAX_TAGS = 256;
+
+		TagRegistry();
+		TagRegistry(const TagRegistry&) = delete;
+		~TagRegistry() = default;
+
+		// Untagged jobs, and tags that no longer fit, share the untagged index
+		size_t GetIndex(const char* tag);
+		size_t GetUntaggedIndex() const { return UntaggedIndex; }
+
+		// nullptr for indices no tag was registered at
+		const char* GetTag(const size_t index) const { return Tags[index].load(std::memory_order_acquire); }
+
+	private:
+		std::array<std::atomic<const char*>, MAX_TAGS> Tags;
+		size_t UntaggedIndex;
+
+		size_t Insert(const char* tag);
+	};
+}
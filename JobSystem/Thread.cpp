@@ -55,7 +55,10 @@ void Js::Thread::Join() const
 
 void Js::Thread::FromCurrentThread()
 {
-	Handle = GetCurrentThread();
+	// GetCurrentThread returns a pseudo handle that only means this thread when used from it
+	if (!DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &Handle, 0, FALSE,
+	                     DUPLICATE_SAME_ACCESS))
+		throw JsException("Failed to get current thread handle");
 	Id = GetCurrentThreadId();
 }
 
@@ -23,6 +23,7 @@ namespace Js
 		ThreadFunc GetFunc() const { return Func; }
 		Tls& GetTls() { return Tls; }
 		size_t GetId() const { return Id; }
+		void* GetHandle() const { return Handle; }
 		void* GetData() const { return Data; }
 
 		void WaitForReady();
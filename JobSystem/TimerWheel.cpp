@@ -0,0 +1,381 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <immintrin.h>
+
+#include "Counter.h"
+#include "Job.h"
+#include "JobSystem.h"
+
+struct Js::TimerWheel::Entry
+{
+	Js::Job Job;
+	Js::Counter* Counter = nullptr;
+	JobPriority Priority = JobPriority::Normal;
+	uint32_t PeriodTicks = 0;
+	bool IsFiber = false;
+	uint16_t FiberIndex = UINT16_MAX;
+	std::atomic_bool* FiberStored = nullptr;
+
+	uint64_t Deadline = 0;
+	// Deadline of the next period while a periodic job waits for a retry, 0 otherwise
+	uint64_t ResumeDeadline = 0;
+	// Bumped on every reuse so stale TimerIds do not match
+	uint32_t Generation = 1;
+	uint32_t Slot = NONE;
+	uint32_t Prev = NONE;
+	uint32_t Next = NONE;
+};
+
+struct Js::TimerWheel::Fired
+{
+	uint32_t Index = NONE;
+	uint32_t Generation = 0;
+	bool Periodic = false;
+	Js::Job Job;
+	Js::Counter* Counter = nullptr;
+	JobPriority Priority = JobPriority::Normal;
+	bool IsFiber = false;
+	uint16_t FiberIndex = UINT16_MAX;
+	std::atomic_bool* FiberStored = nullptr;
+};
+
+Js::TimerWheel::TimerWheel(JobSystem* system) :
+	System(system),
+	StartTime(0)
+{
+	// Ticks count from construction, GetTick returns the absolute time while StartTime is zero
+	StartTime = GetTick();
+	std::fill(std::begin(Slots), std::end(Slots), NONE);
+}
+
+Js::TimerWheel::~TimerWheel() = default;
+
+uint64_t Js::TimerWheel::GetTick() const
+{
+	const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	return static_cast<uint64_t>(now) - StartTime;
+}
+
+void Js::TimerWheel::Lock()
+{
+	while (!TryLock())
+		_mm_pause();
+}
+
+bool Js::TimerWheel::TryLock()
+{
+	return !Locked.load(std::memory_order_relaxed) && !Locked.exchange(true, std::memory_order_acquire);
+}
+
+void Js::TimerWheel::Unlock()
+{
+	Locked.store(false, std::memory_order_release);
+}
+
+Js::TimerWheel::Entry& Js::TimerWheel::GetEntry(const uint32_t index) const
+{
+	return Blocks[index / BLOCK_SIZE][index % BLOCK_SIZE];
+}
+
+uint32_t Js::TimerWheel::AllocateEntry()
+{
+	if (FreeList == NONE)
+	{
+		const auto first = static_cast<uint32_t>(Blocks.size() * BLOCK_SIZE);
+		Blocks.emplace_back(new Entry[BLOCK_SIZE]);
+		for (uint32_t i = BLOCK_SIZE; i-- > 0;)
+		{
+			Blocks.back()[i].Next = FreeList;
+			FreeList = first + i;
+		}
+	}
+
+	const uint32_t index = FreeList;
+	FreeList = GetEntry(index).Next;
+	return index;
+}
+
+void Js::TimerWheel::FreeEntry(const uint32_t index)
+{
+	Entry& entry = GetEntry(index);
+	entry.Job = Job();
+	entry.Counter = nullptr;
+	entry.FiberStored = nullptr;
+	entry.ResumeDeadline = 0;
+	entry.Slot = NONE;
+	entry.Prev = NONE;
+	entry.Next = FreeList;
+	if (++entry.Generation == 0)
+		entry.Generation = 1;
+	FreeList = index;
+}
+
+void Js::TimerWheel::Link(const uint32_t index)
+{
+	Entry& entry = GetEntry(index);
+	const uint64_t current = CurrentTick.load(std::memory_order_relaxed);
+	const uint64_t deadline = std::max(entry.Deadline, current);
+	const uint64_t delta = deadline - current;
+
+	uint32_t level = 0;
+	while (level + 1 < LEVEL_COUNT && delta >= 1ull << (SLOT_BITS * (level + 1)))
+		++level;
+
+	// Past the range of the top level the timer waits in its farthest slot and is placed again from there
+	const uint64_t slotTick = std::min<uint64_t>(deadline, current + (1ull << (SLOT_BITS * LEVEL_COUNT)) - 1);
+	const uint32_t slot = level * SLOT_COUNT + static_cast<uint32_t>((slotTick >> (SLOT_BITS * level)) & (SLOT_COUNT - 1));
+
+	entry.Slot = slot;
+	entry.Prev = NONE;
+	entry.Next = Slots[slot];
+	if (entry.Next != NONE)
+		GetEntry(entry.Next).Prev = index;
+	Slots[slot] = index;
+}
+
+void Js::TimerWheel::Unlink(const uint32_t index)
+{
+	Entry& entry = GetEntry(index);
+	if (entry.Prev != NONE)
+		GetEntry(entry.Prev).Next = entry.Next;
+	else
+		Slots[entry.Slot] = entry.Next;
+	if (entry.Next != NONE)
+		GetEntry(entry.Next).Prev = entry.Prev;
+
+	entry.Slot = NONE;
+	entry.Prev = NONE;
+	entry.Next = NONE;
+}
+
+Js::TimerId Js::TimerWheel::Schedule(const uint32_t index, const uint32_t delayMs)
+{
+	const uint64_t now = GetTick();
+
+	// An empty wheel has nothing to catch up on, so Poll does not walk the ticks it slept through
+	if (Pending.load(std::memory_order_relaxed) == 0 && CurrentTick.load(std::memory_order_relaxed) < now)
+		CurrentTick.store(now, std::memory_order_relaxed);
+
+	// Rounded up so a timer never fires before its delay passed
+	Entry& entry = GetEntry(index);
+	entry.Deadline = now + delayMs + 1;
+	Link(index);
+	Pending.fetch_add(1, std::memory_order_relaxed);
+
+	return static_cast<TimerId>(entry.Generation) << 32 | index;
+}
+
+Js::TimerId Js::TimerWheel::AddJob(const Job& job, const uint32_t delayMs, const uint32_t periodMs, Counter* counter,
+                                   const JobPriority priority)
+{
+	Lock();
+	const uint32_t index = AllocateEntry();
+	Entry& entry = GetEntry(index);
+	entry.Job = job;
+	entry.Counter = counter;
+	entry.Priority = priority;
+	entry.PeriodTicks = periodMs;
+	entry.IsFiber = false;
+
+	const TimerId timer = Schedule(index, delayMs);
+	Unlock();
+	return timer;
+}
+
+Js::TimerId Js::TimerWheel::AddFiber(const uint32_t delayMs, const uint16_t fiberIndex, std::atomic_bool* fiberStored)
+{
+	Lock();
+	const uint32_t index = AllocateEntry();
+	Entry& entry = GetEntry(index);
+	entry.PeriodTicks = 0;
+	entry.IsFiber = true;
+	entry.FiberIndex = fiberIndex;
+	entry.FiberStored = fiberStored;
+
+	const TimerId timer = Schedule(index, delayMs);
+	Unlock();
+	return timer;
+}
+
+bool Js::TimerWheel::Cancel(const TimerId timer)
+{
+	const auto index = static_cast<uint32_t>(timer);
+	const auto generation = static_cast<uint32_t>(timer >> 32);
+
+	Lock();
+	if (index >= Blocks.size() * BLOCK_SIZE)
+	{
+		Unlock();
+		return false;
+	}
+
+	// A sleeping fiber must be resumed, so only job timers can be cancelled
+	Entry& entry = GetEntry(index);
+	if (entry.Generation != generation || entry.Slot == NONE || entry.IsFiber)
+	{
+		Unlock();
+		return false;
+	}
+
+	Counter* counter = entry.Counter;
+	Unlink(index);
+	FreeEntry(index);
+	Pending.fetch_sub(1, std::memory_order_relaxed);
+	Unlock();
+
+	if (counter != nullptr)
+		counter->Decrement();
+	return true;
+}
+
+void Js::TimerWheel::Cascade(const uint32_t level, const uint64_t tick)
+{
+	const uint32_t slot = level * SLOT_COUNT + static_cast<uint32_t>((tick >> (SLOT_BITS * level)) & (SLOT_COUNT - 1));
+	uint32_t index = Slots[slot];
+	Slots[slot] = NONE;
+
+	while (index != NONE)
+	{
+		const uint32_t next = GetEntry(index).Next;
+		Link(index);
+		index = next;
+	}
+}
+
+void Js::TimerWheel::Advance(const uint64_t tick, const uint64_t now, std::vector<Fired>& fired)
+{
+	CurrentTick.store(tick, std::memory_order_relaxed);
+
+	// Coarse levels first, their timers may land in the finer slots cascaded right after
+	for (uint32_t level = LEVEL_COUNT - 1; level > 0; --level)
+	{
+		if ((tick & ((1ull << (SLOT_BITS * level)) - 1)) == 0)
+			Cascade(level, tick);
+	}
+
+	const auto slot = static_cast<uint32_t>(tick & (SLOT_COUNT - 1));
+	uint32_t index = Slots[slot];
+	Slots[slot] = NONE;
+
+	while (index != NONE)
+	{
+		Entry& entry = GetEntry(index);
+		const uint32_t next = entry.Next;
+
+		if (entry.Deadline > tick)
+		{
+			Link(index);
+			index = next;
+			continue;
+		}
+
+		Fired timer;
+		timer.Index = index;
+		timer.Generation = entry.Generation;
+		timer.Periodic = entry.PeriodTicks != 0;
+		timer.Job = entry.Job;
+		timer.Counter = entry.Counter;
+		timer.Priority = entry.Priority;
+		timer.IsFiber = entry.IsFiber;
+		timer.FiberIndex = entry.FiberIndex;
+		timer.FiberStored = entry.FiberStored;
+		fired.push_back(std::move(timer));
+
+		if (entry.PeriodTicks != 0)
+		{
+			// Periods missed while no worker polled are skipped rather than fired back to back, the next
+			// deadline stays aligned to the first one
+			entry.Deadline = entry.ResumeDeadline != 0 ? entry.ResumeDeadline : entry.Deadline + entry.PeriodTicks;
+			entry.ResumeDeadline = 0;
+			if (entry.Deadline <= now)
+				entry.Deadline += ((now - entry.Deadline) / entry.PeriodTicks + 1) * entry.PeriodTicks;
+			Link(index);
+		}
+		else if (entry.IsFiber)
+		{
+			FreeEntry(index);
+			Pending.fetch_sub(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			// Out of the wheel but kept until Fire queued the job, so a retry keeps the timer's id
+			entry.Slot = NONE;
+			entry.Prev = NONE;
+			entry.Next = NONE;
+		}
+
+		index = next;
+	}
+
+	CurrentTick.store(tick + 1, std::memory_order_relaxed);
+}
+
+void Js::TimerWheel::Fire(Fired& timer)
+{
+	if (timer.IsFiber)
+	{
+		System->ResumeFiber(timer.FiberIndex, timer.FiberStored);
+		return;
+	}
+
+	const bool queued = System->QueueTimerJob(timer.Job, timer.Counter, timer.Priority);
+	if (queued && timer.Periodic)
+		return;
+
+	Lock();
+	// A periodic timer may have been cancelled since it fired
+	Entry& entry = GetEntry(timer.Index);
+	if (entry.Generation != timer.Generation)
+	{
+		Unlock();
+		return;
+	}
+
+	if (queued)
+	{
+		FreeEntry(timer.Index);
+		Pending.fetch_sub(1, std::memory_order_relaxed);
+		Unlock();
+		return;
+	}
+
+	// A full queue pushes the job back by a tick instead of blocking or failing the polling worker
+	if (entry.Slot != NONE)
+	{
+		entry.ResumeDeadline = entry.Deadline;
+		Unlink(timer.Index);
+	}
+	entry.Deadline = CurrentTick.load(std::memory_order_relaxed);
+	Link(timer.Index);
+	Unlock();
+}
+
+bool Js::TimerWheel::Poll()
+{
+	if (Pending.load(std::memory_order_relaxed) == 0)
+		return false;
+
+	const uint64_t now = GetTick();
+	if (now < CurrentTick.load(std::memory_order_relaxed) || !TryLock())
+		return false;
+
+	std::vector<Fired> fired;
+	for (uint64_t tick = CurrentTick.load(std::memory_order_relaxed); tick <= now; ++tick)
+	{
+		if (Pending.load(std::memory_order_relaxed) == 0)
+		{
+			CurrentTick.store(now + 1, std::memory_order_relaxed);
+			break;
+		}
+		Advance(tick, now, fired);
+	}
+	Unlock();
+
+	for (Fired& timer : fired)
+		Fire(timer);
+	return !fired.empty();
+}
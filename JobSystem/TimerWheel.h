@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Js
+{
+	class Counter;
+	class Job;
+	class JobSystem;
+	enum class JobPriority;
+
+	// Handle of a pending timer, 0 is never a valid timer
+	using TimerId = uint64_t;
+
+	// Hierarchical timer wheel with millisecond ticks. Each of the LEVEL_COUNT levels has SLOT_COUNT slots, every
+	// level SLOT_COUNT times coarser than the one below, and timers move to a finer level when their coarse slot
+	// comes up. Timers are intrusive list nodes in blocks that never move, so adding and cancelling are O(1)
+	class TimerWheel
+	{
+	public:
+		explicit TimerWheel(JobSystem* system);
+		TimerWheel(const TimerWheel&) = delete;
+		~TimerWheel();
+
+		// Queues the job after delayMs and then every periodMs when periodMs is not zero
+		TimerId AddJob(const Job& job, uint32_t delayMs, uint32_t periodMs, Counter* counter, JobPriority priority);
+		// Resumes a suspended fiber after delayMs
+		TimerId AddFiber(uint32_t delayMs, uint16_t fiberIndex, std::atomic_bool* fiberStored);
+		// False when the timer already fired or was cancelled, a cancelled job's counter is decremented
+		bool Cancel(TimerId timer);
+
+		// Fires due timers, returns immediately while none is due. Called by workers from their scheduling loop
+		bool Poll();
+
+		size_t GetPendingCount() const { return Pending.load(std::memory_order_relaxed); }
+
+	private:
+		struct Entry;
+		struct Fired;
+
+		static constexpr uint32_t SLOT_BITS = 6;
+		static constexpr uint32_t SLOT_COUNT = 1u << SLOT_BITS;
+		static constexpr uint32_t LEVEL_COUNT = 4;
+		static constexpr uint32_t BLOCK_SIZE = 1024;
+		static constexpr uint32_t NONE = UINT32_MAX;
+
+		JobSystem* System;
+		uint64_t StartTime;
+
+		std::atomic_bool Locked{false};
+		// First tick not processed yet
+		std::atomic<uint64_t> CurrentTick{0};
+		std::atomic<size_t> Pending{0};
+
+		uint32_t Slots[LEVEL_COUNT * SLOT_COUNT];
+		std::vector<std::unique_ptr<Entry[]>> Blocks;
+		uint32_t FreeList = NONE;
+
+		uint64_t GetTick() const;
+		void Lock();
+		bool TryLock();
+		void Unlock();
+
+		Entry& GetEntry(uint32_t index) const;
+		uint32_t AllocateEntry();
+		void FreeEntry(uint32_t index);
+		void Link(uint32_t index);
+		void Unlink(uint32_t index);
+		TimerId Schedule(uint32_t index, uint32_t delayMs);
+
+		void Advance(uint64_t tick, uint64_t now, std::vector<Fired>& fired);
+		void Cascade(uint32_t level, uint64_t tick);
+		void Fire(Fired& timer);
+	};
+}
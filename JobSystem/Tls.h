@@ -5,9 +5,12 @@
 #include <vector>
 
 #include "Fiber.h"
+#include "MemoryResource.h"
 
 namespace Js
 {
+	class Counter;
+
 	enum class FiberDestination : uint8_t
 	{
 		None,
@@ -15,6 +18,9 @@ namespace Js
 		Pool
 	};
 
+	using ReadyFiber = std::pair<uint16_t, std::atomic_bool*>;
+	using ReadyFiberList = std::vector<ReadyFiber, ResourceAllocator<ReadyFiber>>;
+
 	struct Tls
 	{
 		Tls() = default;
@@ -30,6 +36,10 @@ namespace Js
 		std::atomic_bool* PreviousFiberStored = nullptr;
 		FiberDestination PreviousFiberDestination = FiberDestination::None;
 
-		std::vector<std::pair<uint16_t, std::atomic_bool*>> ReadyFibers;
+		ReadyFiberList ReadyFibers;
+
+		// Finished jobs of a sharded counter not applied to it yet
+		Counter* PendingCounter = nullptr;
+		uint32_t PendingDecrements = 0;
 	};
 }
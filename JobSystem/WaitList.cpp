@@ -0,0 +1,101 @@
+#include "WaitList.h"
+
+#include "WindowsMinimal.h"
+
+#include "JobSystem.h"
+
+void Js::WaitList::Lock()
+{
+	for (;;)
+	{
+		if (!Locked.exchange(true, std::memory_order_acquire))
+			return;
+
+		while (Locked.load(std::memory_order_relaxed))
+			_mm_pause();
+	}
+}
+
+void Js::WaitList::Unlock()
+{
+	Locked.store(false, std::memory_order_release);
+}
+
+void Js::WaitList::Park(JobSystem& system)
+{
+	Waiter waiter;
+	const bool isWorker = system.IsWorkerThread();
+	if (isWorker)
+	{
+		waiter.FiberIndex = system.GetCurrentTls().CurrentFiberIndex;
+		waiter.FiberStored = system.ResetFiberStored(waiter.FiberIndex);
+	}
+	waiter.IsThread = !isWorker;
+
+	if (Tail != nullptr)
+		Tail->Next = &waiter;
+	else
+		Head = &waiter;
+	Tail = &waiter;
+
+	std::atomic_bool* fiberStored = waiter.FiberStored;
+	Unlock();
+
+	if (isWorker)
+	{
+		system.SuspendCurrentFiber(fiberStored);
+		return;
+	}
+
+	uint32_t notSet = 0;
+	while (waiter.ThreadEvent.load(std::memory_order_acquire) == notSet)
+		WaitOnAddress(&waiter.ThreadEvent, &notSet, sizeof(notSet), INFINITE);
+}
+
+Js::WaitList::Waiter* Js::WaitList::PopFront()
+{
+	Waiter* waiter = Head;
+	if (waiter == nullptr)
+		return nullptr;
+
+	Head = waiter->Next;
+	if (Head == nullptr)
+		Tail = nullptr;
+
+	waiter->Next = nullptr;
+	return waiter;
+}
+
+Js::WaitList::Waiter* Js::WaitList::PopAll()
+{
+	Waiter* waiters = Head;
+	Head = nullptr;
+	Tail = nullptr;
+	return waiters;
+}
+
+void Js::WaitList::Resume(JobSystem& system, Waiter* waiter)
+{
+	if (waiter->IsThread)
+	{
+		std::atomic<uint32_t>* event = &waiter->ThreadEvent;
+		event->store(1, std::memory_order_release);
+		WakeByAddressSingle(event);
+		return;
+	}
+
+	// The waiter lives on the suspended fiber's stack and may be gone as soon as the fiber is ready
+	const uint16_t fiberIndex = waiter->FiberIndex;
+	std::atomic_bool* fiberStored = waiter->FiberStored;
+	system.ResumeFiber(fiberIndex, fiberStored);
+}
+
+void Js::WaitList::ResumeAll(JobSystem& system, Waiter* waiters)
+{
+	while (waiters != nullptr)
+	{
+		Waiter* next = waiters->Next;
+		Resume(system, waiters);
+		waiters = next;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace Js
+{
+	class JobSystem;
+
+	// FIFO list of suspended fibers or blocked external threads shared by the fiber-aware sync primitives
+	class WaitList
+	{
+	public:
+		struct Waiter
+		{
+			uint16_t FiberIndex = UINT16_MAX;
+			std::atomic_bool* FiberStored = nullptr;
+			std::atomic<uint32_t> ThreadEvent{0};
+			bool IsThread = false;
+			Waiter* Next = nullptr;
+		};
+
+		WaitList() = default;
+		WaitList(const WaitList&) = delete;
+		~WaitList() = default;
+
+		void Lock();
+		void Unlock();
+
+		bool IsEmpty() const { return Head == nullptr; }
+
+		// Must be called with the lock held, releases it and suspends the caller until it is resumed
+		void Park(JobSystem& system);
+
+		// Must be called with the lock held, the returned waiter is resumed with Resume after unlocking
+		Waiter* PopFront();
+		Waiter* PopAll();
+
+		static void Resume(JobSystem& system, Waiter* waiter);
+		static void ResumeAll(JobSystem& system, Waiter* waiters);
+
+		// Iterations a primitive spins before it parks the caller
+		static constexpr size_t SPIN_COUNT = 128;
+
+	private:
+		std::atomic_bool Locked{false};
+		Waiter* Head = nullptr;
+		Waiter* Tail = nullptr;
+	};
+}
@@ -0,0 +1,171 @@
+#include "WorkerScaler.h"
+
+#include <algorithm>
+
+#include "WindowsMinimal.h"
+
+#include "CpuQuota.h"
+#include "JobSystem.h"
+#include "JSException.h"
+#include "Log.h"
+
+namespace
+{
+	constexpr DWORD PARK_TIMEOUT_MS = 1;
+	constexpr uint64_t QUOTA_REFRESH_MS = 1000;
+	// A job is blocked when its thread used less than this many cycles per millisecond, ~5% of a 1 GHz core
+	constexpr uint64_t BLOCKED_CYCLES_PER_MS = 50000;
+	constexpr size_t BUSY_INTERVALS_TO_GROW = 2;
+	constexpr size_t IDLE_INTERVALS_TO_SHRINK = 100;
+}
+
+Js::WorkerScaler::WorkerScaler(JobSystem* system, const Options& options) :
+	System(system),
+	Enabled(options.ElasticWorkers),
+	MinCount(std::max<size_t>(1, std::min(options.MinThreadCount, options.ThreadCount))),
+	MaxCount(GetMaxThreadCount(options)),
+	BlockedThresholdMs(options.BlockedJobThresholdMs),
+	IntervalMs(options.ScalerIntervalMs),
+	Active(options.ThreadCount),
+	Activities(GetMaxThreadCount(options)),
+	QuotaTarget(options.ThreadCount),
+	LoadTarget(options.ThreadCount) {}
+
+size_t Js::WorkerScaler::GetMaxThreadCount(const Options& options)
+{
+	if (!options.ElasticWorkers)
+		return options.ThreadCount;
+
+	const size_t maxCount = options.MaxThreadCount != 0 ? options.MaxThreadCount : options.ThreadCount * 2;
+	return std::max(maxCount, options.ThreadCount);
+}
+
+void Js::WorkerScaler::Initialize()
+{
+	if (!Enabled || MonitorRunning.load(std::memory_order_relaxed))
+		return;
+
+	LastQuotaCheck = GetTickCount64();
+	MonitorRunning.store(true, std::memory_order_release);
+	if (!Monitor.Create(MonitorWorker, this))
+		throw JsException("Failed to start worker scaler thread");
+}
+
+void Js::WorkerScaler::Shutdown()
+{
+	if (!MonitorRunning.exchange(false, std::memory_order_acq_rel))
+		return;
+
+	Monitor.Join();
+	WakeByAddressAll(&Active);
+}
+
+void Js::WorkerScaler::Park(const size_t worker)
+{
+	size_t active = Active.load(std::memory_order_acquire);
+	if (worker < active)
+		return;
+
+	// The timeout lets parked workers still serve jobs and fibers pinned to them
+	WaitOnAddress(&Active, &active, sizeof(active), PARK_TIMEOUT_MS);
+}
+
+void Js::WorkerScaler::OnJobBegin(const size_t worker)
+{
+	if (!Enabled)
+		return;
+
+	Activity& activity = Activities[worker];
+	activity.Idle.store(false, std::memory_order_relaxed);
+	activity.StartTime.store(GetTickCount64(), std::memory_order_relaxed);
+	activity.Sequence.fetch_add(1, std::memory_order_release);
+}
+
+void Js::WorkerScaler::OnJobEnd(const size_t worker)
+{
+	if (!Enabled)
+		return;
+
+	Activity& activity = Activities[worker];
+	activity.StartTime.store(0, std::memory_order_relaxed);
+	activity.Sequence.fetch_add(1, std::memory_order_release);
+}
+
+void Js::WorkerScaler::OnIdle(const size_t worker)
+{
+	if (!Enabled)
+		return;
+
+	Activities[worker].Idle.store(true, std::memory_order_relaxed);
+}
+
+void Js::WorkerScaler::Rebalance()
+{
+	const uint64_t now = GetTickCount64();
+	if (now - LastQuotaCheck >= QUOTA_REFRESH_MS)
+	{
+		LastQuotaCheck = now;
+		QuotaTarget = std::min(MaxCount, std::max(MinCount, GetAvailableCpuCount()));
+		LoadTarget = std::min(LoadTarget, QuotaTarget);
+	}
+
+	const size_t active = Active.load(std::memory_order_relaxed);
+	size_t blocked = 0;
+	size_t idle = 0;
+	for (size_t i = 0; i < active; ++i)
+	{
+		Activity& activity = Activities[i];
+		const uint64_t sequence = activity.Sequence.load(std::memory_order_acquire);
+		const uint64_t startTime = activity.StartTime.load(std::memory_order_relaxed);
+
+		ULONG64 cycles = 0;
+		QueryThreadCycleTime(System->Threads[i].GetHandle(), &cycles);
+
+		if (activity.Idle.load(std::memory_order_relaxed))
+			++idle;
+		else if (startTime != 0 && sequence == activity.LastSequence && now - startTime >= BlockedThresholdMs &&
+			cycles - activity.LastCycles < BLOCKED_CYCLES_PER_MS * IntervalMs)
+			++blocked;
+
+		activity.LastSequence = sequence;
+		activity.LastCycles = cycles;
+	}
+
+	// Grow while every active worker stays busy, shrink once idle workers persist
+	BusyIntervals = idle == 0 && LoadTarget < QuotaTarget ? BusyIntervals + 1 : 0;
+	if (BusyIntervals >= BUSY_INTERVALS_TO_GROW)
+	{
+		++LoadTarget;
+		BusyIntervals = 0;
+	}
+
+	IdleIntervals = idle > 1 && LoadTarget > MinCount ? IdleIntervals + 1 : 0;
+	if (IdleIntervals >= IDLE_INTERVALS_TO_SHRINK)
+	{
+		--LoadTarget;
+		IdleIntervals = 0;
+	}
+
+	SetActive(std::min(MaxCount, LoadTarget + blocked));
+}
+
+void Js::WorkerScaler::SetActive(const size_t count)
+{
+	const size_t active = Active.load(std::memory_order_relaxed);
+	if (count == active)
+		return;
+
+	Log::Info("WorkerScaler::SetActive: Changing active workers from %zu to %zu\n", active, count);
+	Active.store(count, std::memory_order_release);
+	WakeByAddressAll(&Active);
+}
+
+void Js::WorkerScaler::MonitorWorker(Thread* thread)
+{
+	const auto scaler = static_cast<WorkerScaler*>(thread->GetData());
+	while (scaler->MonitorRunning.load(std::memory_order_acquire))
+	{
+		Sleep(scaler->IntervalMs);
+		scaler->Rebalance();
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Thread.h"
+
+namespace Js
+{
+	class JobSystem;
+	struct Options;
+
+	// Keeps workers [0, active) running and parks the rest, resizing the active set from the CPU quota,
+	// the observed load and workers whose current job is blocked in the kernel
+	class WorkerScaler
+	{
+	public:
+		WorkerScaler(JobSystem* system, const Options& options);
+		WorkerScaler(const WorkerScaler&) = delete;
+		~WorkerScaler() = default;
+
+		static size_t GetMaxThreadCount(const Options& options);
+
+		void Initialize();
+		void Shutdown();
+
+		bool IsParked(const size_t worker) const { return worker >= Active.load(std::memory_order_relaxed); }
+		size_t GetActiveCount() const { return Active.load(std::memory_order_relaxed); }
+		void Park(size_t worker);
+
+		void OnJobBegin(size_t worker);
+		void OnJobEnd(size_t worker);
+		void OnIdle(size_t worker);
+
+	private:
+		static constexpr size_t CACHELINE_SIZE = 64;
+
+		// Written by its worker on every job, kept off the cache lines of the others
+		struct Activity
+		{
+			alignas(CACHELINE_SIZE) std::atomic<uint64_t> Sequence{0};
+			std::atomic<uint64_t> StartTime{0};
+			std::atomic_bool Idle{false};
+
+			uint64_t LastSequence = 0;
+			uint64_t LastCycles = 0;
+		};
+
+		JobSystem* System;
+		bool Enabled;
+
+		size_t MinCount;
+		size_t MaxCount;
+		uint32_t BlockedThresholdMs;
+		uint32_t IntervalMs;
+
+		std::atomic<size_t> Active;
+		std::vector<Activity> Activities;
+
+		size_t QuotaTarget;
+		size_t LoadTarget;
+		uint64_t LastQuotaCheck = 0;
+		size_t BusyIntervals = 0;
+		size_t IdleIntervals = 0;
+
+		Thread Monitor;
+		std::atomic_bool MonitorRunning{false};
+
+		void Rebalance();
+		void SetActive(size_t count);
+
+		static void MonitorWorker(Thread* thread);
+	};
+}
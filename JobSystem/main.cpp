@@ -3,10 +3,18 @@
 #include <algorithm>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <cstring>
+#include <thread>
 
+#include "Benchmarks.h"
+#include "ExternalSort.h"
+#include "File.h"
 #include "JobSystem.h"
 #include "Job.h"
+#include "Semaphore.h"
+#include "SortedStrings.h"
 #include "WindowsMinimal.h"
 
 struct DivideAndSortData
@@ -47,32 +55,182 @@ void DivideAndSort(Js::JobSystem& jobSystem, void* data)
 	           secondPartData.Strings.end(), jobData->Strings.begin());
 }
 
-void ReadFile(const char* str, std::vector<std::string>& vector)
+constexpr uint32_t IO_CHUNK_SIZE = 1 << 20;
+
+void ReadFile(Js::JobSystem& jobSystem, const char* str, std::vector<std::string>& vector)
 {
-	std::ifstream file(str);
-	std::string line;
-	while (std::getline(file, line))
+	Js::File file;
+	file.Open(jobSystem, str, Js::FileAccess::Read);
+
+	std::string content(static_cast<size_t>(file.GetSize()), '\0');
+	for (size_t offset = 0; offset < content.size();)
+	{
+		const auto size = static_cast<uint32_t>(std::min<size_t>(IO_CHUNK_SIZE, content.size() - offset));
+		const uint32_t read = file.Read(&content[offset], size, offset);
+		if (read == 0)
+			break;
+		offset += read;
+	}
+
+	size_t begin = 0;
+	while (begin < content.size())
 	{
-		vector.push_back(line);
+		size_t end = content.find('\n', begin);
+		if (end == std::string::npos)
+			end = content.size();
+
+		size_t lineEnd = end;
+		if (lineEnd > begin && content[lineEnd - 1] == '\r')
+			--lineEnd;
+
+		vector.emplace_back(content, begin, lineEnd - begin);
+		begin = end + 1;
 	}
 }
 
-void WriteToFile(const char* str, const std::vector<std::string>& vector)
+void WriteToFile(Js::JobSystem& jobSystem, const char* str, const std::vector<std::string>& vector)
 {
-	std::ofstream file(str);
+	std::string content;
 	for (const auto& line : vector)
 	{
-		file << line << std::endl;
+		content += line;
+		content += '\n';
+	}
+
+	Js::File file;
+	file.Open(jobSystem, str, Js::FileAccess::Write);
+
+	for (size_t offset = 0; offset < content.size();)
+	{
+		const auto size = static_cast<uint32_t>(std::min<size_t>(IO_CHUNK_SIZE, content.size() - offset));
+		offset += file.Write(&content[offset], size, offset);
 	}
 }
 
-int main()
+void SleepAndCount(Js::JobSystem& jobSystem, void* data)
 {
+	Js::SleepFor(jobSystem, 1);
+	static_cast<std::atomic<uint32_t>*>(data)->fetch_add(1, std::memory_order_relaxed);
+}
+
+// The main thread suspends more than once, every wait has to come back after its own jobs finished
+bool CheckMainThreadWaits(Js::JobSystem& jobSystem)
+{
+	constexpr uint32_t JOB_COUNT = 64;
+	for (int round = 0; round < 2; ++round)
+	{
+		std::atomic<uint32_t> executed{0};
+		std::vector<Js::Job> jobs(JOB_COUNT, Js::Job{SleepAndCount, &executed});
+		Js::Counter counter;
+
+		jobSystem.AddJobs(jobs, &counter);
+		jobSystem.Wait(counter, 0);
+
+		if (executed.load(std::memory_order_relaxed) != JOB_COUNT)
+			return false;
+	}
+	return true;
+}
+
+// Several threads release at once while one caller waits, every unit ends up acquired or in the count
+bool CheckSemaphoreReleases(Js::JobSystem& jobSystem)
+{
+	constexpr int ROUND_COUNT = 200;
+	constexpr uint32_t RELEASER_COUNT = 4;
+	for (int round = 0; round < ROUND_COUNT; ++round)
+	{
+		Js::Semaphore semaphore(jobSystem);
+		std::atomic_bool start{false};
+		std::vector<std::thread> releasers;
+		for (uint32_t i = 0; i < RELEASER_COUNT; ++i)
+		{
+			releasers.emplace_back([&]
+			{
+				while (!start.load(std::memory_order_acquire))
+					_mm_pause();
+				semaphore.Release();
+			});
+		}
+
+		start.store(true, std::memory_order_release);
+		semaphore.Acquire();
+		for (std::thread& releaser : releasers)
+			releaser.join();
+
+		uint32_t left = 0;
+		while (semaphore.TryAcquire())
+			++left;
+		if (left != RELEASER_COUNT - 1)
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && std::strcmp(argv[1], "queue-bench") == 0)
+		return RunQueueBenchmark(argc, argv);
+	if (argc > 1 && std::strcmp(argv[1], "sched-bench") == 0)
+		return RunSchedulerBenchmark(argc, argv);
+
 	Js::JobSystem jobSystem;
 	jobSystem.Initialize();
 
+	if (argc > 1 && std::strcmp(argv[1], "extsort-bench") == 0)
+	{
+		const int result = RunExternalSortBenchmark(jobSystem, argc, argv);
+		jobSystem.Shutdown(true);
+		return result;
+	}
+
+	if (argc > 1 && std::strcmp(argv[1], "aggregate-bench") == 0)
+	{
+		const int result = RunAggregateBenchmark(jobSystem, argc, argv);
+		jobSystem.Shutdown(true);
+		return result;
+	}
+
+	if (argc > 1 && std::strcmp(argv[1], "shm-bench") == 0)
+	{
+		const int result = RunSharedJobBenchmark(jobSystem, argc, argv);
+		jobSystem.Shutdown(true);
+		return result;
+	}
+
+	if (argc > 1 && std::strcmp(argv[1], "remote-bench") == 0)
+	{
+		const int result = RunRemoteJobBenchmark(jobSystem, argc, argv);
+		jobSystem.Shutdown(true);
+		return result;
+	}
+
+	// Checks of behavior that once regressed, kept out of the demo run
+	if (argc > 1 && std::strcmp(argv[1], "self-check") == 0)
+	{
+		const bool mainThreadWaits = CheckMainThreadWaits(jobSystem);
+		std::cout << "Main thread waits: " << mainThreadWaits << std::endl;
+		const bool semaphoreReleases = CheckSemaphoreReleases(jobSystem);
+		std::cout << "Semaphore releases: " << semaphoreReleases << std::endl;
+		jobSystem.Shutdown(true);
+		return mainThreadWaits && semaphoreReleases ? 0 : 1;
+	}
+
+	// Sorts strings.txt again reusing the sorted runs of the chunks that did not change since the last time
+	if (argc > 1 && std::strcmp(argv[1], "incremental-sort") == 0)
+	{
+		Js::ExternalSortOptions options;
+		options.RunCacheDirectory = argc > 2 ? argv[2] : "sort_cache";
+		CreateDirectoryA(options.RunCacheDirectory.c_str(), nullptr);
+
+		const Js::ExternalSortStats stats = Js::ExternalSort(jobSystem, "strings.txt", "sorted_strings.txt", options);
+		std::cout << "Sorted " << stats.LineCount << " strings, reused " << stats.ReusedRunCount << " of "
+			<< stats.RunCount << " runs" << std::endl;
+		jobSystem.Shutdown(true);
+		return 0;
+	}
+
 	std::vector<std::string> strings;
-	ReadFile("strings.txt", strings);
+	ReadFile(jobSystem, "strings.txt", strings);
 
 	std::cout << "Sorting " << strings.size() << " strings" << std::endl;
 
@@ -87,9 +245,25 @@ int main()
 
 	jobSystem.Wait(counter, 0);
 
-	jobSystem.Shutdown(true);
-
 	std::cout << "Sorted strings: " << std::is_sorted(data.Strings.begin(), data.Strings.end()) << std::endl;
 
-	WriteToFile("sorted_strings.txt", data.Strings);
+	WriteToFile(jobSystem, "sorted_strings.txt", data.Strings);
+
+	// Also in the binary format, which is looked up in place without parsing
+	if (argc > 1 && std::strcmp(argv[1], "binary") == 0)
+	{
+		Js::WriteSortedStrings(jobSystem, data.Strings, "sorted_strings.bin");
+
+		const Js::SortedStringReader reader("sorted_strings.bin");
+		bool found = reader.GetCount() == data.Strings.size();
+		for (size_t i = 0; found && i < data.Strings.size(); ++i)
+		{
+			const size_t index = reader.Find(data.Strings[i]);
+			found = index != Js::SortedStringReader::NOT_FOUND && reader.Get(index).ToString() == data.Strings[i];
+		}
+
+		std::cout << "Binary lookups: " << found << std::endl;
+	}
+
+	jobSystem.Shutdown(true);
 }